@@ -0,0 +1,402 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ATLAS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* GCC and Clang can build an AVX2 copy alongside the rest, and check whether
+   the processor has AVX2 at run time. */
+#if defined(ATLAS_USE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ATLAS_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "SDL.h"
+
+#include "game.h"
+#include "debug.h"
+#include "atlas.h"
+
+/* Colors tried, in order, as the atlas's color key. */
+static const Uint8 g_atlas_keys[][3] = {
+	{ 255, 0, 255 }, { 0, 255, 255 }, { 255, 255, 0 }, { 128, 64, 0 }, { 0, 128, 128 }, { 64, 0, 128 }
+};
+
+#define ATLAS_NUM_KEYS (int) (sizeof(g_atlas_keys) / sizeof(g_atlas_keys[0]))
+
+/* Copies n bytes of a run from src to dst. */
+typedef void (*AtlasCopyFunc)(Uint8 *dst, const Uint8 *src, int n);
+
+/* Copies a run of fewer than 16 bytes as two (possibly overlapping) fixed-size
+   copies, which the compiler turns into plain loads and stores. */
+#define ATLAS_COPY_SHORT(dst, src, n) \
+	if (n >= 8) { \
+		memcpy(dst, src, 8); \
+		memcpy(dst + n - 8, src + n - 8, 8); \
+	} else if (n >= 4) { \
+		memcpy(dst, src, 4); \
+		memcpy(dst + n - 4, src + n - 4, 4); \
+	} else if (n >= 2) { \
+		memcpy(dst, src, 2); \
+		memcpy(dst + n - 2, src + n - 2, 2); \
+	} else if (n == 1) { \
+		*dst = *src; \
+	}
+
+static void atlas_copy_plain(Uint8 *dst, const Uint8 *src, int n)
+{
+	memcpy(dst, src, n);
+}
+
+#ifdef ATLAS_USE_SSE2
+/* Runs of 16 bytes or more are copied 16 bytes at a time, the last copy
+   overlapping the one before it rather than leaving a tail. */
+static void atlas_copy_sse2(Uint8 *dst, const Uint8 *src, int n)
+{
+	int i;
+
+	if (n < 16) {
+		ATLAS_COPY_SHORT(dst, src, n);
+		return;
+	}
+	for (i = 0; i + 16 < n; i += 16)
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+	_mm_storeu_si128((__m128i *) (dst + n - 16), _mm_loadu_si128((const __m128i *) (src + n - 16)));
+}
+#endif
+
+#ifdef ATLAS_USE_AVX2
+/* Like atlas_copy_sse2(), but 32 bytes at a time. */
+__attribute__((target("avx2")))
+static void atlas_copy_avx2(Uint8 *dst, const Uint8 *src, int n)
+{
+	int i;
+
+	if (n < 16) {
+		ATLAS_COPY_SHORT(dst, src, n);
+		return;
+	}
+	if (n <= 32) {
+		_mm_storeu_si128((__m128i *) dst, _mm_loadu_si128((const __m128i *) src));
+		_mm_storeu_si128((__m128i *) (dst + n - 16), _mm_loadu_si128((const __m128i *) (src + n - 16)));
+		return;
+	}
+	for (i = 0; i + 32 < n; i += 32)
+		_mm256_storeu_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+	_mm256_storeu_si256((__m256i *) (dst + n - 32), _mm256_loadu_si256((const __m256i *) (src + n - 32)));
+}
+#endif
+
+/* The copy that atlas_blit() uses, picked by atlas_pick_copy(). */
+static AtlasCopyFunc g_atlas_copy = NULL;
+
+/* Picks the fastest copy that the processor can run. */
+static void atlas_pick_copy()
+{
+	g_atlas_copy = atlas_copy_plain;
+#ifdef ATLAS_USE_SSE2
+	g_atlas_copy = atlas_copy_sse2;
+#endif
+#ifdef ATLAS_USE_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		g_atlas_copy = atlas_copy_avx2;
+#endif
+}
+
+/* Initializes an empty atlas. */
+void atlas_init(Atlas *a)
+{
+	a->surface = NULL;
+	a->num_sprites = 0;
+	a->runs = NULL;
+	a->row_runs = NULL;
+}
+
+/* Adds the given surface to the atlas under the given name.  The atlas takes
+   the surface over, and frees it when it's built.  If the surface has a color
+   key, its pixels of that color are transparent. */
+void atlas_add(Atlas *a, const char *name, SDL_Surface *s)
+{
+	AtlasSprite *sprite;
+
+	assert(a->surface == NULL);
+	assert(a->num_sprites < ATLAS_MAX_SPRITES);
+	assert(strlen(name) < ATLAS_NAME_SIZE);
+
+	sprite = &a->sprites[a->num_sprites++];
+	strcpy(sprite->name, name);
+	sprite->rect.x = 0;
+	sprite->rect.y = 0;
+	sprite->rect.w = (Uint16) s->w;
+	sprite->rect.h = (Uint16) s->h;
+	sprite->source = s;
+}
+
+/* Returns the pixel at the given coordinates of the given (locked) surface. */
+static Uint32 atlas_get_pixel(SDL_Surface *s, int x, int y)
+{
+	Uint8 *p = (Uint8 *) s->pixels + y*s->pitch + x*s->format->BytesPerPixel;
+
+	switch (s->format->BytesPerPixel) {
+		case 1: return *p;
+		case 2: return *(Uint16 *) p;
+		case 3:
+			if (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+				return p[0] | (p[1] << 8) | (p[2] << 16);
+			else
+				return p[2] | (p[1] << 8) | (p[0] << 16);
+		default: return *(Uint32 *) p;
+	}
+}
+
+/* Fills the given surface with the given color, then blits every sprite of the
+   atlas onto it where it's been placed. */
+static void atlas_blit_sprites(Atlas *a, SDL_Surface *dst, Uint32 fill)
+{
+	int i;
+
+	SDL_FillRect(dst, NULL, fill);
+	for (i = 0; i < a->num_sprites; i++) {
+		SDL_Rect r = a->sprites[i].rect;
+
+		SDL_BlitSurface(a->sprites[i].source, NULL, dst, &r);
+	}
+}
+
+/* Given the same sprites blitted onto a surface filled with key and one filled
+   with another color, returns whether any opaque pixel of a sprite is the
+   color key (i.e., it's key on the first surface but not the fill of the
+   second). */
+static int atlas_key_is_used(SDL_Surface *s, Uint32 key, SDL_Surface *check, Uint32 fill)
+{
+	int x, y, used = 0;
+
+	SDL_LockSurface(s);
+	SDL_LockSurface(check);
+	for (y = 0; y < s->h && !used; y++) {
+		for (x = 0; x < s->w; x++) {
+			if (atlas_get_pixel(s, x, y) == key && atlas_get_pixel(check, x, y) != fill) {
+				used = 1;
+				break;
+			}
+		}
+	}
+	SDL_UnlockSurface(check);
+	SDL_UnlockSurface(s);
+	return used;
+}
+
+/* Breaks every row of the (built) atlas into runs of opaque pixels. */
+static void atlas_find_runs(Atlas *a, Uint32 key)
+{
+	SDL_Surface *s = a->surface;
+	int x, y, max_runs, num_runs = 0;
+
+	/* A row can't have more runs than half its pixels, rounded up. */
+	max_runs = s->h * ((s->w + 1) / 2);
+	a->runs = (AtlasRun *) malloc(sizeof(AtlasRun) * max_runs);
+	a->row_runs = (Uint32 *) malloc(sizeof(Uint32) * (s->h + 1));
+	if (!a->runs || !a->row_runs) err("Couldn't allocate sprite atlas runs.\n", 1);
+
+	SDL_LockSurface(s);
+	for (y = 0; y < s->h; y++) {
+		a->row_runs[y] = (Uint32) num_runs;
+		for (x = 0; x < s->w; ) {
+			int start;
+
+			while (x < s->w && atlas_get_pixel(s, x, y) == key) x++;
+			if (x == s->w) break;
+			start = x;
+			while (x < s->w && atlas_get_pixel(s, x, y) != key) x++;
+			a->runs[num_runs].x = (Uint16) start;
+			a->runs[num_runs].w = (Uint16) (x - start);
+			num_runs++;
+		}
+	}
+	a->row_runs[s->h] = (Uint32) num_runs;
+	SDL_UnlockSurface(s);
+
+	a->runs = (AtlasRun *) realloc(a->runs, sizeof(AtlasRun) * (num_runs ? num_runs : 1));
+}
+
+/* Packs all the sprites that have been added into the atlas's surface. */
+void atlas_build(Atlas *a)
+{
+	int order[ATLAS_MAX_SPRITES];
+	SDL_Surface *check;
+	Uint32 key = 0, fill;
+	int i, j, k, w, x, y, shelf_h;
+
+	assert(a->surface == NULL);
+
+	/* Sort the sprites by height, tallest first, and size the atlas to fit the
+	   widest. */
+	w = ATLAS_MIN_WIDTH;
+	for (i = 0; i < a->num_sprites; i++) {
+		for (j = i; j > 0 && a->sprites[order[j-1]].rect.h < a->sprites[i].rect.h; j--)
+			order[j] = order[j-1];
+		order[j] = i;
+		while (w < a->sprites[i].rect.w) w *= 2;
+	}
+
+	/* Put them on shelves. */
+	x = y = shelf_h = 0;
+	for (i = 0; i < a->num_sprites; i++) {
+		SDL_Rect *r = &a->sprites[order[i]].rect;
+
+		if (x + r->w > w) {
+			y += shelf_h;
+			x = 0;
+			shelf_h = 0;
+		}
+		r->x = (Sint16) x;
+		r->y = (Sint16) y;
+		x += r->w;
+		if (r->h > shelf_h) shelf_h = r->h;
+	}
+
+	a->surface = game_create_bitmap(0, w, y + shelf_h);
+	check = game_create_bitmap(0, w, y + shelf_h);
+	assert(a->surface != NULL && check != NULL);
+
+	/* Find a color key that none of the sprites use. */
+	for (k = 0; k < ATLAS_NUM_KEYS; k++) {
+		key = game_map_rgb(g_atlas_keys[k][0], g_atlas_keys[k][1], g_atlas_keys[k][2]);
+		fill = game_map_rgb(g_atlas_keys[(k+1) % ATLAS_NUM_KEYS][0], g_atlas_keys[(k+1) % ATLAS_NUM_KEYS][1],
+			g_atlas_keys[(k+1) % ATLAS_NUM_KEYS][2]);
+		atlas_blit_sprites(a, a->surface, key);
+		atlas_blit_sprites(a, check, fill);
+		if (!atlas_key_is_used(a->surface, key, check, fill)) break;
+	}
+	if (k == ATLAS_NUM_KEYS)
+		err("Couldn't find a color key for the sprite atlas.\n", 1);
+
+	SDL_FreeSurface(check);
+
+	/* SDL only blits the atlas if atlas_blit() can't, so there's no point in
+	   having it RLE-encode the atlas too. */
+	SDL_SetColorKey(a->surface, SDL_SRCCOLORKEY, key);
+	atlas_find_runs(a, key);
+	if (!g_atlas_copy) atlas_pick_copy();
+
+	for (i = 0; i < a->num_sprites; i++) {
+		SDL_FreeSurface(a->sprites[i].source);
+		a->sprites[i].source = NULL;
+	}
+}
+
+/* Looks up the sprite with the given name, putting where it is on the atlas in
+   rect.  Returns the atlas's surface, or NULL if the atlas hasn't been built
+   or has no such sprite. */
+SDL_Surface *atlas_find(const Atlas *a, const char *name, SDL_Rect *rect)
+{
+	int i;
+
+	if (!a->surface) return NULL;
+	for (i = 0; i < a->num_sprites; i++) {
+		if (strcmp(a->sprites[i].name, name) == 0) {
+			*rect = a->sprites[i].rect;
+			return a->surface;
+		}
+	}
+	return NULL;
+}
+
+/* Draws the given rectangle of the atlas (e.g., a sprite, or a frame of one)
+   to the given surface at dst_rect's position, leaving its transparent pixels
+   alone.  Like SDL_BlitSurface(), the drawing is clipped to the surface's clip
+   rectangle, and dst_rect is set to the area that was drawn on. */
+void atlas_blit(const Atlas *a, SDL_Rect *src, SDL_Surface *dst, SDL_Rect *dst_rect)
+{
+	SDL_Surface *s = a->surface;
+	const SDL_Rect *clip = &dst->clip_rect;
+	int sx, sy, dx, dy, w, h, bpp, j;
+
+	/* Sprites are only ever drawn to surfaces in the atlas's format, but let SDL
+	   convert them if they aren't. */
+	if (dst->format->BytesPerPixel != s->format->BytesPerPixel ||
+		dst->format->Rmask != s->format->Rmask || dst->format->Gmask != s->format->Gmask ||
+		dst->format->Bmask != s->format->Bmask) {
+		SDL_BlitSurface(s, src, dst, dst_rect);
+		return;
+	}
+
+	sx = src->x;
+	sy = src->y;
+	w = src->w;
+	h = src->h;
+	dx = dst_rect->x;
+	dy = dst_rect->y;
+
+	/* Clip to the atlas... */
+	if (sx < 0) { dx -= sx; w += sx; sx = 0; }
+	if (sy < 0) { dy -= sy; h += sy; sy = 0; }
+	if (sx + w > s->w) w = s->w - sx;
+	if (sy + h > s->h) h = s->h - sy;
+
+	/* ...and to the destination's clip rectangle. */
+	if (dx < clip->x) { sx += clip->x - dx; w -= clip->x - dx; dx = clip->x; }
+	if (dy < clip->y) { sy += clip->y - dy; h -= clip->y - dy; dy = clip->y; }
+	if (dx + w > clip->x + clip->w) w = clip->x + clip->w - dx;
+	if (dy + h > clip->y + clip->h) h = clip->y + clip->h - dy;
+
+	if (w <= 0 || h <= 0) {
+		dst_rect->w = dst_rect->h = 0;
+		return;
+	}
+	dst_rect->x = (Sint16) dx;
+	dst_rect->y = (Sint16) dy;
+	dst_rect->w = (Uint16) w;
+	dst_rect->h = (Uint16) h;
+
+	bpp = s->format->BytesPerPixel;
+	if (SDL_MUSTLOCK(dst)) SDL_LockSurface(dst);
+	if (SDL_MUSTLOCK(s)) SDL_LockSurface(s);
+
+	for (j = 0; j < h; j++) {
+		const AtlasRun *run = &a->runs[a->row_runs[sy + j]];
+		const AtlasRun *end = &a->runs[a->row_runs[sy + j + 1]];
+		const Uint8 *src_row = (const Uint8 *) s->pixels + (sy + j)*s->pitch;
+		Uint8 *dst_row = (Uint8 *) dst->pixels + (dy + j)*dst->pitch;
+
+		/* Find the first run that reaches into the rectangle. */
+		while (run < end) {
+			const AtlasRun *mid = run + (end - run) / 2;
+
+			if (mid->x + mid->w <= sx)
+				run = mid + 1;
+			else
+				end = mid;
+		}
+		end = &a->runs[a->row_runs[sy + j + 1]];
+
+		for (; run < end && run->x < sx + w; run++) {
+			int x1 = run->x > sx ? run->x : sx;
+			int x2 = run->x + run->w < sx + w ? run->x + run->w : sx + w;
+
+			g_atlas_copy(dst_row + (dx + x1 - sx)*bpp, src_row + x1*bpp, (x2 - x1)*bpp);
+		}
+	}
+
+	if (SDL_MUSTLOCK(s)) SDL_UnlockSurface(s);
+	if (SDL_MUSTLOCK(dst)) SDL_UnlockSurface(dst);
+}
+
+/* Frees the atlas, and any sprites that were added but never built into it. */
+void atlas_destroy(Atlas *a)
+{
+	int i;
+
+	for (i = 0; i < a->num_sprites; i++)
+		if (a->sprites[i].source) SDL_FreeSurface(a->sprites[i].source);
+	if (a->surface) SDL_FreeSurface(a->surface);
+	free(a->runs);
+	free(a->row_runs);
+	atlas_init(a);
+}
@@ -0,0 +1,73 @@
+#ifndef INCLUDE_ATLAS
+#define INCLUDE_ATLAS
+
+/* atlas.h
+
+   Sprite atlas module.
+
+   An atlas packs many sprites and tiles into one surface in the screen's
+   pixel format, so that each of them is converted to that format once, and
+   every blit of them comes from the same source surface.  Sprites are added
+   under a name, then the atlas is built, and from then on each one is looked
+   up by name as a sub-rectangle of the atlas.
+
+   The sprites are packed onto shelves, tallest first, left to right, starting
+   a new shelf below the last one whenever a sprite doesn't fit on it.  The
+   transparent pixels of sprites that have a color key all become the atlas's
+   own color key, which is picked so that no opaque pixel of any sprite has
+   it.
+
+   Sprites are drawn with atlas_blit() rather than SDL_BlitSurface().  When
+   the atlas is built, each of its rows is broken into runs of opaque pixels,
+   so drawing a sprite is a straight copy of each run that falls inside it,
+   with no per-pixel test of the color key.  The copies use the widest vector
+   loads and stores the processor has (AVX2 or SSE2), picked at run time.
+*/
+
+#include "SDL.h"
+
+/* Most sprites an atlas can hold. */
+#define ATLAS_MAX_SPRITES 32
+
+/* Most characters in a sprite's name (including the terminating NUL). */
+#define ATLAS_NAME_SIZE 32
+
+/* Narrowest an atlas can be.  It's the smallest power of two at least this
+   wide that fits the widest sprite. */
+#define ATLAS_MIN_WIDTH 256
+
+/* One sprite of an atlas. */
+typedef struct AtlasSprite {
+	char name[ATLAS_NAME_SIZE];
+	/* Where the sprite is on the atlas. */
+	SDL_Rect rect;
+	/* The sprite's own surface, until the atlas is built. */
+	SDL_Surface *source;
+} AtlasSprite;
+
+/* A run of opaque pixels on one row of an atlas. */
+typedef struct AtlasRun {
+	Uint16 x, w;
+} AtlasRun;
+
+/* The atlas structure. */
+typedef struct Atlas {
+	/* The packed sprites, or NULL if the atlas hasn't been built yet. */
+	SDL_Surface *surface;
+	int num_sprites;
+	AtlasSprite sprites[ATLAS_MAX_SPRITES];
+
+	/* The opaque runs of every row, left to right, one row after another;
+	   row y's are runs[row_runs[y]] up to runs[row_runs[y+1]]. */
+	AtlasRun *runs;
+	Uint32 *row_runs;
+} Atlas;
+
+void atlas_init(Atlas *a);
+void atlas_add(Atlas *a, const char *name, SDL_Surface *s);
+void atlas_build(Atlas *a);
+SDL_Surface *atlas_find(const Atlas *a, const char *name, SDL_Rect *rect);
+void atlas_blit(const Atlas *a, SDL_Rect *src, SDL_Surface *dst, SDL_Rect *dst_rect);
+void atlas_destroy(Atlas *a);
+
+#endif
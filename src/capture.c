@@ -0,0 +1,396 @@
+#include "globals.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPTURE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "game.h"
+#include "debug.h"
+#include "render.h"
+#include "capture.h"
+
+/* Size of the video file's stdio buffer. */
+#define CAPTURE_FILE_BUFFER (1 << 20)
+
+/* Channels of a 5-6-5 pixel, widened to 8 bits by repeating their top bits in
+   the bottom ones, so that white stays white. */
+#define CAPTURE_R(p) ((((p) >> 11) << 3) | ((p) >> 13))
+#define CAPTURE_G(p) (((((p) >> 5) & 63) << 2) | (((p) >> 9) & 3))
+#define CAPTURE_B(p) ((((p) & 31) << 3) | (((p) >> 2) & 7))
+
+/* One frame in the queue. */
+typedef struct CaptureSlot {
+	/* The frame, in 5-6-5 RGB. */
+	SDL_Surface *frame;
+	/* Number of times in a row to write the frame to the video, or 0 to tell
+	   the writer to stop. */
+	Uint32 repeat;
+} CaptureSlot;
+
+/* The video file, or NULL if nothing's being captured. */
+static FILE *g_capture_file = NULL;
+static int g_capture_format;
+static int g_capture_policy;
+static int g_capture_fps;
+static Uint32 g_capture_max_frames;
+
+/* The queue.  The game puts frames in at g_capture_tail, and the writer takes
+   them out at g_capture_head;  g_capture_free counts the slots the game can
+   fill, and g_capture_full the ones the writer has yet to write. */
+static CaptureSlot g_capture_slots[CAPTURE_QUEUE_FRAMES];
+static int g_capture_head, g_capture_tail;
+static SDL_sem *g_capture_free;
+static SDL_sem *g_capture_full;
+
+/* The writer thread, or NULL if it hasn't been started yet (it's started
+   when the first frame comes in, since that's when the size is known). */
+static SDL_Thread *g_capture_thread = NULL;
+
+/* Game time since the first frame, and the number of frames of video that have
+   been queued since (counting each repeat).  The time is added up here from
+   each frame's length, rather than read off TIMER_ID_GAME, since that timer
+   starts over from 0 whenever the game changes state. */
+static Uint32 g_capture_ticks;
+static Uint32 g_capture_frames;
+
+/* Number of frames of video that were dropped because the queue was full (and
+   shown as repeats of a later one instead), and the last one that was. */
+static Uint32 g_capture_dropped;
+static Uint32 g_capture_last_dropped;
+
+/* Set by the writer if it couldn't write to the file. */
+static int g_capture_write_failed;
+
+/* Converts two rows of 5-6-5 pixels, starting at column x, to Y in y0 and y1, and
+   to U and V for each 2x2 block in u and v.  The last row or column is paired
+   with itself when there's an odd number of them. */
+void capture_convert_rows(const Uint16 *row0, const Uint16 *row1, int x, int w, Uint8 *y0, Uint8 *y1, Uint8 *u, Uint8 *v)
+{
+	for (; x < w; x += 2) {
+		int x1 = (x + 1 < w) ? x + 1 : x;
+		Uint32 p[4];
+		int r = 0, g = 0, b = 0;
+		int i, cb, cr;
+
+		p[0] = row0[x];
+		p[1] = row0[x1];
+		p[2] = row1[x];
+		p[3] = row1[x1];
+		for (i = 0; i < 4; i++) {
+			r += CAPTURE_R(p[i]);
+			g += CAPTURE_G(p[i]);
+			b += CAPTURE_B(p[i]);
+		}
+		y0[x] = (Uint8) ((77 * CAPTURE_R(p[0]) + 150 * CAPTURE_G(p[0]) + 29 * CAPTURE_B(p[0]) + 128) >> 8);
+		y1[x] = (Uint8) ((77 * CAPTURE_R(p[2]) + 150 * CAPTURE_G(p[2]) + 29 * CAPTURE_B(p[2]) + 128) >> 8);
+		if (x1 != x) {
+			y0[x1] = (Uint8) ((77 * CAPTURE_R(p[1]) + 150 * CAPTURE_G(p[1]) + 29 * CAPTURE_B(p[1]) + 128) >> 8);
+			y1[x1] = (Uint8) ((77 * CAPTURE_R(p[3]) + 150 * CAPTURE_G(p[3]) + 29 * CAPTURE_B(p[3]) + 128) >> 8);
+		}
+
+		/* The same sums as the SSE2 version, which saturates at 16 bits. */
+		r = (r + 2) >> 2;
+		g = (g + 2) >> 2;
+		b = (b + 2) >> 2;
+		cb = -43 * r - 85 * g + 128 * b + 128;
+		cr = 128 * r - 107 * g - 21 * b + 128;
+		if (cb > 32767) cb = 32767;
+		if (cr > 32767) cr = 32767;
+		u[x / 2] = (Uint8) ((cb + 32768) >> 8);
+		v[x / 2] = (Uint8) ((cr + 32768) >> 8);
+	}
+}
+
+#ifdef CAPTURE_USE_SSE2
+/* Splits eight 5-6-5 pixels into their channels, widened to 8 bits. */
+static void capture_unpack_sse2(__m128i p, __m128i *r, __m128i *g, __m128i *b)
+{
+	__m128i r5 = _mm_srli_epi16(p, 11);
+	__m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), _mm_set1_epi16(63));
+	__m128i b5 = _mm_and_si128(p, _mm_set1_epi16(31));
+
+	*r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+	*g = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+	*b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+}
+
+/* Y of eight pixels.  The sum is at most 65408, so it fits in 16 unsigned bits. */
+static __m128i capture_luma_sse2(__m128i r, __m128i g, __m128i b)
+{
+	__m128i sum = _mm_mullo_epi16(r, _mm_set1_epi16(77));
+
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+}
+
+/* Averages each 2x2 block of a channel of sixteen pixels in two rows (lo0 and
+   hi0 in the first, lo1 and hi1 in the second), giving eight values. */
+static __m128i capture_average_sse2(__m128i lo0, __m128i hi0, __m128i lo1, __m128i hi1)
+{
+	__m128i ones = _mm_set1_epi16(1);
+	__m128i lo = _mm_madd_epi16(_mm_add_epi16(lo0, lo1), ones);
+	__m128i hi = _mm_madd_epi16(_mm_add_epi16(hi0, hi1), ones);
+
+	return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(2)), 2);
+}
+
+/* U or V of eight averaged pixels, with the given weights of r, g and b.  None of
+   the partial sums go past 16 signed bits;  the rounding only saturates at the
+   very top. */
+static __m128i capture_chroma_sse2(__m128i r, __m128i g, __m128i b, short kr, short kg, short kb)
+{
+	__m128i sum = _mm_mullo_epi16(r, _mm_set1_epi16(kr));
+
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(g, _mm_set1_epi16(kg)));
+	sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+	sum = _mm_adds_epi16(sum, _mm_set1_epi16(128));
+	return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+/* capture_convert_rows() for as many whole runs of 16 pixels as the rows have.
+   Returns the column it got up to. */
+static int capture_convert_rows_sse2(const Uint16 *row0, const Uint16 *row1, int w, Uint8 *y0, Uint8 *y1, Uint8 *u, Uint8 *v)
+{
+	__m128i zero = _mm_setzero_si128();
+	int x;
+
+	for (x = 0; x + 16 <= w; x += 16) {
+		__m128i r[4], g[4], b[4];
+		__m128i ra, ga, ba;
+
+		capture_unpack_sse2(_mm_loadu_si128((const __m128i *) (row0 + x)), &r[0], &g[0], &b[0]);
+		capture_unpack_sse2(_mm_loadu_si128((const __m128i *) (row0 + x + 8)), &r[1], &g[1], &b[1]);
+		capture_unpack_sse2(_mm_loadu_si128((const __m128i *) (row1 + x)), &r[2], &g[2], &b[2]);
+		capture_unpack_sse2(_mm_loadu_si128((const __m128i *) (row1 + x + 8)), &r[3], &g[3], &b[3]);
+
+		_mm_storeu_si128((__m128i *) (y0 + x), _mm_packus_epi16(capture_luma_sse2(r[0], g[0], b[0]), capture_luma_sse2(r[1], g[1], b[1])));
+		_mm_storeu_si128((__m128i *) (y1 + x), _mm_packus_epi16(capture_luma_sse2(r[2], g[2], b[2]), capture_luma_sse2(r[3], g[3], b[3])));
+
+		ra = capture_average_sse2(r[0], r[1], r[2], r[3]);
+		ga = capture_average_sse2(g[0], g[1], g[2], g[3]);
+		ba = capture_average_sse2(b[0], b[1], b[2], b[3]);
+		_mm_storel_epi64((__m128i *) (u + x / 2), _mm_packus_epi16(capture_chroma_sse2(ra, ga, ba, -43, -85, 128), zero));
+		_mm_storel_epi64((__m128i *) (v + x / 2), _mm_packus_epi16(capture_chroma_sse2(ra, ga, ba, 128, -107, -21), zero));
+	}
+	return x;
+}
+#endif
+
+/* Converts a w x h frame of 5-6-5 pixels, pitch bytes apart from one row to the
+   next, to 4:2:0 YUV with JPEG (full range) levels.  The U and V planes are
+   (w+1)/2 x (h+1)/2. */
+void capture_rgb565_to_yuv420(const Uint16 *pixels, int pitch, int w, int h, Uint8 *y_plane, Uint8 *u_plane, Uint8 *v_plane)
+{
+	int cw = (w + 1) / 2;
+	int y;
+
+	for (y = 0; y < h; y += 2) {
+		const Uint16 *row0 = (const Uint16 *) ((const Uint8 *) pixels + y * pitch);
+		const Uint16 *row1 = (y + 1 < h) ? (const Uint16 *) ((const Uint8 *) row0 + pitch) : row0;
+		Uint8 *y0 = y_plane + y * w;
+		/* The Y of an odd last row is written to a row of its own twice. */
+		Uint8 *y1 = (y + 1 < h) ? y0 + w : y0;
+		Uint8 *u = u_plane + (y / 2) * cw;
+		Uint8 *v = v_plane + (y / 2) * cw;
+		int x = 0;
+
+#ifdef CAPTURE_USE_SSE2
+		x = capture_convert_rows_sse2(row0, row1, w, y0, y1, u, v);
+#endif
+		capture_convert_rows(row0, row1, x, w, y0, y1, u, v);
+	}
+}
+
+/* Writes a frame to the video file as a PPM image, using the given buffer for a
+   row of it. */
+void capture_write_ppm(SDL_Surface *frame, Uint8 *row)
+{
+	int x, y;
+
+	fprintf(g_capture_file, "P6\n%d %d\n255\n", frame->w, frame->h);
+	for (y = 0; y < frame->h; y++) {
+		const Uint16 *pixels = (const Uint16 *) ((const Uint8 *) frame->pixels + y * frame->pitch);
+
+		for (x = 0; x < frame->w; x++) {
+			row[x*3] = (Uint8) CAPTURE_R(pixels[x]);
+			row[x*3+1] = (Uint8) CAPTURE_G(pixels[x]);
+			row[x*3+2] = (Uint8) CAPTURE_B(pixels[x]);
+		}
+		fwrite(row, 3, frame->w, g_capture_file);
+	}
+}
+
+/* Main function of the writer thread. */
+int capture_writer(void *data)
+{
+	SDL_Surface *first = g_capture_slots[0].frame;
+	int w = first->w, h = first->h;
+	size_t y_size = (size_t) w * h;
+	size_t c_size = (size_t) ((w + 1) / 2) * ((h + 1) / 2);
+	Uint8 *buffer;
+
+	/* Room for one frame of YUV, which is also more than a row of RGB needs. */
+	buffer = (Uint8 *) malloc(y_size + 2 * c_size);
+	assert(buffer != NULL);
+
+	if (g_capture_format == CAPTURE_FORMAT_Y4M)
+		fprintf(g_capture_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, g_capture_fps);
+
+	while (1) {
+		CaptureSlot *slot;
+		Uint32 i;
+
+		SDL_SemWait(g_capture_full);
+		slot = &g_capture_slots[g_capture_head];
+		if (slot->repeat == 0) break;
+
+		if (g_capture_format == CAPTURE_FORMAT_Y4M) {
+			capture_rgb565_to_yuv420((const Uint16 *) slot->frame->pixels, slot->frame->pitch, w, h,
+				buffer, buffer + y_size, buffer + y_size + c_size);
+			for (i = 0; i < slot->repeat; i++) {
+				fputs("FRAME\n", g_capture_file);
+				fwrite(buffer, 1, y_size + 2 * c_size, g_capture_file);
+			}
+		} else {
+			for (i = 0; i < slot->repeat; i++)
+				capture_write_ppm(slot->frame, buffer);
+		}
+		if (ferror(g_capture_file)) g_capture_write_failed = 1;
+
+		g_capture_head = (g_capture_head + 1) % CAPTURE_QUEUE_FRAMES;
+		SDL_SemPost(g_capture_free);
+	}
+
+	free(buffer);
+	return 0;
+}
+
+/* Starts capturing the game screen to a video file at the given path, in the
+   given CAPTURE_FORMAT_*, with fps frames per second of game time, dropping
+   frames according to the given CAPTURE_POLICY_*.  Once max_frames frames of
+   video have been captured (unless it's 0), the game is told to quit.  Returns
+   0 if the file couldn't be opened. */
+int capture_start(const char *path, int format, int policy, int fps, Uint32 max_frames)
+{
+	assert(g_capture_file == NULL);
+	assert(fps > 0);
+
+	g_capture_file = fopen(path, "wb");
+	if (!g_capture_file) {
+		fprintf(stderr, "Couldn't open capture file %s.\n", path);
+		return 0;
+	}
+	setvbuf(g_capture_file, NULL, _IOFBF, CAPTURE_FILE_BUFFER);
+
+	g_capture_format = format;
+	g_capture_policy = policy;
+	g_capture_fps = fps;
+	g_capture_max_frames = max_frames;
+	g_capture_frames = 0;
+	g_capture_dropped = 0;
+	g_capture_last_dropped = 0;
+	g_capture_write_failed = 0;
+	g_capture_thread = NULL;
+	return 1;
+}
+
+/* Makes the queue for frames the size of the given screen, and starts the
+   writer thread. */
+void capture_start_writer(SDL_Surface *screen)
+{
+	int i;
+
+	for (i = 0; i < CAPTURE_QUEUE_FRAMES; i++) {
+		g_capture_slots[i].frame = render_framebuffer_create(screen->w, screen->h, 16);
+		assert(g_capture_slots[i].frame != NULL);
+	}
+	g_capture_head = g_capture_tail = 0;
+	g_capture_free = SDL_CreateSemaphore(CAPTURE_QUEUE_FRAMES);
+	g_capture_full = SDL_CreateSemaphore(0);
+	g_capture_thread = SDL_CreateThread(capture_writer, NULL);
+	assert(g_capture_thread != NULL);
+}
+
+/* Hands the given screen to the video, if a frame is due by now.  frame_time is
+   the number of ms of game time the frame moved the game on by.  Should be
+   called once a frame, after it's drawn and the screen is unlocked.  Does
+   nothing if nothing's being captured. */
+void capture_frame(SDL_Surface *screen, Uint32 frame_time)
+{
+	CaptureSlot *slot;
+	Uint32 due;
+
+	if (!g_capture_file) return;
+
+	if (!g_capture_thread) {
+		capture_start_writer(screen);
+		g_capture_ticks = 0;
+	} else {
+		g_capture_ticks += frame_time;
+	}
+
+	/* Frames of video that should have been captured by now, counting this one.
+	   Any that were missed (because the game was slow, or because they were
+	   dropped) are made up with repeats of this one. */
+	due = (Uint32) ((double) g_capture_ticks * g_capture_fps / 1000) + 1;
+	if (g_capture_max_frames && due > g_capture_max_frames) due = g_capture_max_frames;
+	if (due <= g_capture_frames) return;
+
+	if (g_capture_policy == CAPTURE_POLICY_WAIT) {
+		SDL_SemWait(g_capture_free);
+	} else if (SDL_SemTryWait(g_capture_free) != 0) {
+		if (g_capture_last_dropped < g_capture_frames) g_capture_last_dropped = g_capture_frames;
+		g_capture_dropped += due - g_capture_last_dropped;
+		g_capture_last_dropped = due;
+		return;
+	}
+
+	slot = &g_capture_slots[g_capture_tail];
+	SDL_BlitSurface(screen, NULL, slot->frame, NULL);
+	slot->repeat = due - g_capture_frames;
+	g_capture_tail = (g_capture_tail + 1) % CAPTURE_QUEUE_FRAMES;
+	g_capture_frames = due;
+	SDL_SemPost(g_capture_full);
+
+	if (g_capture_max_frames && g_capture_frames >= g_capture_max_frames)
+		game_quit();
+}
+
+/* Writes out whatever's left in the queue, stops the writer thread and closes
+   the video file.  Does nothing if nothing's being captured. */
+void capture_stop()
+{
+	int i;
+
+	if (!g_capture_file) return;
+
+	if (g_capture_thread) {
+		SDL_SemWait(g_capture_free);
+		g_capture_slots[g_capture_tail].repeat = 0;
+		SDL_SemPost(g_capture_full);
+		SDL_WaitThread(g_capture_thread, NULL);
+		g_capture_thread = NULL;
+
+		for (i = 0; i < CAPTURE_QUEUE_FRAMES; i++)
+			render_framebuffer_free(g_capture_slots[i].frame);
+		SDL_DestroySemaphore(g_capture_free);
+		SDL_DestroySemaphore(g_capture_full);
+	}
+
+	if (fclose(g_capture_file) != 0) g_capture_write_failed = 1;
+	g_capture_file = NULL;
+
+	if (g_capture_write_failed)
+		err("Couldn't write the whole capture file.\n", 0);
+	if (g_capture_dropped)
+		fprintf(stderr, "Captured %u frames;  dropped %u because the writer fell behind.\n", g_capture_frames, g_capture_dropped);
+}
@@ -0,0 +1,51 @@
+#ifndef INCLUDE_CAPTURE
+#define INCLUDE_CAPTURE
+
+/* capture.h
+
+   Frame capture module.
+
+   Records the game screen to a raw video file as the game runs:  either a
+   YUV4MPEG2 (Y4M) stream in 4:2:0 JPEG-range YUV, or a stream of PPM images
+   one after another, which tools like ffmpeg can read as they are.
+
+   Frames are taken at a fixed rate of game time, so the video plays back at
+   the speed the game was played at no matter how fast the game loop ran.
+   Each frame that's taken is copied into a bounded queue, and converted and
+   written out on a writer thread of its own, so the game loop only ever pays
+   for the copy.  If the writer falls behind and the queue fills up, the
+   CAPTURE_POLICY_* given to capture_start() says whether the game waits for
+   it or drops the frame;  a dropped frame is made up for by showing the next
+   one that gets through for longer, so the video still keeps time.
+
+   The screen is converted to 5-6-5 RGB as it's copied (if it isn't already),
+   and from there to YUV on the writer thread with SSE2 where it's available.
+*/
+
+#include "SDL.h"
+
+/* Number of frames the queue holds. */
+#define CAPTURE_QUEUE_FRAMES 8
+
+/* Frame rate of the video, in frames per second of game time, unless another
+   is asked for on the command line. */
+#define CAPTURE_DEFAULT_FPS 30
+
+/* The CAPTURE_FORMAT_* constants are the kinds of video file. */
+#define CAPTURE_FORMAT_Y4M 0
+#define CAPTURE_FORMAT_PPM 1
+
+/* The CAPTURE_POLICY_* constants say what to do with a frame when the queue is
+   full. */
+
+/* Drop the frame, so the game never waits for the writer. */
+#define CAPTURE_POLICY_DROP 0
+/* Wait for the writer to make room, so no frame is ever dropped. */
+#define CAPTURE_POLICY_WAIT 1
+
+int capture_start(const char *path, int format, int policy, int fps, Uint32 max_frames);
+void capture_frame(SDL_Surface *screen, Uint32 frame_time);
+void capture_stop();
+void capture_rgb565_to_yuv420(const Uint16 *pixels, int pitch, int w, int h, Uint8 *y_plane, Uint8 *u_plane, Uint8 *v_plane);
+
+#endif
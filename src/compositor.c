@@ -0,0 +1,73 @@
+#include "globals.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "game.h"
+#include "compositor.h"
+
+/* Empties all of the compositor's layers, and forgets what's dirty on them. */
+void compositor_init(Compositor *c)
+{
+	int i;
+
+	for (i = 0; i < COMPOSITOR_NUM_LAYERS; i++) {
+		c->layers[i].draw = NULL;
+		c->layers[i].data = NULL;
+		rect_list_reset(&c->layers[i].dirty);
+	}
+	rect_list_reset(&c->damage);
+}
+
+/* Sets the function that draws the given layer, and the data it's passed. */
+void compositor_set_layer(Compositor *c, int layer, GameLayerDraw draw, void *data)
+{
+	assert(layer >= 0 && layer < COMPOSITOR_NUM_LAYERS);
+	c->layers[layer].draw = draw;
+	c->layers[layer].data = data;
+}
+
+/* Marks the given rectangle of the given layer as having changed. */
+void compositor_invalidate(Compositor *c, int layer, SDL_Rect *r)
+{
+	assert(layer >= 0 && layer < COMPOSITOR_NUM_LAYERS);
+	rect_list_add(&c->layers[layer].dirty, r);
+}
+
+/* Redraws every layer into every area of the surface that's dirty on any layer
+   or that's in the given list of extra rectangles (which can be NULL), and
+   leaves the areas that were redrawn in c->damage.  Afterwards, nothing is dirty. */
+void compositor_draw(Compositor *c, SDL_Surface *surface, const RectList *extra)
+{
+	SDL_Rect old_clip_rect;
+	SDL_Rect r;
+	int i, j;
+
+	rect_list_reset(&c->damage);
+	for (i = 0; i < COMPOSITOR_NUM_LAYERS; i++) {
+		RectList *dirty = &c->layers[i].dirty;
+
+		for (j = 0; j < dirty->numrects; j++)
+			rect_list_add(&c->damage, &dirty->rects[j]);
+		rect_list_reset(dirty);
+	}
+	if (extra) {
+		for (j = 0; j < extra->numrects; j++)
+			rect_list_add(&c->damage, (SDL_Rect *) &extra->rects[j]);
+	}
+
+	if (c->damage.numrects == 0) return;
+
+	SDL_GetClipRect(surface, &old_clip_rect);
+	for (i = 0; i < c->damage.numrects; i++) {
+		r = c->damage.rects[i];
+		SDL_SetClipRect(surface, &r);
+		for (j = 0; j < COMPOSITOR_NUM_LAYERS; j++) {
+			if (c->layers[j].draw)
+				c->layers[j].draw(surface, &r, c->layers[j].data);
+		}
+	}
+	SDL_SetClipRect(surface, &old_clip_rect);
+}
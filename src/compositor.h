@@ -0,0 +1,60 @@
+#ifndef INCLUDE_COMPOSITOR
+#define INCLUDE_COMPOSITOR
+
+/* compositor.h
+
+   Layered screen compositor.
+
+   The screen is built up out of layers, from the bottom one to the top one.
+   Each layer is drawn by a function that's given a rectangle of the screen and
+   draws whatever of the layer is in it (the surface's clipping rectangle is set
+   to the same rectangle, so it can just draw everything that touches it).
+
+   Whenever something on a layer changes, the area it changed in is marked
+   dirty on that layer.  When a frame is drawn, the dirty areas of all the
+   layers are merged, and every layer is drawn into each merged area again,
+   bottom first, so that whatever's above and below the change comes out
+   right, and nothing else on the screen is touched.  Since nothing clears an
+   area before the layers are drawn into it, the bottom layer of everything
+   that's drawn this way has to be opaque.
+*/
+
+#include "SDL.h"
+
+#include "game.h"
+
+/* The COMPOSITOR_LAYER_* constants are the layers, from the bottom up. */
+
+/* The board's walls, which don't change during a level. */
+#define COMPOSITOR_LAYER_WALLS   0
+/* The nibblets and nibbloons left on the board. */
+#define COMPOSITOR_LAYER_NIBS    1
+/* Pac man, the ghosts and the fruit. */
+#define COMPOSITOR_LAYER_SPRITES 2
+/* The scoreboard, and text shown over the board. */
+#define COMPOSITOR_LAYER_HUD     3
+/* The framerate statistics. */
+#define COMPOSITOR_LAYER_OVERLAY 4
+#define COMPOSITOR_NUM_LAYERS    5
+
+/* One layer, and the areas that have changed on it since it was last drawn. */
+typedef struct CompositorLayer {
+	/* Draws the layer, or NULL if nothing's on this layer. */
+	GameLayerDraw draw;
+	void *data;
+	RectList dirty;
+} CompositorLayer;
+
+/* The compositor structure. */
+typedef struct Compositor {
+	CompositorLayer layers[COMPOSITOR_NUM_LAYERS];
+	/* The areas that were redrawn by the last compositor_draw(). */
+	RectList damage;
+} Compositor;
+
+void compositor_init(Compositor *c);
+void compositor_set_layer(Compositor *c, int layer, GameLayerDraw draw, void *data);
+void compositor_invalidate(Compositor *c, int layer, SDL_Rect *r);
+void compositor_draw(Compositor *c, SDL_Surface *surface, const RectList *extra);
+
+#endif
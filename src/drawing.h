@@ -11,6 +11,10 @@
    routines will clip along the x-axis of the surface they draw to, but not
    the y-axis (this is because pman needs x-axis clipping when game agents
    go through the wraparound tunnel).
+
+   There's a copy of each routine for each pixel format (see drawing_bpp.h),
+   and the right one is picked once per call from the surface's format, so
+   no format is ever looked at pixel by pixel.
 */
 
 #include "SDL.h"
@@ -28,6 +32,7 @@
 #define FILL_TOP_HALF_ONLY 2
 
 int map_fixed_vector_to_direction(FixedVector *v);
+const FixedVector *map_direction_to_fixed_vector(int direction);
 
 void drawCircle(SDL_Surface *screen, int x1, int y1, int r, int filled, Uint32 color);
 
@@ -0,0 +1,378 @@
+/* drawing_bpp.h
+
+   The drawing primitives for one pixel format.
+
+   This file is included by drawing.c once for each pixel format, with
+   DRAWING_BITS defined to its number of bits per pixel (8, 16, 24 or 32), and
+   defines its own copy of each primitive with that number on the end of its
+   name (e.g. drawLine16()).  Each copy writes pixels of its format directly,
+   so none of them ever has to look at the surface's format;  drawing.c picks
+   the right set once per shape, from the format of the surface it's drawing
+   to.
+
+   There's no include guard, since it's meant to be included more than once.
+*/
+
+#define DRAWING_FN(name) DRAWING_PASTE(name, DRAWING_BITS)
+
+/* DRAWING_PUT stores a pixel of the given color at column x of the given row,
+   and DRAWING_FILL_SPAN fills n of them starting there. */
+#if DRAWING_BITS == 8
+#define DRAWING_PUT(row, x, color) (((Uint8 *) (row))[x] = (Uint8) (color))
+#define DRAWING_FILL_SPAN(row, x, n, color) memset((Uint8 *) (row) + (x), (Uint8) (color), (n))
+#elif DRAWING_BITS == 16
+#define DRAWING_PUT(row, x, color) (((Uint16 *) (row))[x] = (Uint16) (color))
+#define DRAWING_FILL_SPAN(row, x, n, color) fillSpan16((Uint16 *) (row) + (x), (n), (Uint16) (color))
+#elif DRAWING_BITS == 24
+#define DRAWING_PUT(row, x, color) fillSpan24((Uint8 *) (row) + (x) * 3, 1, (color))
+#define DRAWING_FILL_SPAN(row, x, n, color) fillSpan24((Uint8 *) (row) + (x) * 3, (n), (color))
+#elif DRAWING_BITS == 32
+#define DRAWING_PUT(row, x, color) (((Uint32 *) (row))[x] = (Uint32) (color))
+#define DRAWING_FILL_SPAN(row, x, n, color) fillSpan32((Uint32 *) (row) + (x), (n), (Uint32) (color))
+#else
+#error DRAWING_BITS must be 8, 16, 24 or 32.
+#endif
+
+/* Taken from SDL tutorial code at \lib_sdl\docs\html\guidevideo.html */
+static void DRAWING_FN(drawPixel)(SDL_Surface *screen, int x, int y, Uint32 color)
+{
+	if (x < screen->clip_rect.x || x >= screen->clip_rect.x + screen->clip_rect.w) return;
+
+	DRAWING_PUT((Uint8 *) screen->pixels + y*screen->pitch, x, color);
+}
+
+/* Draws a horizontal line.  It's clipped once, then filled a whole span at a
+   time, so every filled shape is drawn with it rather than with drawPixel(). */
+static void DRAWING_FN(drawHLine)(SDL_Surface *screen, int x1, int y1, int x2, Uint32 color)
+{
+	int n;
+
+	if (x1 > x2) {
+		int temp_x;
+
+		temp_x = x1;
+		x1 = x2;
+		x2 = temp_x;
+	}
+
+	if (x1 < screen->clip_rect.x) x1 = screen->clip_rect.x;
+	if (x2 >= screen->clip_rect.x + screen->clip_rect.w) x2 = screen->clip_rect.x + screen->clip_rect.w - 1;
+	n = x2 - x1 + 1;
+	if (n <= 0) return;
+
+	DRAWING_FILL_SPAN((Uint8 *) screen->pixels + y1*screen->pitch, x1, n, color);
+}
+
+/* Circle-filling algorithm, to be used instead of fillArcPoint to draw filled circles
+   instead of outlines.  If given a center and a point on the 1/8 circle arc, fills 4
+   parts of the circle with it.  The rows y away from the center get wider with
+   every point until y changes, so they're only filled once they're as wide as
+   they'll get (when last_in_row is nonzero). */
+static void DRAWING_FN(fillArcPoint)(SDL_Surface *screen, int x1, int y1, int x, int y, int amount_filled, int last_in_row, Uint32 color)
+{
+	if (last_in_row)
+		DRAWING_FN(drawHLine)(screen, x1-x, y1-y, x1+x, color);
+	DRAWING_FN(drawHLine)(screen, x1-y, y1-x, x1+y, color);
+	if (amount_filled != FILL_TOP_HALF_ONLY) {
+		DRAWING_FN(drawHLine)(screen, x1-y, y1+x, x1+y, color);
+		if (last_in_row)
+			DRAWING_FN(drawHLine)(screen, x1-x, y1+y, x1+x, color);
+	}
+}
+
+/* Circle-outline drawing.  Given a center and a point on the 1/8 circle arc, draws
+   the 8 corresponding points on the circle by mirroring along the x, y, and x=y
+   axes. */
+static void DRAWING_FN(drawArcPoint)(SDL_Surface *screen, int x1, int y1, int x, int y, Uint32 color)
+{
+	DRAWING_FN(drawPixel)(screen, x1+x, y1-y, color);
+	DRAWING_FN(drawPixel)(screen, x1+y, y1-x, color);
+	DRAWING_FN(drawPixel)(screen, x1-x, y1+y, color);
+	DRAWING_FN(drawPixel)(screen, x1-y, y1+x, color);
+
+	DRAWING_FN(drawPixel)(screen, x1+x, y1+y, color);
+	DRAWING_FN(drawPixel)(screen, x1+y, y1+x, color);
+	DRAWING_FN(drawPixel)(screen, x1-x, y1-y, color);
+	DRAWING_FN(drawPixel)(screen, x1-y, y1-x, color);
+}
+
+/* Circle-drawing routine.  Derived using concepts covered in
+   http://www.cs.unc.edu/~davemc/Class/136/Lecture10/circle.html.
+   Set "filled" to the FILL_* constants. */
+static void DRAWING_FN(drawCircle)(SDL_Surface *screen, int x1, int y1, int r, int filled, Uint32 color)
+{
+	int curr_val = (5 - r*4)/4;
+
+	int x = 0;
+	int y = r;
+
+	if (filled) {
+		if (filled != FILL_TOP_HALF_ONLY)
+			DRAWING_FN(drawHLine)(screen, x1, y1+r, x1, color);
+		DRAWING_FN(drawHLine)(screen, x1, y1-r, x1, color);
+		DRAWING_FN(drawHLine)(screen, x1-r, y1, x1+r, color);
+	} else {
+		DRAWING_FN(drawPixel)(screen, x1, y1+r, color);
+		DRAWING_FN(drawPixel)(screen, x1, y1-r, color);
+		DRAWING_FN(drawPixel)(screen, x1+r, y1, color);
+		DRAWING_FN(drawPixel)(screen, x1-r, y1, color);
+	}
+
+	while (x < y) {
+		x++;
+		if (curr_val >= 0) {
+			curr_val += 2 + (x << 1) - (y << 1);
+			y--;
+		} else {
+			curr_val += 1 + (x << 1);
+		}
+		if (filled)
+			DRAWING_FN(fillArcPoint)(screen, x1, y1, x, y, filled, curr_val >= 0 || x >= y, color);
+		else
+			DRAWING_FN(drawArcPoint)(screen, x1, y1, x, y, color);
+	}
+}
+
+/* My implementation of the Bresenham Line Drawing Algorithm.  Derived using
+   concepts covered in http://www.cs.helsinki.fi/group/goa/mallinnus/lines/bresenh.html
+   and http://www.gamedev.net/reference/articles/article1275.asp. */
+static void DRAWING_FN(drawLine)(SDL_Surface *screen, int x1, int y1, int x2, int y2, Uint32 color)
+{
+	int deltax, deltay;
+	int x, y;
+
+	if (x1 > x2) {
+		int temp_x, temp_y;
+
+		temp_x = x1;
+		temp_y = y1;
+		x1 = x2;
+		y1 = y2;
+		x2 = temp_x;
+		y2 = temp_y;
+	}
+
+	deltax = x2 - x1;
+	deltay = y2 - y1;
+
+	x = x1;
+	y = y1;
+
+	DRAWING_FN(drawPixel)(screen, x, y, color);
+
+	/* Remember that we're using the computer's coordinate system, so
+	   the y-axis is reversed. */
+
+	/* If the line is in the 1st quadrant... */
+	if (deltay < 0) {
+		deltay = -deltay;
+		if (deltax > deltay) {
+			/* If its slope is less than 1 */
+			int y_counter = deltax >> 1;
+			while (x < x2) {
+				x++;
+				y_counter += deltay;
+				if (y_counter > deltax) {
+					y--;
+					y_counter -= deltax;
+				}
+				DRAWING_FN(drawPixel)(screen, x, y, color);
+			}
+		} else {
+			/* If its slope is greater than 1 */
+			int x_counter = deltay >> 1;
+			while (y > y2) {
+				y--;
+				x_counter += deltax;
+				if (x_counter > deltay) {
+					x++;
+					x_counter -= deltay;
+				}
+				DRAWING_FN(drawPixel)(screen, x, y, color);
+			}
+		}
+		return;
+	}
+
+	/* If the line is in the 4th quadrant... */
+	if (deltay > deltax) {
+		/* If its slope is greater than 1 */
+		int x_counter = deltay >> 1;
+		while (y < y2) {
+			y++;
+			x_counter += deltax;
+			if (x_counter > deltay) {
+				x++;
+				x_counter -= deltay;
+			}
+			DRAWING_FN(drawPixel)(screen, x, y, color);
+		}
+	} else {
+		/* If its slop is less than 1 */
+		int y_counter = deltax >> 1;
+		while (x < x2) {
+			x++;
+			y_counter += deltay;
+			if (y_counter > deltax) {
+				y++;
+				y_counter -= deltax;
+			}
+			DRAWING_FN(drawPixel)(screen, x, y, color);
+		}
+	}
+}
+
+/* Draws a flat-bottom triangle. */
+static void DRAWING_FN(drawFlatBottomTriangle)(SDL_Surface *screen, int a_x, int a_y, int b_x, int b_y, int c_x, int c_y, Uint32 color)
+{
+	int a_int;
+
+	int a_sx = b_x - a_x;
+	int a_sy = a_y - b_y;
+	int a_dir;
+
+	int start_x, start_x_num;
+	int c_sx, c_sy, c_dir;
+
+	int c_int;
+	int end_x, end_x_num;
+
+	int i;
+
+	if (a_sx < 0) {
+		a_sx = -a_sx;
+		a_dir = -1;
+	} else {
+		a_dir = 1;
+	}
+
+	/* Integral part of discriminate */
+	if (a_sy == 0) return;
+	a_int = a_sx / a_sy;
+
+	/* Fractional part of discriminate (numerator only, denominator is a_sy) */
+	a_sx -= a_int * a_sy;
+
+	a_int *= a_dir;
+
+	start_x = a_x;
+	start_x_num = a_sy >> 1;
+
+	c_sx = b_x - c_x;
+	c_sy = c_y - b_y;
+
+	if (c_sx < 0) {
+		c_sx = -c_sx;
+		c_dir = -1;
+	} else {
+		c_dir = 1;
+	}
+
+	/* Integral part of discriminate */
+	c_int = c_sx / c_sy;
+
+	/* Fractional part of discriminate (numerator only, denominator is a_sy) */
+	c_sx -= c_int * c_sy;
+
+	c_int *= c_dir;
+
+	end_x = c_x;
+	end_x_num = c_sy >> 1;
+
+	for (i = a_y; i >= b_y; i--) {
+		DRAWING_FN(drawHLine)(screen, start_x, i, end_x, color);
+		start_x += a_int;
+		start_x_num += a_sx;
+		if (start_x_num >= a_sy) {
+			start_x = start_x + a_dir;
+			start_x_num -= a_sy;
+		}
+		end_x += c_int;
+		end_x_num += c_sx;
+		if (end_x_num >= c_sy) {
+			end_x = end_x + c_dir;
+			end_x_num -= c_sy;
+		}
+	}
+}
+
+/* Draws a flat-top triangle. */
+static void DRAWING_FN(drawFlatTopTriangle)(SDL_Surface *screen, int a_x, int a_y, int b_x, int b_y, int c_x, int c_y, Uint32 color)
+{
+	int a_int;
+
+	int a_sx = b_x - a_x;
+	int a_sy = a_y - b_y;
+	int a_dir;
+
+	int start_x, start_x_num;
+	int c_sx, c_sy, c_dir;
+
+	int c_int;
+	int end_x, end_x_num;
+
+	int i;
+
+	a_sx = b_x - a_x;
+	a_sy = b_y - a_y;
+
+	if (a_sx < 0) {
+		a_sx = -a_sx;
+		a_dir = -1;
+	} else {
+		a_dir = 1;
+	}
+
+	/* Integral part of discriminate */
+	if (a_sy == 0) return;
+	a_int = a_sx / a_sy;
+
+	/* Fractional part of discriminate (numerator only, denominator is a_sy) */
+	a_sx -= a_int * a_sy;
+
+	a_int *= a_dir;
+
+	start_x = a_x;
+	start_x_num = a_sy >> 1;
+
+	c_sx = b_x - c_x;
+	c_sy = b_y - c_y;
+
+	if (c_sx < 0) {
+		c_sx = -c_sx;
+		c_dir = -1;
+	} else {
+		c_dir = 1;
+	}
+
+	/* Integral part of discriminate */
+	c_int = c_sx / c_sy;
+
+	/* Fractional part of discriminate (numerator only, denominator is a_sy) */
+	c_sx -= c_int * c_sy;
+
+	c_int *= c_dir;
+
+	end_x = c_x;
+	end_x_num = c_sy >> 1;
+
+	for (i = a_y; i <= b_y; i++) {
+		DRAWING_FN(drawHLine)(screen, start_x, i, end_x, color);
+		start_x += a_int;
+		start_x_num += a_sx;
+		if (start_x_num >= a_sy) {
+			start_x = start_x + a_dir;
+			start_x_num -= a_sy;
+		}
+		end_x += c_int;
+		end_x_num += c_sx;
+		if (end_x_num >= c_sy) {
+			end_x = end_x + c_dir;
+			end_x_num -= c_sy;
+		}
+	}
+}
+
+#undef DRAWING_FN
+#undef DRAWING_PUT
+#undef DRAWING_FILL_SPAN
@@ -12,14 +12,29 @@ const FixedVector fixed_vector_down = { 0,FIXED_SET_INT(1) };
 const FixedVector fixed_vector_left = { FIXED_SET_INT(-1),0 };
 const FixedVector fixed_vector_right = { FIXED_SET_INT(1),0 };
 
+/* State of the game's random number generator.  The game uses its own generator
+   rather than rand() so that its state can be saved and restored along with the
+   rest of the game world. */
+static Uint32 g_rand_state = 1;
+
+/* Sets the state of the random number generator. */
+void rand_set_state(Uint32 state)
+{
+	g_rand_state = state;
+}
+
+/* Returns the current state of the random number generator. */
+Uint32 rand_get_state()
+{
+	return g_rand_state;
+}
+
 /* Returns a random number in the range 0 <= rand_int(int_max) < int_max. */
 int rand_int(int max_int)
 {
-	int r;
-
-	r = rand();
-	if (r == RAND_MAX) r--;
-	return (int) ( ((double) r / (RAND_MAX)) * (max_int));
+	/* Linear congruential generator; the high bits are the random ones. */
+	g_rand_state = g_rand_state * 1664525 + 1013904223;
+	return (int) ( ((double) (g_rand_state >> 8) / (1 << 24)) * (max_int));
 }
 
 /* Returns a pointer to a random vector from the given list with the given
@@ -145,6 +160,26 @@ int rects_intersect(SDL_Rect *r1, SDL_Rect *r2)
              (r2->y + r2->h >= r1->y) );
 }
 
+/* Finds the part of r1 that's inside r2, storing it in clipped_rect.  Returns
+   false (and leaves clipped_rect alone) if there isn't any, i.e. if the two
+   rects don't overlap. */
+int rects_clip(SDL_Rect *r1, SDL_Rect *r2, SDL_Rect *clipped_rect)
+{
+	int x1, y1, x2, y2;
+
+	x1 = r1->x > r2->x ? r1->x : r2->x;
+	y1 = r1->y > r2->y ? r1->y : r2->y;
+	x2 = r1->x + r1->w < r2->x + r2->w ? r1->x + r1->w : r2->x + r2->w;
+	y2 = r1->y + r1->h < r2->y + r2->h ? r1->y + r1->h : r2->y + r2->h;
+	if (x1 >= x2 || y1 >= y2) return 0;
+
+	clipped_rect->x = (Sint16) x1;
+	clipped_rect->y = (Sint16) y1;
+	clipped_rect->w = (Uint16) (x2 - x1);
+	clipped_rect->h = (Uint16) (y2 - y1);
+	return 1;
+}
+
 /* Merge the two rects, storing the resulting rect in merged_rect.
    (By "merge", we mean find the smallest possible rect that encloses
    the two given ones.) */
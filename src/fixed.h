@@ -80,6 +80,9 @@ FixedVector fixed_vector_rotate_right(const FixedVector *v);
 FixedVector fixed_vector_reverse(const FixedVector *v);
 FixedVector *fixed_vector_choose_random(FixedVector vlist[], int num_vectors);
 int rand_int(int max_int);
+void rand_set_state(Uint32 state);
+Uint32 rand_get_state();
 void rects_merge(SDL_Rect *r1, SDL_Rect *r2, SDL_Rect *merged_rect);
+int rects_clip(SDL_Rect *r1, SDL_Rect *r2, SDL_Rect *clipped_rect);
 
 #endif
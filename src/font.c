@@ -21,14 +21,13 @@ void font_init(Font *f, const char *bmp_filename, int char_width, int char_heigh
 	f->bitmap_chars_per_line = bitmap_chars_per_line;
 	f->char_height = char_height;
 	f->char_width = char_width;
+	f->bitmap_name = bmp_filename;
+	f->bitmap = NULL;
 	
 	s = game_load_bmp(bmp_filename);
 
 	SDL_SetColorKey(s, SDL_SRCCOLORKEY | SDL_RLEACCEL, 1);
-	f->bitmap = SDL_DisplayFormatAlpha(s);
-	assert(f->bitmap != NULL);
-
-	SDL_FreeSurface(s);
+	game_add_sprite(bmp_filename, s);
 }
 
 /* Draws the given string in the given font, centered at the specified (x,y) coordinates. */
@@ -43,6 +42,16 @@ void font_draw_string_centered(Font *f, SDL_Surface *surface, int x, int y, cons
 	font_draw_string(f, surface, x_ofs, y_ofs, string);
 }
 
+/* Puts the rectangle that font_draw_string_centered() would draw the given string
+   in into "r". */
+void font_get_string_rect_centered(Font *f, int x, int y, const char *string, SDL_Rect *r)
+{
+	r->w = (Uint16) (strlen(string) * f->char_width);
+	r->h = (Uint16) f->char_height;
+	r->x = (Sint16) (x - ( ((int) strlen(string) * f->char_width) / 2));
+	r->y = (Sint16) (y - (f->char_height / 2));
+}
+
 /* Draws the given string with a black rectangle behind it and then updates the
    game's rectangle list for redrawing. */
 void font_draw_string_opaque(Font *f, SDL_Surface *surface, int x, int y, const char *string)
@@ -84,6 +93,10 @@ void font_draw_string(Font *f, SDL_Surface *surface, int x, int y, const char *s
 
 	string_length = (int) strlen(string);
 
+	/* The sprite atlas is only built after the fonts are loaded. */
+	if (!f->bitmap)
+		f->bitmap = game_get_sprite(f->bitmap_name, &f->bitmap_rect);
+
 	for (i = 0; i < string_length; i++) {
 		int char_code, char_x, char_y;
 
@@ -91,10 +104,10 @@ void font_draw_string(Font *f, SDL_Surface *surface, int x, int y, const char *s
 		char_x = char_code % f->bitmap_chars_per_line;
 		char_y = char_code / f->bitmap_chars_per_line;
 
-		r_src.x = (Sint16) (char_x * f->char_width);
-		r_src.y = (Sint16) (char_y * f->char_height);
+		r_src.x = (Sint16) (f->bitmap_rect.x + char_x * f->char_width);
+		r_src.y = (Sint16) (f->bitmap_rect.y + char_y * f->char_height);
 
-		SDL_BlitSurface(f->bitmap, &r_src, surface, &r_dst);
+		game_blit_sprite(&r_src, surface, &r_dst);
 		r_dst.x = r_dst.x + (Sint16) f->char_width;
 	}
 }
@@ -102,6 +115,6 @@ void font_draw_string(Font *f, SDL_Surface *surface, int x, int y, const char *s
 /* Frees memory allocated by the font constructor. */
 void font_destroy(Font *f)
 {
-	/* Free the tiled character bitmap image. */
-	SDL_FreeSurface(f->bitmap);
+	/* The tiled character bitmap image belongs to the game's sprite atlas. */
+	f->bitmap = NULL;
 }
@@ -8,6 +8,7 @@
 
    Image data for bitmap fonts is stored in a tiled image, and when a string needs to be
    printed, a character is retrieved from a sub-rectangle of the font's tiled image.
+   The tiled image is kept on the game's sprite atlas (see game_add_sprite()).
 */
 
 #include "SDL.h"
@@ -17,8 +18,13 @@
 
 /* The font structure. */
 typedef struct Font {
-	/* Tiled bitmap used to get the character bitmap data from. */
+	/* Name of the tiled bitmap on the game's sprite atlas. */
+	const char *bitmap_name;
+
+	/* The game's sprite atlas, once it's been looked up, and where the tiled
+	   bitmap is on it. */
 	SDL_Surface *bitmap;
+	SDL_Rect bitmap_rect;
 
 	/* Width of each character on the tiled bitmap. */
 	int char_width;
@@ -34,6 +40,7 @@ void font_init(Font *f, const char *bmp_filename, int char_width, int char_heigh
 void font_draw_string(Font *f, SDL_Surface *surface, int x, int y, const char *string);
 void font_draw_string_opaque(Font *f, SDL_Surface *surface, int x, int y, const char *string);
 void font_draw_string_centered(Font *f, SDL_Surface *surface, int x, int y, const char *string);
+void font_get_string_rect_centered(Font *f, int x, int y, const char *string, SDL_Rect *r);
 void font_destroy(Font *f);
 
 #endif
@@ -1,5 +1,11 @@
 #include "globals.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
@@ -10,7 +16,12 @@
 
 #include "game.h"
 #include "font.h"
+#include "atlas.h"
+#include "compositor.h"
+#include "render.h"
+#include "capture.h"
 #include "state.h"
+#include "fixed.h"
 #include "debug.h"
 #include "audio.h"
 
@@ -18,6 +29,9 @@
    that everything is ultimately displayed to. */
 static SDL_Surface *g_game_screen;
 
+/* The render backend that the game screen comes from (see render.h). */
+static const RenderBackend *g_game_backend;
+
 /* Structure containing time-tracking info to record framerate, passage
    of time, etc. */
 static Time g_game_time;
@@ -42,12 +56,19 @@ static Font g_game_font_big;
 /* Pointer to the game's "small" font. */
 static Font g_game_font_small;
 
+/* Every sprite and tile the game draws with (see game_add_sprite()). */
+static Atlas g_game_atlas;
+
 /* Records whether the game state needs to be changed or not. */
 static int g_state_change_flag;
 
 /* Whether the game is currently in fullscreen or windowed mode. */
 static int g_is_fullscreen;
 
+/* Whether the game was started with game_init_headless(), i.e. without a
+   screen, fonts or audio. */
+static int g_is_headless;
+
 /* Pointer to the game state that we need to change to, if
    g_state_change_flag is true. */
 static GameState *g_next_game_state;
@@ -57,18 +78,102 @@ static GameState *g_next_game_state;
    frame.  (Part of the "dirty rectangle" animation method.) */
 static RectList g_update_rects;
 
+/* Areas of the screen that have been invalidated (see game_invalidate()) since
+   the last frame was drawn, and the ones being redrawn in the current frame. */
+static RectList g_invalid_rects;
+static RectList g_redraw_rects;
+
+/* Whether the whole screen is being redrawn in the current frame. */
+static int g_redraw_all;
+
+/* The layers that the current game state's screen is built from, if it uses
+   any (see game_set_layer()). */
+static Compositor g_game_compositor;
+
+/* The framerate that the statistics overlay is showing. */
+static Uint32 g_stats_fps_shown;
+
 /* Resets the given rectangle list. */
 void rect_list_reset(RectList *u)
 {
 	u->numrects = 0;
+	u->area = 0;
 }
 
-/* Adds a rectangle to the given rectangle list. */
+/* Removes the i'th rectangle from the given rectangle list.  (The order of
+   the rectangles in the list isn't kept.) */
+void rect_list_remove(RectList *u, int i)
+{
+	u->area -= (Uint32) u->rects[i].w * u->rects[i].h;
+	u->numrects--;
+	u->rects[i] = u->rects[u->numrects];
+}
+
+/* Adds a rectangle to the given rectangle list.  Any rectangle in the list
+   that the new one overlaps or touches is merged with it, as long as the
+   merged rectangle is no bigger than the two of them put together (so two
+   small rectangles that only touch at the corners aren't turned into one big
+   one).  If the list is full, the new rectangle is merged into the one in the
+   list that it grows the least. */
 void rect_list_add(RectList *u, SDL_Rect *r)
 {
-	assert(u->numrects < GAME_MAX_UPDATE_RECTS);
-	u->rects[u->numrects] = *r;
+	SDL_Rect merged = *r;
+	SDL_Rect m;
+	Uint32 area, best_growth;
+	int i, best;
+
+	if (merged.w == 0 || merged.h == 0) return;
+
+	i = 0;
+	while (i < u->numrects) {
+		if (rects_intersect(&u->rects[i], &merged)) {
+			rects_merge(&u->rects[i], &merged, &m);
+			area = (Uint32) m.w * m.h;
+			if (area <= (Uint32) u->rects[i].w * u->rects[i].h + (Uint32) merged.w * merged.h) {
+				/* The merged rectangle might overlap ones we've already
+				   checked, so start over. */
+				rect_list_remove(u, i);
+				merged = m;
+				i = 0;
+				continue;
+			}
+		}
+		i++;
+	}
+
+	if (u->numrects == GAME_MAX_UPDATE_RECTS) {
+		best = 0;
+		best_growth = 0xffffffff;
+		for (i = 0; i < u->numrects; i++) {
+			rects_merge(&u->rects[i], &merged, &m);
+			area = (Uint32) m.w * m.h - (Uint32) u->rects[i].w * u->rects[i].h;
+			if (area < best_growth) {
+				best_growth = area;
+				best = i;
+			}
+		}
+		rects_merge(&u->rects[best], &merged, &m);
+		rect_list_remove(u, best);
+		/* There's room in the list now, so this can't come back here. */
+		rect_list_add(u, &m);
+		return;
+	}
+
+	u->rects[u->numrects] = merged;
 	u->numrects++;
+	u->area += (Uint32) merged.w * merged.h;
+}
+
+/* Clips the given rectangle to the screen, storing the result in "clipped".  Returns
+   false if none of it is on the screen.  (Agents in the tunnels are partly off it.) */
+int game_clip_to_screen(SDL_Rect *r, SDL_Rect *clipped)
+{
+	SDL_Rect screen_rect;
+
+	screen_rect.x = screen_rect.y = 0;
+	screen_rect.w = SCREEN_WIDTH;
+	screen_rect.h = SCREEN_HEIGHT;
+	return rects_clip(r, &screen_rect, clipped);
 }
 
 /* Add a rectangle to the game's list of drawing update rectangles.  This is used
@@ -78,20 +183,78 @@ void rect_list_add(RectList *u, SDL_Rect *r)
    during the next frame redraw. */
 void game_update_rect_add(SDL_Rect *r)
 {
-	rect_list_add(&g_update_rects, r);
+	SDL_Rect clipped;
+
+	if (game_clip_to_screen(r, &clipped))
+		rect_list_add(&g_update_rects, &clipped);
 }
 
-/* Sets the game's video mode.  Takes into account whether the game is fullscreen or not. */
-void game_set_video_mode()
+/* Marks the given rectangle of the screen (or the whole screen, if it's NULL) as
+   needing to be redrawn from scratch.  Whatever's there is cleared at the start of
+   the next frame, and game_is_invalid() tells the game state's view which parts of
+   itself to draw again.  This is for things that change too seldom to be redrawn
+   every frame, so that they don't have to have the whole screen redrawn instead. */
+void game_invalidate(SDL_Rect *r)
 {
-	int flags = SDL_SWSURFACE;
-	int depth = SDL_VideoModeOK(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_DEPTH, flags);
+	SDL_Rect clipped;
 
-	if (g_is_fullscreen) {
-		flags = flags | SDL_FULLSCREEN;
-		if (g_game_screen) depth = g_game_screen->format->BitsPerPixel;
+	if (g_is_headless) return;
+
+	if (r == NULL) {
+		game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+		return;
 	}
-	g_game_screen = SDL_SetVideoMode(SCREEN_WIDTH, SCREEN_HEIGHT, depth, flags);
+
+	if (game_clip_to_screen(r, &clipped))
+		rect_list_add(&g_invalid_rects, &clipped);
+}
+
+/* Returns true if any of the given rectangle is being redrawn from scratch in the
+   current frame, either because it was invalidated or because the whole screen is
+   being redrawn.  Only meaningful while the game state's view is drawing. */
+int game_is_invalid(SDL_Rect *r)
+{
+	int i;
+
+	if (g_redraw_all) return 1;
+
+	for (i = 0; i < g_redraw_rects.numrects; i++) {
+		SDL_Rect *u = &g_redraw_rects.rects[i];
+
+		if (r->x < u->x + u->w && u->x < r->x + r->w &&
+		    r->y < u->y + u->h && u->y < r->y + r->h)
+			return 1;
+	}
+	return 0;
+}
+
+/* Sets the function that draws one of the layers the current game state's screen
+   is built from (see compositor.h).  A game state that draws its screen this way
+   sets its layers when it's entered, and then just marks what changes on each
+   layer with game_invalidate_layer();  the game redraws those areas after the
+   state's view() function is called.  A game state's layers are all cleared
+   when it exits. */
+void game_set_layer(int layer, GameLayerDraw draw, void *data)
+{
+	compositor_set_layer(&g_game_compositor, layer, draw, data);
+}
+
+/* Marks the given rectangle of the given layer as having changed, so that it's
+   redrawn in the next frame. */
+void game_invalidate_layer(int layer, SDL_Rect *r)
+{
+	SDL_Rect clipped;
+
+	if (g_is_headless) return;
+
+	if (game_clip_to_screen(r, &clipped))
+		compositor_invalidate(&g_game_compositor, layer, &clipped);
+}
+
+/* Sets the game's video mode.  Takes into account whether the game is fullscreen or not. */
+void game_set_video_mode()
+{
+	g_game_screen = g_game_backend->set_mode(g_game_screen, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_DEPTH, g_is_fullscreen);
 	if ( g_game_screen == NULL ) {
 		err("couldn't init video.\n", 1);
 	}
@@ -154,7 +317,8 @@ Font *game_get_font_small()
 
 /* Sets the game draw flags to the given flags.  Should be used, for instance, by a game state
    whenever it wants the game to redraw its screen entirely, instead of using dirty rectangle
-   animation.  See the GAME_DRAW_FLAG_* constants. */
+   animation.  See the GAME_DRAW_FLAG_* constants, and game_invalidate() for redrawing only
+   part of the screen. */
 void game_set_draw_flags(int flags)
 {
 	g_draw_flags = flags;
@@ -183,6 +347,10 @@ void game_change_state()
 		state_shutdown();
 		state_init();
 
+		/* The new state sets up its own layers, on top of the game's. */
+		compositor_init(&g_game_compositor);
+		compositor_set_layer(&g_game_compositor, COMPOSITOR_LAYER_OVERLAY, game_draw_stats, NULL);
+
 		g_game_state = g_next_game_state;
 		g_game_state->on_enter();
 		game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
@@ -206,11 +374,17 @@ void game_quit()
 	g_quit_flag = 1;
 }
 
-/* Initialize the game. */
+/* Initialize the game, drawing it in a window. */
 void game_init()
 {
-	SDL_Init(SDL_INIT_VIDEO);
+	game_init_backend(&render_sdl_backend);
+}
 
+/* Initialize the game, drawing it to the screen of the given render backend
+   (see render.h). */
+void game_init_backend(const RenderBackend *backend)
+{
+	g_game_backend = backend;
 	g_game_screen = NULL;
 	g_game_state = NULL;
 	g_quit_flag = 0;
@@ -220,37 +394,85 @@ void game_init()
 	g_is_fullscreen = 0;
 
 	state_init();
-	if ( SDL_Init( SDL_INIT_VIDEO ) < 0) {
+	if ( SDL_Init( backend->sdl_init_flags ) < 0) {
 		err("couldn't init SDL.\n", 1);
 	}
 
 	game_set_video_mode();
 
+	atlas_init(&g_game_atlas);
 	font_init(&g_game_font_big, GAME_FONT_BIG_FILENAME, GAME_FONT_BIG_CHAR_WIDTH,
 		GAME_FONT_BIG_CHAR_HEIGHT, GAME_FONT_BIG_CHARS_PER_LINE);
 	font_init(&g_game_font_small, GAME_FONT_SMALL_FILENAME, GAME_FONT_SMALL_CHAR_WIDTH,
 		GAME_FONT_SMALL_CHAR_HEIGHT, GAME_FONT_SMALL_CHARS_PER_LINE);
 
 	SDL_EnableKeyRepeat(500,500);
-	srand( (unsigned) time(NULL) );
+	rand_set_state( (Uint32) time(NULL) );
 
 	audio_init();
 }
 
-/* Display framerate statistics to the upper-left hand corner of the given surface. */
-void game_print_stats(SDL_Surface *surface)
+/* Initialize the game without opening a window, loading fonts or starting the
+   audio.  This is for running game states purely for their models (e.g. for
+   training or testing AI), where nothing is ever drawn; game_run() and
+   game_draw_frame() mustn't be used in this mode. */
+void game_init_headless()
+{
+	g_game_backend = NULL;
+	g_game_screen = NULL;
+	g_game_state = NULL;
+	g_quit_flag = 0;
+	g_show_stats = 0;
+	g_state_change_flag = 0;
+	g_next_game_state = NULL;
+	g_is_fullscreen = 0;
+	g_is_headless = 1;
+
+	state_init();
+	if ( SDL_Init( 0 ) < 0) {
+		err("couldn't init SDL.\n", 1);
+	}
+
+	rand_set_state( (Uint32) time(NULL) );
+}
+
+/* Returns whether the game was started with game_init_headless(). */
+int game_is_headless()
+{
+	return g_is_headless;
+}
+
+/* Puts the rectangle that the framerate statistics are displayed in into "r". */
+void game_get_stats_rect(SDL_Rect *r)
+{
+	Font *f = game_get_font_small();
+	int length = (int) strlen(PACKAGE_STRING);
+
+	if (length < (int) strlen("fps: 000000")) length = (int) strlen("fps: 000000");
+	r->x = 1;
+	r->y = 1;
+	r->w = (Uint16) (length * f->char_width);
+	r->h = (Uint16) (f->char_height * 2 + 2);
+}
+
+/* Display framerate statistics to the upper-left hand corner of the given surface,
+   if they're being shown.  This is the game's overlay layer (see compositor.h). */
+void game_draw_stats(SDL_Surface *surface, SDL_Rect *r, void *data)
 {
 	Font *f = game_get_font_small();
 	char buffer[200];
 	int x = 1;
 	int y = 1;
 
+	if (!g_show_stats) return;
+
 	font_draw_string_opaque(f, surface, x, y, PACKAGE_STRING);
 
 	y += f->char_height + 2;
 
 	sprintf(buffer, "fps: %6d", g_game_time.fps);
 	font_draw_string_opaque(f, surface, x, y, buffer);
+	g_stats_fps_shown = g_game_time.fps;
 }
 
 /* Draw the current frame. */
@@ -264,17 +486,57 @@ void game_draw_frame(int game_view_flags)
 			}
 		}
 
+		/* Take the areas invalidated since the last frame, so that anything
+		   invalidated while this one is drawn is redrawn in the next one. */
+		g_redraw_rects = g_invalid_rects;
+		rect_list_reset(&g_invalid_rects);
+		g_redraw_all = game_view_flags & GAME_DRAW_FLAG_REDRAW;
+
 		/* If we have to redraw the whole screen, first clear it so
-		   no artifacts from the last frame are left over. */
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW)
+		   no artifacts from the last frame are left over.  Otherwise
+		   just clear the invalidated areas. */
+		if (g_redraw_all) {
 			SDL_FillRect(g_game_screen, NULL, 0);
+		} else {
+			int i;
+
+			for (i = 0; i < g_redraw_rects.numrects; i++) {
+				SDL_Rect r = g_redraw_rects.rects[i];
+
+				SDL_FillRect(g_game_screen, &r, 0);
+				game_update_rect_add(&r);
+			}
+		}
 
 		/* Tell the current game state to draw itself. */
 		g_game_state->view(g_game_screen, game_view_flags);
 
-		/* Display framerate statistics if we need to. */
-		if (g_show_stats) {
-			game_print_stats(g_game_screen);
+		/* The framerate statistics only need redrawing when the framerate has
+		   changed. */
+		if (g_show_stats && g_game_time.fps != g_stats_fps_shown) {
+			SDL_Rect r;
+
+			game_get_stats_rect(&r);
+			game_invalidate_layer(COMPOSITOR_LAYER_OVERLAY, &r);
+		}
+
+		/* Redraw the layers wherever something on one of them has changed, or
+		   wherever the screen was cleared. */
+		{
+			RectList all;
+			SDL_Rect r;
+			int i;
+
+			if (g_redraw_all) {
+				r.x = r.y = 0;
+				r.w = SCREEN_WIDTH;
+				r.h = SCREEN_HEIGHT;
+				rect_list_reset(&all);
+				rect_list_add(&all, &r);
+			}
+			compositor_draw(&g_game_compositor, g_game_screen, g_redraw_all ? &all : &g_redraw_rects);
+			for (i = 0; i < g_game_compositor.damage.numrects; i++)
+				game_update_rect_add(&g_game_compositor.damage.rects[i]);
 		}
 
 		/* Unlock the game screen surface. */
@@ -282,14 +544,19 @@ void game_draw_frame(int game_view_flags)
 			SDL_UnlockSurface(g_game_screen);
 		}
 
-		/* If we're redrawing the screen from scratch, blit the whole screen to the
-		   surface by calling SDL_Flip().  Otherwise, do dirty rectangle animation by
-		   only updating our list of updated rectangles. */
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW) {
-			SDL_Flip(g_game_screen);
+		/* If we're redrawing the screen from scratch, or so much of it has changed
+		   that it might as well have been, blit the whole screen to the surface by
+		   calling SDL_Flip().  Otherwise, do dirty rectangle animation by only
+		   updating our list of updated rectangles. */
+		if (game_view_flags & GAME_DRAW_FLAG_REDRAW ||
+		    g_update_rects.area * 100 > (Uint32) SCREEN_WIDTH * SCREEN_HEIGHT * GAME_FULL_UPDATE_PERCENT) {
+			g_game_backend->flip(g_game_screen);
 		} else {
-			SDL_UpdateRects(g_game_screen, g_update_rects.numrects, g_update_rects.rects);
+			g_game_backend->update_rects(g_game_screen, g_update_rects.numrects, g_update_rects.rects);
 		}
+
+		/* Hand the frame to the video being captured, if there is one. */
+		capture_frame(g_game_screen, g_game_time.frame_time);
 }
 
 /* Toggle the display of framerate statistics. */
@@ -298,8 +565,13 @@ void game_toggle_show_stats()
 	if (g_show_stats) {
 		g_show_stats = 0;
 		game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
-	} else
+	} else {
+		SDL_Rect r;
+
 		g_show_stats = 1;
+		game_get_stats_rect(&r);
+		game_invalidate_layer(COMPOSITOR_LAYER_OVERLAY, &r);
+	}
 }
 
 /* Run the game.  This is the main "game loop". */
@@ -366,34 +638,50 @@ void game_run()
 /* Shut down the game. */
 void game_shutdown()
 {
-	audio_shutdown();
+	if (!g_is_headless)
+		audio_shutdown();
 
 	game_set_state(NULL);
 
 	state_shutdown();
 
-	font_destroy(&g_game_font_big);
-	font_destroy(&g_game_font_small);
+	if (!g_is_headless) {
+		font_destroy(&g_game_font_big);
+		font_destroy(&g_game_font_small);
+		atlas_destroy(&g_game_atlas);
 
-	SDL_FreeSurface(g_game_screen);
+		g_game_backend->close(g_game_screen);
+	}
 
 	SDL_Quit();
 }
 
 /* Create and return a bitmap with the given width, height, SDL flags, and
-   the game's current pixel format. */
+   the game's current pixel format.  When there's no screen (see
+   game_init_headless()), the bitmap is 16-bit 5-6-5 RGB. */
 SDL_Surface *game_create_bitmap(Uint32 flags, int w, int h)
 {
 	SDL_PixelFormat *pf;
 
+	if (!g_game_screen)
+		return SDL_CreateRGBSurface(flags, w, h, 16, 0xF800, 0x07E0, 0x001F, 0);
 	pf = g_game_screen->format;
 	return SDL_CreateRGBSurface(flags, w, h, SCREEN_DEPTH,
 		pf->Rmask, pf->Gmask, pf->Bmask, pf->Amask);
 }
 
+/* Returns the game screen, or NULL if there isn't one (see game_init_headless()).
+   Whatever was drawn last can be read from it between frames. */
+SDL_Surface *game_get_screen()
+{
+	return g_game_screen;
+}
+
 /* Return the given RGB color in the game's current pixel format. */
 Uint32 game_map_rgb(Uint8 r, Uint8 g, Uint8 b)
 {
+	if (!g_game_screen)
+		return ((Uint32) (r >> 3) << 11) | ((Uint32) (g >> 2) << 5) | (Uint32) (b >> 3);
 	return SDL_MapRGB(g_game_screen->format, r, g, b);
 }
 
@@ -408,3 +696,64 @@ SDL_Surface *game_load_bmp(const char *filename)
   }
   return result;
 }
+
+/* Adds the given surface to the game's sprite atlas under the given name,
+   handing it over to the atlas.  Sprites can only be added before
+   game_build_sprites() is called, which should be right after game_init(). */
+void game_add_sprite(const char *name, SDL_Surface *s)
+{
+	atlas_add(&g_game_atlas, name, s);
+}
+
+/* Packs all the sprites that have been added into the game's sprite atlas. */
+void game_build_sprites()
+{
+	atlas_build(&g_game_atlas);
+}
+
+/* Looks up the sprite with the given name, putting where it is on the returned
+   surface (the game's sprite atlas) in rect.  Returns NULL when there's no
+   screen (see game_init_headless()), since nothing is ever drawn then. */
+SDL_Surface *game_get_sprite(const char *name, SDL_Rect *rect)
+{
+	SDL_Surface *s;
+
+	if (g_is_headless) return NULL;
+	s = atlas_find(&g_game_atlas, name, rect);
+	assert(s != NULL);
+	return s;
+}
+
+/* Draws the given rectangle of the game's sprite atlas (e.g., a sprite found
+   with game_get_sprite()) to the given surface, as SDL_BlitSurface() would. */
+void game_blit_sprite(SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst)
+{
+	atlas_blit(&g_game_atlas, src, surface, dst);
+}
+
+/* Returns the game time, in milliseconds (see TIMER_ID_GAME). */
+Uint32 game_get_ticks()
+{
+	return state_timer_get_ticks(TIMER_ID_GAME);
+}
+
+/* Returns a microsecond clock, for timing things that take much less than a
+   millisecond (SDL_GetTicks() is too coarse for that).  Only differences between
+   two values of this clock mean anything, and it wraps around every 71 minutes or so. */
+Uint32 game_get_microseconds()
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (Uint32) (count.QuadPart * 1000000 / freq.QuadPart);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (Uint32) tv.tv_sec * 1000000 + (Uint32) tv.tv_usec;
+#endif
+}
@@ -14,6 +14,7 @@
 
 #include "font.h"
 #include "state.h"
+#include "render.h"
 
 #define SCREEN_WIDTH  640
 #define SCREEN_HEIGHT 480
@@ -37,7 +38,8 @@
    give it information about how to draw the view. */
 
 /* This flag tells the game state's view() function to completely redraw the
-   game's view. */
+   game's view.  When only part of the screen needs redrawing, game_invalidate()
+   is used instead, and the view asks game_is_invalid() which parts those are. */
 #define GAME_DRAW_FLAG_REDRAW 1
 
 /* Information about the game's default "big size" font. */
@@ -53,9 +55,16 @@
 #define GAME_FONT_SMALL_CHARS_PER_LINE 16
 
 /* Maximum number of update rectangles for dirty rectangle
-   animation. */
+   animation.  Rectangles that overlap or touch are merged as they're added,
+   and once the list is full, new ones are merged into whichever existing
+   rectangle grows the least, so the list never overflows. */
 #define GAME_MAX_UPDATE_RECTS 100
 
+/* If the update rectangles of a frame add up to more than this percentage of
+   the screen, the whole screen is updated at once instead, which is cheaper
+   than updating that many pieces of it one by one. */
+#define GAME_FULL_UPDATE_PERCENT 50
+
 /* The Time structure contains time-tracking statistics for the game,
    including frames per second and the amount of game "ticks" that have
    passed so far.  These variables and the code associated with this structure
@@ -79,6 +88,10 @@ typedef struct Time {
 typedef void (*GameStateModel)(Uint32);
 typedef void (*GameStateView)(SDL_Surface *, int);
 typedef int (*GameStateController)(SDL_Event *);
+
+/* Draws one of the layers the screen is built from into the given rectangle
+   of the screen (see compositor.h). */
+typedef void (*GameLayerDraw)(SDL_Surface *, SDL_Rect *, void *);
 typedef void (*GameStateEnter)();
 typedef void (*GameStateExit)();
 
@@ -111,13 +124,19 @@ typedef struct RectList {
 	/* The number of rectangles currently in the list (i.e., the
 	   current length of the list). */
 	int numrects;
+	/* The total area of the rectangles in the list, in pixels. */
+	Uint32 area;
 } RectList;
 
 void game_set_state(const GameState *gs);
 SDL_Surface *game_create_bitmap(Uint32 flags, int w, int h);
+SDL_Surface *game_get_screen();
 Uint32 game_map_rgb(Uint8 r, Uint8 g, Uint8 b);
 
 void game_init();
+void game_init_backend(const RenderBackend *backend);
+void game_init_headless();
+int game_is_headless();
 void game_run();
 void game_shutdown();
 
@@ -125,12 +144,27 @@ int is_game_quit();
 void game_quit();
 void game_set_draw_flags(int flags);
 Uint32 game_get_ticks();
+Uint32 game_get_microseconds();
 
 Font *game_get_font_big();
 Font *game_get_font_small();
 
+void rect_list_reset(RectList *u);
+void rect_list_add(RectList *u, SDL_Rect *r);
+
 void game_update_rect_add(SDL_Rect *r);
+void game_invalidate(SDL_Rect *r);
+int game_is_invalid(SDL_Rect *r);
+void game_set_layer(int layer, GameLayerDraw draw, void *data);
+void game_invalidate_layer(int layer, SDL_Rect *r);
+void game_get_stats_rect(SDL_Rect *r);
+void game_draw_stats(SDL_Surface *surface, SDL_Rect *r, void *data);
 
 SDL_Surface *game_load_bmp(const char *filename);
 
+void game_add_sprite(const char *name, SDL_Surface *s);
+void game_build_sprites();
+SDL_Surface *game_get_sprite(const char *name, SDL_Rect *rect);
+void game_blit_sprite(SDL_Rect *src, SDL_Surface *surface, SDL_Rect *dst);
+
 #endif
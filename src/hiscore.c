@@ -32,6 +32,31 @@ static int g_new_hiscore_position;
    -1. */
 static int g_hiscore_countdown = -1;
 
+/* Puts the rectangle that the given entry of the hiscore list is drawn in into "r". */
+void hiscore_get_entry_rect(int i, SDL_Rect *r)
+{
+	Font *f = game_get_font_big();
+	char str_score[16];
+
+	r->x = (Sint16) HISCORE_LIST_X;
+	r->y = (Sint16) (HISCORE_START_Y + HISCORE_LIST_SPACING * (2 + i));
+	/* The score as hiscore_view() prints it, three spaces, and the longest name
+	   (counting the underscore on the end of a new entry), so that the rectangle
+	   still covers the name after a letter is rubbed out of it. */
+	sprintf(str_score, HISCORE_SCORE_FORMAT, g_hiscores.entries[i].score);
+	r->w = (Uint16) ((strlen(str_score) + 3 + HISCORE_NAME_MAXLENGTH) * f->char_width);
+	r->h = (Uint16) f->char_height;
+}
+
+/* Invalidates the new hiscore entry, so that it's redrawn. */
+void hiscore_new_entry_invalidate()
+{
+	SDL_Rect r;
+
+	hiscore_get_entry_rect(g_new_hiscore_position-1, &r);
+	game_invalidate(&r);
+}
+
 /* Removes the trailing underscore ("_") from a new hiscore entry. */
 void hiscore_new_entry_finalize()
 {
@@ -42,9 +67,9 @@ void hiscore_new_entry_finalize()
 
 		str[str_length-1] = '\0';
 
+		hiscore_new_entry_invalidate();
 		g_new_hiscore_position = 0;
 		SDL_EnableUNICODE(0);
-		game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
 	}
 }
 
@@ -60,7 +85,7 @@ void hiscore_new_entry_backspace()
 
 		str[str_length-1] = '\0';
 		str[str_length-2] = '_';
-		game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+		hiscore_new_entry_invalidate();
 	}
 }
 
@@ -78,7 +103,7 @@ void hiscore_new_entry_add_char(char c)
 	str[str_length+1] = '\0';
 	str[str_length] = '_';
 	str[str_length-1] = c;
-	game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+	hiscore_new_entry_invalidate();
 }
 
 /* Attempts to insert the given score into the high score list.  If the
@@ -199,23 +224,22 @@ void hiscore_shutdown()
 void hiscore_view(SDL_Surface *surface, int game_view_flags)
 {
 	int i;
-	int curr_y;
 	Font *f = game_get_font_big();
 
-	/* If we're not being specifically told to redraw the screen, leave,
-	   since the hiscore list's display doesn't really change much. */
-	if (!(game_view_flags & GAME_DRAW_FLAG_REDRAW)) return;
-
-	curr_y = HISCORE_START_Y;
-	font_draw_string_centered(f, surface, (SCREEN_WIDTH / 2), curr_y, "Hi Scores");
-	curr_y += HISCORE_LIST_SPACING * 2;
+	/* The hiscore list's display doesn't really change much, so only draw
+	   the parts of it that we're being told to redraw. */
+	if (game_view_flags & GAME_DRAW_FLAG_REDRAW)
+		font_draw_string_centered(f, surface, (SCREEN_WIDTH / 2), HISCORE_START_Y, "Hi Scores");
 
 	for (i = 0; i < HISCORE_NUM_ENTRIES; i++) {
 		char str_entry[50];
-		
-		sprintf(str_entry, "%05d   %s", g_hiscores.entries[i].score, g_hiscores.entries[i].name);
-		font_draw_string(f, surface, HISCORE_LIST_X, curr_y, str_entry);
-		curr_y += HISCORE_LIST_SPACING;
+		SDL_Rect r;
+
+		hiscore_get_entry_rect(i, &r);
+		if (!game_is_invalid(&r)) continue;
+
+		sprintf(str_entry, HISCORE_SCORE_FORMAT "   %s", g_hiscores.entries[i].score, g_hiscores.entries[i].name);
+		font_draw_string(f, surface, r.x, r.y, str_entry);
 	}
 }
 
@@ -14,6 +14,10 @@
 #define HISCORE_START_Y 100
 #define HISCORE_LIST_X (SCREEN_WIDTH / 2 - 80)
 
+/* printf() format of each score in the hiscore list.  Scores of 100000 and up
+   take more than the 5 digits it pads to. */
+#define HISCORE_SCORE_FORMAT "%05d"
+
 /* Maximum length of a player's name in the hiscore list.  This is
    actually 1 more than the desired maximum number of characters; 1 is
    reserved for the
@@ -6,20 +6,193 @@
 #include "globals.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 #include "SDL_endian.h"
 
 #include "game.h"
+#include "debug.h"
+#include "pman_agent_pman.h"
+#include "pman_batch.h"
+#include "pman_board.h"
+#include "pman_bot.h"
+#include "pman_shm.h"
+#include "pman_spectate.h"
+#include "pman_tune.h"
+#include "render.h"
+#include "capture.h"
 
 #include "menu.h"
 
+#define USAGE \
+	"usage: pman [-ai random|planner|rollout] [-tune FILE] [-set NAME=VALUE]...\n" \
+	"            [-offscreen | -bot | -bot-socket PATH | -shm NAME] [-spectate PATH]\n" \
+	"            [-capture FILE [-capture-fps N] [-capture-frames N] [-capture-policy drop|wait]]\n" \
+	"       pman -view PATH [-capture FILE ...]\n" \
+	"       pman [-ai random|planner|rollout] -batch DIR [-games N] [-workers N] [-seed N]\n" \
+	"            [-sweep NAME=VALUE,VALUE...]...\n" \
+	"       pman -stats FILE\n"
+
+/* The MODE_* constants say what the game does once it starts. */
+
+/* Play the game in a window. */
+#define MODE_PLAY       0
+/* Serve a bot over stdin/stdout (see pman_bot.h). */
+#define MODE_BOT_STDIO  1
+/* Serve bots over a Unix domain socket. */
+#define MODE_BOT_SOCKET 2
+/* Serve a trainer through shared memory rings (see pman_shm.h). */
+#define MODE_SHM        3
+/* Show a game streamed by another pman (see pman_spectate.h). */
+#define MODE_VIEW       4
+/* Play a batch run of demo games on several processes (see pman_batch.h). */
+#define MODE_BATCH      5
+/* Sum up the results of a batch run. */
+#define MODE_STATS      6
+
+static int g_mode = MODE_PLAY;
+static const char *g_bot_socket_path = NULL;
+static const char *g_shm_name = NULL;
+static const char *g_spectate_path = NULL;
+static const char *g_view_path = NULL;
+static const char *g_batch_dir = NULL;
+static const char *g_stats_path = NULL;
+static int g_batch_games = BATCH_DEFAULT_GAMES;
+static int g_batch_workers = 0;
+static Uint32 g_batch_seed = 0;
+static int g_sweeping = 0;
+
+/* Whether to play the game in memory instead of in a window (see render.h). */
+static int g_offscreen = 0;
+
+/* Video file to capture the screen to, if any (see capture.h). */
+static const char *g_capture_path = NULL;
+static int g_capture_fps = CAPTURE_DEFAULT_FPS;
+static Uint32 g_capture_frames = 0;
+static int g_capture_policy = CAPTURE_POLICY_DROP;
+
+/* Parses the command line.  Exits with a usage message if it doesn't make sense. */
+void parse_args(int argc, char **argv)
+{
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-ai") == 0 && i+1 < argc) {
+			i++;
+			if (strcmp(argv[i], "random") == 0)
+				agent_pman_set_ai_mode(PMAN_AI_RANDOM);
+			else if (strcmp(argv[i], "planner") == 0)
+				agent_pman_set_ai_mode(PMAN_AI_PLANNER);
+			else if (strcmp(argv[i], "rollout") == 0)
+				agent_pman_set_ai_mode(PMAN_AI_ROLLOUT);
+			else
+				err(USAGE, 1);
+		} else if (strcmp(argv[i], "-tune") == 0 && i+1 < argc) {
+			if (!tune_load_file(argv[++i])) exit(1);
+		} else if (strcmp(argv[i], "-set") == 0 && i+1 < argc) {
+			if (!tune_parse_assignment(argv[++i])) err("Unknown tunable or bad value.\n", 1);
+		} else if (strcmp(argv[i], "-sweep") == 0 && i+1 < argc) {
+			if (!tune_add_sweep(argv[++i])) err("Unknown tunable, bad values to sweep, or too many configs.\n", 1);
+			g_sweeping = 1;
+		} else if (strcmp(argv[i], "-offscreen") == 0) {
+			g_offscreen = 1;
+		} else if (strcmp(argv[i], "-capture") == 0 && i+1 < argc) {
+			g_capture_path = argv[++i];
+		} else if (strcmp(argv[i], "-capture-fps") == 0 && i+1 < argc) {
+			g_capture_fps = atoi(argv[++i]);
+			if (g_capture_fps <= 0) err(USAGE, 1);
+		} else if (strcmp(argv[i], "-capture-frames") == 0 && i+1 < argc) {
+			g_capture_frames = (Uint32) strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "-capture-policy") == 0 && i+1 < argc) {
+			i++;
+			if (strcmp(argv[i], "drop") == 0)
+				g_capture_policy = CAPTURE_POLICY_DROP;
+			else if (strcmp(argv[i], "wait") == 0)
+				g_capture_policy = CAPTURE_POLICY_WAIT;
+			else
+				err(USAGE, 1);
+		} else if (strcmp(argv[i], "-bot") == 0) {
+			g_mode = MODE_BOT_STDIO;
+		} else if (strcmp(argv[i], "-bot-socket") == 0 && i+1 < argc) {
+			g_mode = MODE_BOT_SOCKET;
+			g_bot_socket_path = argv[++i];
+		} else if (strcmp(argv[i], "-shm") == 0 && i+1 < argc) {
+			g_mode = MODE_SHM;
+			g_shm_name = argv[++i];
+		} else if (strcmp(argv[i], "-spectate") == 0 && i+1 < argc) {
+			g_spectate_path = argv[++i];
+		} else if (strcmp(argv[i], "-view") == 0 && i+1 < argc) {
+			g_mode = MODE_VIEW;
+			g_view_path = argv[++i];
+		} else if (strcmp(argv[i], "-batch") == 0 && i+1 < argc) {
+			g_mode = MODE_BATCH;
+			g_batch_dir = argv[++i];
+		} else if (strcmp(argv[i], "-stats") == 0 && i+1 < argc) {
+			g_mode = MODE_STATS;
+			g_stats_path = argv[++i];
+		} else if (strcmp(argv[i], "-games") == 0 && i+1 < argc) {
+			g_batch_games = atoi(argv[++i]);
+			if (g_batch_games <= 0) err(USAGE, 1);
+		} else if (strcmp(argv[i], "-workers") == 0 && i+1 < argc) {
+			g_batch_workers = atoi(argv[++i]);
+			if (g_batch_workers <= 0) err(USAGE, 1);
+		} else if (strcmp(argv[i], "-seed") == 0 && i+1 < argc) {
+			g_batch_seed = (Uint32) strtoul(argv[++i], NULL, 0);
+		} else {
+			err(USAGE, 1);
+		}
+	}
+}
+
 int main(int argc, char **argv)
 {
-	game_init();
+	parse_args(argc, argv);
+
+	if (g_sweeping && g_mode != MODE_BATCH) err(USAGE, 1);
+	if (g_offscreen && g_mode != MODE_PLAY) err(USAGE, 1);
+
+	if (g_capture_path) {
+		const char *ext = strrchr(g_capture_path, '.');
+		int format = (ext && strcmp(ext, ".ppm") == 0) ? CAPTURE_FORMAT_PPM : CAPTURE_FORMAT_Y4M;
+
+		if (g_mode != MODE_PLAY && g_mode != MODE_VIEW) err(USAGE, 1);
+		if (!capture_start(g_capture_path, format, g_capture_policy, g_capture_fps, g_capture_frames))
+			return 1;
+	}
+
+	if (g_spectate_path) {
+		if (g_mode != MODE_BOT_STDIO && g_mode != MODE_BOT_SOCKET && g_mode != MODE_SHM)
+			err(USAGE, 1);
+		spectate_listen(g_spectate_path);
+	}
+
+	if (g_mode == MODE_BOT_STDIO) {
+		bot_run_stdio();
+		return 0;
+	} else if (g_mode == MODE_BOT_SOCKET) {
+		bot_run_socket(g_bot_socket_path);
+		return 0;
+	} else if (g_mode == MODE_SHM) {
+		shm_run(g_shm_name);
+		return 0;
+	} else if (g_mode == MODE_VIEW) {
+		spectate_run_viewer(g_view_path);
+		capture_stop();
+		return 0;
+	} else if (g_mode == MODE_BATCH) {
+		return batch_run(g_batch_dir, g_batch_games, g_batch_workers, g_batch_seed) ? 0 : 1;
+	} else if (g_mode == MODE_STATS) {
+		return batch_print_stats(g_stats_path) ? 0 : 1;
+	}
+
+	game_init_backend(g_offscreen ? &render_framebuffer_backend : &render_sdl_backend);
+	board_add_sprites();
+	game_build_sprites();
 	//game_set_state(&pman_game_state);
 	game_set_state(&menu_game_state);
 	game_run();
+	capture_stop();
 	game_shutdown();
 
 	return 0;
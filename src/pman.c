@@ -9,12 +9,16 @@
 #include "font.h"
 #include "state.h"
 #include "debug.h"
+#include "fixed.h"
+#include "compositor.h"
 #include "pman.h"
 #include "pman_agent.h"
 #include "pman_board.h"
 #include "pman_score.h"
 #include "pman_agent_ghost.h"
 #include "pman_agent_fruit.h"
+#include "pman_heatmap.h"
+#include "pman_tune.h"
 #include "menu.h"
 #include "hiscore.h"
 #include "audio.h"
@@ -39,6 +43,9 @@ static State g_play_state;
 /* Whether or not to show the "READY!" text */
 static int g_show_ready_text;
 
+/* Whether pac man has run out of lives. */
+static int g_is_game_over;
+
 /* Whether or not the game is in demo mode. */
 static int g_demo_flag = 0;
 
@@ -73,10 +80,19 @@ int pman_in_demo_mode()
 	return g_demo_flag;
 }
 
+/* Puts the rectangle that the "ready" text is drawn in into "r". */
+void pman_get_ready_text_rect(SDL_Rect *r)
+{
+	font_get_string_rect_centered(game_get_font_big(), g_board.draw_rect.x + (g_board.draw_rect.w / 2), g_board.draw_rect.y + (BLOCK(17) + (BLOCK_SIZE/2)), PMAN_READY_TEXT, r);
+}
+
 void pman_set_show_ready_text(int flag)
 {
+	SDL_Rect r;
+
 	g_show_ready_text = flag;
-	game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+	pman_get_ready_text_rect(&r);
+	game_invalidate_layer(COMPOSITOR_LAYER_HUD, &r);
 }
 
 int pman_get_level()
@@ -84,11 +100,28 @@ int pman_get_level()
 	return g_level;
 }
 
+/* Sets the level without restarting it.  Used by the spectator viewer, which
+   gets the level from the game it's watching. */
+void pman_set_level(int level)
+{
+	g_level = level;
+}
+
 Board *pman_get_board()
 {
 	return &g_board;
 }
 
+Score *pman_get_score()
+{
+	return &g_score;
+}
+
+int pman_is_game_over()
+{
+	return g_is_game_over;
+}
+
 void intentional_delay(int time)
 {
 	Uint32 timer;
@@ -97,6 +130,46 @@ void intentional_delay(int time)
 	while (SDL_GetTicks() < timer) { }
 }
 
+/* Saves the entire game world into the given snapshot. */
+void pman_snapshot_save(WorldSnapshot *ws)
+{
+	ws->board = g_board;
+	ws->score = g_score;
+	ws->level = g_level;
+	ws->play_state = g_play_state;
+	ws->show_ready_text = g_show_ready_text;
+	ws->is_game_over = g_is_game_over;
+	ws->rand_state = rand_get_state();
+	state_snapshot_save(&ws->state);
+}
+
+/* Puts the entire game world back the way it was when the given snapshot was
+   saved.  Nothing's redrawn until the next frame is, so restoring is cheap when
+   nothing's being drawn. */
+void pman_snapshot_restore(const WorldSnapshot *ws)
+{
+	SDL_Surface *pman_frames = g_board.pman.frames;
+	SDL_Surface *fruit_frames = g_board.fruit.frames;
+
+	g_board = ws->board;
+	g_board.pman.frames = pman_frames;
+	g_board.fruit.frames = fruit_frames;
+
+	g_score = ws->score;
+	g_score.score_changed = 1;
+	g_level = ws->level;
+	g_play_state = ws->play_state;
+	g_show_ready_text = ws->show_ready_text;
+	g_is_game_over = ws->is_game_over;
+	rand_set_state(ws->rand_state);
+	state_snapshot_restore(&ws->state);
+
+	/* The agents are marked dirty by the next frame's view, but the board's nibs
+	   and walls may have changed without it knowing. */
+	game_invalidate_layer(COMPOSITOR_LAYER_WALLS, &g_board.draw_rect);
+	game_invalidate_layer(COMPOSITOR_LAYER_NIBS, &g_board.draw_rect);
+}
+
 void play_state_init()
 {
 	state_construct(&g_play_state, STATE_ID_PLAY_STATE, STATE_ID_PLAY_STATE, NULL, TIMER_ID_GAME);
@@ -137,21 +210,29 @@ void pman_init()
 	pman_register_state_machines();
 
 	g_level = 0;
+	g_is_game_over = 0;
 
 	board_init(&g_board, PMAN_BOARD_OFFSET_X, PMAN_BOARD_OFFSET_Y);
 	score_init(&g_score, PMAN_SCORE_OFFSET_X, PMAN_SCORE_OFFSET_Y);
 	play_state_init();
 
-	pman_load_sounds();
-	audio_pause(0);
+	board_set_layers(&g_board);
+	game_set_layer(COMPOSITOR_LAYER_HUD, pman_draw_hud, NULL);
+
+	if (!game_is_headless()) {
+		pman_load_sounds();
+		audio_pause(0);
+	}
 
 	state_send_message(STATE_MSG_OnEnter, 0, STATE_ID_PLAY_STATE, 0, 0);
 }
 
 void pman_shutdown()
 {
-	audio_pause(1);
-	pman_free_sounds();
+	if (!game_is_headless()) {
+		audio_pause(1);
+		pman_free_sounds();
+	}
 
 	board_destroy(&g_board);
 	score_destroy(&g_score);
@@ -162,15 +243,29 @@ void pman_model(Uint32 frame_time)
 	state_send_message(STATE_MSG_OnUpdate, 0, STATE_ID_PLAY_STATE, 0, &frame_time);
 }
 
-void pman_view(SDL_Surface *surface, int game_view_flags)
+/* Draws the scoreboard and the "ready" text, if they're in the given rectangle of the
+   surface.  This is the game's HUD layer;  the board supplies the layers under it. */
+void pman_draw_hud(SDL_Surface *surface, SDL_Rect *r, void *data)
 {
-	board_draw(&g_board, surface, game_view_flags);
-	score_draw(&g_score, surface, game_view_flags);
+	SDL_Rect text_rect;
+
+	if (rects_intersect(r, &g_score.draw_rect))
+		score_draw(&g_score, surface);
 	if (g_show_ready_text) {
-		font_draw_string_centered(game_get_font_big(), surface, g_board.draw_rect.x + (g_board.draw_rect.w / 2), g_board.draw_rect.y + (BLOCK(17) + (BLOCK_SIZE/2)), PMAN_READY_TEXT);
+		pman_get_ready_text_rect(&text_rect);
+		if (rects_intersect(r, &text_rect))
+			font_draw_string_centered(game_get_font_big(), surface, g_board.draw_rect.x + (g_board.draw_rect.w / 2), g_board.draw_rect.y + (BLOCK(17) + (BLOCK_SIZE/2)), PMAN_READY_TEXT);
 	}
 }
 
+/* Everything's drawn by the layers set up in pman_init(), so all the view has to do
+   is mark what's changed. */
+void pman_view(SDL_Surface *surface, int game_view_flags)
+{
+	board_invalidate_changes(&g_board);
+	score_invalidate_changes(&g_score);
+}
+
 void pman_demo_init()
 {
 	g_demo_flag = 1;
@@ -227,13 +322,15 @@ BEGIN_STATE_MACHINE(play_state_machine)
 		ON_UPDATE
 			// call state machine update messages here, w/ time parameter
 			state_send_message(STATE_MSG_OnUpdate, 0, STATE_ID_BOARD, 0, sm->data);
+			heatmap_record(HEATMAP_LAYER_TRAFFIC, &g_board.pman);
 		ON_MSG(PLAY_STATE_MSG_LEVEL_WON)
 			SET_STATE(PLAY_STATE_LEVEL_WON);
 		ON_MSG(PLAY_STATE_MSG_PMAN_KILLED)
+			heatmap_record(HEATMAP_LAYER_DEATHS, &g_board.pman);
 			SET_STATE(PLAY_STATE_PMAN_KILLED);
 		ON_MSG(PLAY_STATE_MSG_NIBBLET_EATEN)
 			audio_sample_play(SAMPLE_ID_NIBBLET_EATEN);
-			score_add(&g_score, SCORE_NIBBLET_SCORE);
+			score_add(&g_score, g_tunables.score_nibblet_score);
 		ON_MSG(PLAY_STATE_MSG_NIBBLOON_EATEN)
 			int i;
 
@@ -249,6 +346,7 @@ BEGIN_STATE_MACHINE(play_state_machine)
 
 			if (agent->agent_type == GAME_AGENT_GHOST) {
 				audio_sample_play(SAMPLE_ID_GHOST_KILLED);
+				heatmap_record(HEATMAP_LAYER_KILLS, agent);
 			} else if (agent->agent_type == GAME_AGENT_FRUIT) {
 				audio_sample_play(SAMPLE_ID_FRUIT_EATEN);
 			}
@@ -275,6 +373,7 @@ BEGIN_STATE_MACHINE(play_state_machine)
 			if (score_lives_decrement(&g_score)) {
 				SET_STATE(PLAY_STATE_START_LEVEL_CONTINUE);
 			} else {
+				g_is_game_over = 1;
 				if (pman_in_demo_mode()) {
 					/* If in demo mode, set the test score to -1 so the hiscore module doesn't
 					   attempt to set a new hi score, but still displays the hiscore list for
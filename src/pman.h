@@ -4,7 +4,9 @@
 #include "SDL.h"
 
 #include "game.h"
+#include "state.h"
 #include "pman_board.h"
+#include "pman_score.h"
 
 /* Timer for game agents. */
 #define TIMER_ID_GAME_AGENT 1
@@ -94,7 +96,25 @@
 /* Number of ms that the ready text should display for at the beginning/continuing of the level. */
 #define PMAN_READY_TEXT_DELAY 3000
 
+/* A complete copy of the game world:  the board and everything on it, the
+   scoreboard, the level, the play state, the random number generator, and the
+   state module's timers and pending delayed messages.  It's a flat structure
+   that can be copied with memcpy().  The surface pointers inside the board are
+   only meaningful in the session that saved the snapshot, and are never
+   restored. */
+typedef struct WorldSnapshot {
+	Board board;
+	Score score;
+	int level;
+	State play_state;
+	int show_ready_text;
+	int is_game_over;
+	Uint32 rand_state;
+	StateSnapshot state;
+} WorldSnapshot;
+
 void pman_model(Uint32 frame_time);
+void pman_draw_hud(SDL_Surface *surface, SDL_Rect *r, void *data);
 void pman_view(SDL_Surface *surface, int game_view_flags);
 int pman_controller(SDL_Event *e);
 void pman_init();
@@ -103,9 +123,14 @@ void pman_demo_init();
 void pman_demo_shutdown();
 int pman_demo_controller(SDL_Event *e);
 Board *pman_get_board();
+Score *pman_get_score();
 int pman_get_level();
+void pman_set_level(int level);
+int pman_is_game_over();
 int pman_in_demo_mode();
 GameAgent *pman_get_game_agent(int state_id);
+void pman_snapshot_save(WorldSnapshot *ws);
+void pman_snapshot_restore(const WorldSnapshot *ws);
 
 const extern GameState pman_game_state;
 const extern GameState pman_demo_game_state;
@@ -7,6 +7,7 @@
 
 #include "fixed.h"
 #include "drawing.h"
+#include "compositor.h"
 #include "pman.h"
 #include "pman_board.h"
 #include "pman_agent.h"
@@ -302,24 +303,69 @@ void agent_get_draw_bounding_rect(GameAgent *ga, SDL_Rect *r, int x_ofs, int y_o
 	r->w = (Uint16) FIXED_GET_INT(ga->graphical_dim.y);
 }
 
-/* Fills the game agent's OLD location (its location last frame) with the same bounding
-   rectangle from the given background surface.  Used for dirty rectangle animation. */
-void agent_replace_background(GameAgent *ga, SDL_Surface *surface, SDL_Surface *background, int x_ofs, int y_ofs)
+/* Fills in what the game agent looks like right now. */
+void agent_get_look(GameAgent *ga, AgentLook *look)
 {
-	SDL_Rect r_src;
-	SDL_Rect r_dst;
+	look->is_visible = ga->is_visible;
+	look->frame = FIXED_GET_INT(ga->frame_curr);
+	look->direction = map_fixed_vector_to_direction(&ga->curr_move);
+	look->color = ga->color;
+	look->score_amount = ga->ghost_score_amount;
+	look->level = pman_get_level();
+}
 
-	r_src.x = (Sint16) (FIXED_GET_INT(ga->last_loc.x) + FIXED_GET_INT(ga->graphical_offset.x));
-	r_src.y = (Sint16) (FIXED_GET_INT(ga->last_loc.y) + FIXED_GET_INT(ga->graphical_offset.y));
+/* Puts the rectangle that the game agent covers when it's drawn at the given offset
+   into "r":  its sprite, along with its score amount if it's showing one (which can
+   be wider than the sprite).  The rectangle is empty if the agent isn't visible. */
+void agent_get_covered_rect(GameAgent *ga, SDL_Rect *r, int x_ofs, int y_ofs)
+{
+	char buffer[50];
+	SDL_Rect sprite_rect, text_rect;
 
-	r_src.h = r_dst.h = (Uint16) FIXED_GET_INT(ga->graphical_dim.x);
-	r_src.w = r_dst.w = (Uint16) FIXED_GET_INT(ga->graphical_dim.y);
+	if (!ga->is_visible) {
+		r->x = r->y = 0;
+		r->w = r->h = 0;
+		return;
+	}
 
-	r_dst.x = (Sint16) (r_src.x + x_ofs);
-	r_dst.y = (Sint16) (r_src.y + y_ofs);
+	agent_get_draw_bounding_rect(ga, &sprite_rect, x_ofs, y_ofs);
+	*r = sprite_rect;
+	if (ga->ghost_score_amount > 0) {
+		sprintf(buffer, "%d", ga->ghost_score_amount);
+		font_get_string_rect_centered(game_get_font_small(), sprite_rect.x + (sprite_rect.w / 2),
+			sprite_rect.y + (sprite_rect.h / 2), buffer, &text_rect);
+		rects_merge(&sprite_rect, &text_rect, r);
+	}
+}
 
-	game_update_rect_add(&r_dst);
-	SDL_BlitSurface(background, &r_src, surface, &r_dst);
+/* Checks whether the game agent has moved or changed its appearance since this was
+   last called, and if it has, marks where it was and where it is now as dirty on the
+   sprite layer (see compositor.h), so that it's redrawn.  The agent is drawn at the
+   given offset. */
+void agent_invalidate_changes(GameAgent *ga, int x_ofs, int y_ofs)
+{
+	AgentLook look;
+	SDL_Rect r;
+
+	agent_get_look(ga, &look);
+	agent_get_covered_rect(ga, &r, x_ofs, y_ofs);
+
+	if (r.x == ga->drawn_rect.x && r.y == ga->drawn_rect.y &&
+	    r.w == ga->drawn_rect.w && r.h == ga->drawn_rect.h &&
+	    look.is_visible == ga->drawn_look.is_visible &&
+	    look.frame == ga->drawn_look.frame &&
+	    look.direction == ga->drawn_look.direction &&
+	    look.color == ga->drawn_look.color &&
+	    look.score_amount == ga->drawn_look.score_amount &&
+	    look.level == ga->drawn_look.level)
+		return;
+
+	if (ga->drawn_rect.w)
+		game_invalidate_layer(COMPOSITOR_LAYER_SPRITES, &ga->drawn_rect);
+	if (r.w)
+		game_invalidate_layer(COMPOSITOR_LAYER_SPRITES, &r);
+	ga->drawn_rect = r;
+	ga->drawn_look = look;
 }
 
 /* Draws the game agent to the given surface. */
@@ -39,6 +39,21 @@
 /* Converts a speed value in pixels-per-decisecond to pixels-per-millisecond. */
 #define CONVERT_PPDS_TO_PPMS(x) ( (double) (x) / 100 )
 
+/* Everything about how a game agent looks on the screen, apart from where it
+   is.  If none of it has changed since the agent was last drawn, and the agent
+   hasn't moved, it doesn't need to be drawn again. */
+typedef struct AgentLook {
+	int is_visible;
+	/* Pac man's current animation frame. */
+	int frame;
+	/* DIRECTION_* constant the agent is facing (-1 if it isn't moving). */
+	int direction;
+	Uint32 color;
+	int score_amount;
+	/* The level, which picks the fruit's sprite. */
+	int level;
+} AgentLook;
+
 /* Game agent structure.  This stores all information for a game agent, which
    generally means either pac man or a ghost. */
 typedef struct GameAgent {
@@ -57,10 +72,16 @@ typedef struct GameAgent {
 	FixedVector physical_dim;
 	/* The physical location of the game agent. */
 	FixedVector loc;
-	/* The location of the game agent in the last frame.  This is used for
-	   "dirty rectangle" animation so the game can just erase where the game agent
-	   used to be instead of having to redraw the entire screen. */
+	/* The location of the game agent before its last move. */
 	FixedVector last_loc;
+	/* The area of the screen the game agent covered when it was last drawn (w
+	   and h are 0 if it wasn't), and what it looked like.  This is used for
+	   "dirty rectangle" animation, so the game can just redraw where the game
+	   agent used to be and where it is now instead of having to redraw the
+	   entire screen, and can leave agents that haven't changed alone
+	   altogether (see agent_invalidate_changes()). */
+	SDL_Rect drawn_rect;
+	AgentLook drawn_look;
 	/* The current move (direction of movement) of the game agent.  This is
 	   a fixed_vector_* constant, as defined in fixed.h. */
 	FixedVector curr_move;
@@ -84,6 +105,9 @@ typedef struct GameAgent {
 	   fix cases of "lagging state messages" when the ghosts are already fleeing and
 	   pman eats another nibbloon. */
 	int ghost_flee_times;
+	/* Time on the ghost's timer at which it stops fleeing, if it's fleeing.  Use
+	   agent_ghost_flee_time_left() to find out how long it has left. */
+	Uint32 ghost_flee_end_time;
 	/* Whether the ghost can open the asylum door.  Not used for pman. */
 	int can_open_asylum_door;
 	/* # of times ghost hits asylum walls while resting before he decides to leave. 
@@ -93,9 +117,11 @@ typedef struct GameAgent {
 	   If this is nonzero, it means the ghost should display the points instead of its
 	   ghost-form. */
 	int ghost_score_amount;
-	/* Tiled bitmap surface representing the sprite frames of game agent.  Used by
-	   pac man game agent only. */
+	/* Tiled bitmap surface representing the sprite frames of game agent (the game's
+	   sprite atlas), and where the frames are on it.  Used by pac man and fruit
+	   game agents only, and NULL when there's no screen. */
 	SDL_Surface *frames;
+	SDL_Rect frames_rect;
 	/* Current frame.  Used by pacman only. */
 	fixed frame_curr;
 	/* Animation speed ("frame velocity").  Used by pacman only. */
@@ -118,7 +144,9 @@ void agent_set_move(GameAgent *ga, const FixedVector *v);
 void agent_set_next_move(GameAgent *ga, const FixedVector *v);
 
 void agent_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs);
-void agent_replace_background(GameAgent *ga, SDL_Surface *surface, SDL_Surface *background, int x_ofs, int y_ofs);
+void agent_get_look(GameAgent *ga, AgentLook *look);
+void agent_get_covered_rect(GameAgent *ga, SDL_Rect *r, int x_ofs, int y_ofs);
+void agent_invalidate_changes(GameAgent *ga, int x_ofs, int y_ofs);
 
 void agent_toggle_visible(GameAgent *ga);
 
@@ -13,6 +13,7 @@
 #include "pman_agent.h"
 #include "pman_agent_ghost.h"
 #include "pman_agent_fruit.h"
+#include "pman_tune.h"
 
 /* Restarts the fruit at the beginning/continuing of each level. */
 void agent_fruit_restart(GameAgent *ga)
@@ -22,11 +23,17 @@ void agent_fruit_restart(GameAgent *ga)
 	state_construct(&ga->state, STATE_ID_AGENT_FRUIT, STATE_ID_AGENT_FRUIT, ga, TIMER_ID_GAME_AGENT);
 }
 
+/* Loads the fruit's tiled image onto the game's sprite atlas. */
+void agent_fruit_add_sprites()
+{
+	game_add_sprite(FRUIT_BMP, game_load_bmp(FRUIT_BMP));
+}
+
 /* Initializes fruit and its graphics. */
 void agent_fruit_init(GameAgent *ga)
 {
 	ga->agent_type = GAME_AGENT_FRUIT;
-	ga->frames = game_load_bmp(FRUIT_BMP);
+	ga->frames = game_get_sprite(FRUIT_BMP, &ga->frames_rect);
 	fixed_vector_set(&ga->loc, FRUIT_PIXEL_X, FRUIT_PIXEL_Y);
 	ga->last_loc = ga->loc;
 	fixed_vector_set(&ga->graphical_dim, BLOCK_SIZE+8, BLOCK_SIZE+8);
@@ -50,8 +57,8 @@ void agent_fruit_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs)
 	r_src.w = (Uint16) FIXED_GET_INT(ga->graphical_dim.x);
 	r_src.h = (Uint16) FIXED_GET_INT(ga->graphical_dim.y);
 
-	r_src.x = (Sint16) 0;
-	r_src.y = (Sint16) curr_level * r_src.h;
+	r_src.x = ga->frames_rect.x;
+	r_src.y = (Sint16) (ga->frames_rect.y + curr_level * r_src.h);
 
 	agent_get_draw_bounding_rect(ga, &r_dst, x_ofs, y_ofs);
 
@@ -64,15 +71,14 @@ void agent_fruit_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs)
 	}
 
 	/* Otherwise, draw the fruit sprite. */
-	game_update_rect_add(&r_dst);
-
-	SDL_BlitSurface(ga->frames, &r_src, surface, &r_dst);	
+	game_blit_sprite(&r_src, surface, &r_dst);	
 }
 
-/* Free all memory dynamically allocated by agent_fruit_init(). */
+/* Free all memory dynamically allocated by agent_fruit_init().  (The fruit's
+   image belongs to the game's sprite atlas.) */
 void agent_fruit_destroy(GameAgent *ga)
 {
-	SDL_FreeSurface(ga->frames);
+	ga->frames = NULL;
 }
 
 /* Creates temporary int pool storage for a new fruit ID, increments
@@ -102,7 +108,7 @@ BEGIN_STATE_MACHINE(agent_fruit_state_machine)
 
 		data = agent_fruit_id_new(fruit);
 
-		state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(FRUIT_INITIAL_RAND_TIME)+FRUIT_INITIAL_BASE_TIME, data);
+		state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(g_tunables.fruit_initial_rand_time)+g_tunables.fruit_initial_base_time, data);
 	ON_MSG(AGENT_MSG_HIT_PMAN)
 		if (fruit->is_visible) {
 			state_send_message(PLAY_STATE_MSG_AGENT_KILLED, s->state_id, STATE_ID_PLAY_STATE, 0, 0);
@@ -115,7 +121,7 @@ BEGIN_STATE_MACHINE(agent_fruit_state_machine)
 
 		data = agent_fruit_id_new(fruit);
 
-		state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(FRUIT_EATEN_RAND_TIME)+FRUIT_EATEN_BASE_TIME, data);	
+		state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(g_tunables.fruit_eaten_rand_time)+g_tunables.fruit_eaten_base_time, data);	
 	ON_MSG(FRUIT_MSG_DISPLAY_TOGGLE)
 		int *data;
 
@@ -131,8 +137,8 @@ BEGIN_STATE_MACHINE(agent_fruit_state_machine)
 		   *_BASE_TIME and *_RAND_TIME constants to tell the game how much time
 		   needs to pass for us to disappear or reappear, respectively. */
 		if (fruit->is_visible) {
-			state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(FRUIT_APPEARED_RAND_TIME)+FRUIT_APPEARED_BASE_TIME, data);
+			state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(g_tunables.fruit_appeared_rand_time)+g_tunables.fruit_appeared_base_time, data);
 		} else {
-			state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(FRUIT_DISAPPEARED_RAND_TIME)+FRUIT_DISAPPEARED_BASE_TIME, data);
+			state_send_message(FRUIT_MSG_DISPLAY_TOGGLE, 0, STATE_ID_AGENT_FRUIT, rand_int(g_tunables.fruit_disappeared_rand_time)+g_tunables.fruit_disappeared_base_time, data);
 		}
 END_STATE_MACHINE
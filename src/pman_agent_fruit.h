@@ -25,7 +25,10 @@
    certain event.  The time is calculated such that if the
    base time is 10 seconds and rand time is 5 seconds, then the
    amount of time that will need to pass for the fruit to toggle
-   its visibility will be 10-15 seconds. */
+   its visibility will be 10-15 seconds.
+
+   These are only the defaults;  the game uses the tunables (see
+   pman_tune.h). */
 
 /* Time to appear on the board after the level starts/continues. */
 #define FRUIT_INITIAL_BASE_TIME  10000
@@ -46,6 +49,7 @@
 #define FRUIT_APPEARED_RAND_TIME    0
 
 void agent_fruit_restart(GameAgent *ga);
+void agent_fruit_add_sprites();
 void agent_fruit_init(GameAgent *ga);
 void agent_fruit_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs);
 void agent_fruit_destroy(GameAgent *ga);
@@ -2,20 +2,32 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL.h"
 
 #include "fixed.h"
 #include "drawing.h"
+#include "game.h"
 #include "pman.h"
 #include "pman_board.h"
 #include "pman_agent.h"
 #include "pman_agent_ghost.h"
 #include "pman_agent_pman.h"
+#include "pman_tune.h"
 
 /* Array of colors/sprite-states used by the ghost game agent. */
 static Uint32 g_ghost_colors[GHOST_MAX_COLORS] = {0};
 
+/* The game's sprite atlas, once it's been looked up, and where the ghost
+   sprite sheet (see pman_agent_ghost.h) is on it. */
+static SDL_Surface *g_ghost_frames = NULL;
+static SDL_Rect g_ghost_frames_rect;
+
+/* Body color of each row of the sprite sheet. */
+static Uint32 g_ghost_body_colors[GHOST_SPRITE_MAX_BODIES];
+static int g_ghost_num_bodies = 0;
+
 /* Draws the eyes (whites of eyes and pupils) of a ghost at the given location.  The
    eyes are looking in the given direction. */
 void ghost_draw_eyes(SDL_Surface *surface, SDL_Rect *r, int direction)
@@ -128,6 +140,12 @@ void ghost_draw_scared_features(SDL_Surface *surface, SDL_Rect *r, Uint32 color)
 	}
 }
 
+/* Returns the color of the given GHOST_COLOR_* constant. */
+Uint32 agent_ghost_get_color(int color_id)
+{
+	return g_ghost_colors[color_id];
+}
+
 /* Initializes the ghost global color array. */
 void ghost_colors_init()
 {
@@ -138,10 +156,91 @@ void ghost_colors_init()
 	g_ghost_colors[GHOST_COLOR_SCARED_FEATURES] = game_map_rgb(255, 0, 0);
 }
 
+/* Draws a ghost with the given color and eye direction from scratch. */
+void ghost_draw(SDL_Surface *surface, SDL_Rect *r, Uint32 color, int direction)
+{
+	if (color == g_ghost_colors[GHOST_COLOR_SCARED]) {
+		/* If they're scared, draw their body and then their scared features */
+		ghost_draw_body(surface, r, color);
+		ghost_draw_scared_features(surface, r, g_ghost_colors[GHOST_COLOR_SCARED_FEATURES]);
+	} else if (color == g_ghost_colors[GHOST_COLOR_SPIRIT]) {
+		/* If they're in spirit form and running back to the asylum to get respawned,
+		   draw only their eyes. */
+		ghost_draw_eyes(surface, r, direction);
+	} else {
+		/* Otherwise, draw their body and then their eyes. */
+		ghost_draw_body(surface, r, color);
+		ghost_draw_eyes(surface, r, direction);
+	}
+}
+
+/* Returns a color that isn't used by any ghost sprite, for the transparent
+   parts of the sprite sheet. */
+Uint32 ghost_pick_color_key()
+{
+	static const Uint8 candidates[][3] = {
+		{ 0, 255, 255 }, { 255, 255, 0 }, { 128, 64, 0 }, { 0, 128, 128 }
+	};
+	int c, i;
+
+	for (c = 0; c < (int) (sizeof(candidates) / sizeof(candidates[0])); c++) {
+		Uint32 key = game_map_rgb(candidates[c][0], candidates[c][1], candidates[c][2]);
+		int used = 0;
+
+		for (i = 0; i <= GHOST_COLOR_SCARED_FEATURES; i++)
+			if (g_ghost_colors[i] == key) used = 1;
+		for (i = 0; i < g_ghost_num_bodies; i++)
+			if (g_ghost_body_colors[i] == key) used = 1;
+		if (!used) return key;
+	}
+	assert(0);
+	return 0;
+}
+
+/* Renders the ghost sprite sheet, with a row for each of the given body
+   colors, and adds it to the game's sprite atlas. */
+void agent_ghost_add_sprites(const Uint32 body_colors[], int num_bodies)
+{
+	SDL_Surface *s;
+	SDL_Rect r;
+	Uint32 key;
+	int row, col;
+
+	assert(num_bodies <= GHOST_SPRITE_MAX_BODIES);
+	ghost_colors_init();
+	memcpy(g_ghost_body_colors, body_colors, sizeof(Uint32) * num_bodies);
+	g_ghost_num_bodies = num_bodies;
+
+	s = game_create_bitmap(0, GHOST_SPRITE_SIZE * GHOST_SPRITE_COLUMNS, GHOST_SPRITE_SIZE * (num_bodies + 2));
+	assert(s != NULL);
+
+	key = ghost_pick_color_key();
+	SDL_FillRect(s, NULL, key);
+
+	r.w = (Uint16) GHOST_SPRITE_SIZE;
+	r.h = (Uint16) GHOST_SPRITE_SIZE;
+	for (row = 0; row <= num_bodies; row++) {
+		Uint32 color = row < num_bodies ? body_colors[row] : g_ghost_colors[GHOST_COLOR_SPIRIT];
+
+		for (col = 0; col < GHOST_SPRITE_COLUMNS; col++) {
+			r.x = (Sint16) (col * GHOST_SPRITE_SIZE);
+			r.y = (Sint16) (row * GHOST_SPRITE_SIZE);
+			ghost_draw(s, &r, color, col < 4 ? col : -1);
+		}
+	}
+	r.x = 0;
+	r.y = (Sint16) ((num_bodies + 1) * GHOST_SPRITE_SIZE);
+	ghost_draw(s, &r, g_ghost_colors[GHOST_COLOR_SCARED], -1);
+
+	SDL_SetColorKey(s, SDL_SRCCOLORKEY | SDL_RLEACCEL, key);
+	game_add_sprite(GHOST_SPRITE_NAME, s);
+}
+
 /* Draws the ghost agent at the given location, depending on its color state. */
 void agent_ghost_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs)
 {
-	SDL_Rect r;
+	SDL_Rect r, r_src;
+	int direction, row, col;
 
 	agent_get_draw_bounding_rect(ga, &r, x_ofs, y_ofs);
 
@@ -150,21 +249,34 @@ void agent_ghost_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs)
 		return;
 	}
 
+	direction = map_fixed_vector_to_direction(&ga->curr_move);
+	col = direction < 0 ? GHOST_SPRITE_COLUMNS - 1 : direction;
+
 	if (ga->color == g_ghost_colors[GHOST_COLOR_SCARED]) {
-		/* If they're scared, draw their body and then their scared features */
-		ghost_draw_body(surface, &r, ga->color);
-		ghost_draw_scared_features(surface, &r, g_ghost_colors[GHOST_COLOR_SCARED_FEATURES]);
+		row = g_ghost_num_bodies + 1;
+		col = 0;
 	} else if (ga->color == g_ghost_colors[GHOST_COLOR_SPIRIT]) {
-		/* If they're in spirit form and running back to the asylum to get respawned,
-		   draw only their eyes. */
-		ghost_draw_eyes(surface, &r, map_fixed_vector_to_direction(&ga->curr_move));
+		row = g_ghost_num_bodies;
 	} else {
-		/* Otherwise, draw their body and then their eyes. */
-		ghost_draw_body(surface, &r, ga->color);
-		ghost_draw_eyes(surface, &r, map_fixed_vector_to_direction(&ga->curr_move));
+		for (row = 0; row < g_ghost_num_bodies; row++)
+			if (g_ghost_body_colors[row] == ga->color) break;
+		if (row == g_ghost_num_bodies) row = -1;
+	}
+
+	if (row < 0) {
+		/* Not on the sprite sheet. */
+		ghost_draw(surface, &r, ga->color, direction);
+		return;
 	}
 
-	game_update_rect_add(&r);
+	if (!g_ghost_frames)
+		g_ghost_frames = game_get_sprite(GHOST_SPRITE_NAME, &g_ghost_frames_rect);
+
+	r_src.x = (Sint16) (g_ghost_frames_rect.x + col * GHOST_SPRITE_SIZE);
+	r_src.y = (Sint16) (g_ghost_frames_rect.y + row * GHOST_SPRITE_SIZE);
+	r_src.w = (Uint16) GHOST_SPRITE_SIZE;
+	r_src.h = (Uint16) GHOST_SPRITE_SIZE;
+	game_blit_sprite(&r_src, surface, &r);
 }
 
 /* Restarts the ghost game agent.  Should be called whenever a
@@ -176,7 +288,7 @@ void agent_ghost_restart(GameAgent *ga, int block_x, int block_y, int state_id,
 	ga->ghost_resting_hit_times = resting_hit_times;
 	ga->can_open_asylum_door = 0;
 	//ga->original_speed = FIXED_SET_INT(PMAN_BASE_SPEED + pman_get_level());
-	ga->original_speed = fixed_from_float( CONVERT_PPDS_TO_PPMS(PMAN_BASE_SPEED + GHOST_ADDED_SPEED_PER_LEVEL*pman_get_level()) );
+	ga->original_speed = fixed_from_float( CONVERT_PPDS_TO_PPMS(g_tunables.pman_base_speed + g_tunables.ghost_added_speed_per_level*pman_get_level()) );
 	ga->speed = ga->original_speed;
 	ga->color = ga->original_color;
 	ga->ghost_flee_times = 0;
@@ -188,6 +300,17 @@ void agent_ghost_restart(GameAgent *ga, int block_x, int block_y, int state_id,
 	ga->state.state = initial_state;
 }
 
+/* Returns the number of ms the given ghost has left to flee for, or 0 if it
+   isn't fleeing. */
+int agent_ghost_flee_time_left(GameAgent *ga)
+{
+	Uint32 now;
+
+	if (ga->state.state != GHOST_STATE_FLEEING) return 0;
+	now = state_timer_get_ticks(ga->state.timer_id);
+	return (ga->ghost_flee_end_time > now) ? (int) (ga->ghost_flee_end_time - now) : 0;
+}
+
 /* Initializes the ghost game agent.  This should take care of any
    dynamic memory allocation that needs to be done, and should only
    really be called once per gameplay session. */
@@ -195,7 +318,7 @@ void agent_ghost_init(GameAgent *ga, Uint32 color)
 {
 	ga->agent_type = GAME_AGENT_GHOST;
 	fixed_vector_set(&ga->graphical_offset, -4, -4);
-	fixed_vector_set(&ga->graphical_dim, BLOCK_SIZE+8, BLOCK_SIZE+8);
+	fixed_vector_set(&ga->graphical_dim, GHOST_SPRITE_SIZE, GHOST_SPRITE_SIZE);
 	fixed_vector_set(&ga->physical_dim, BLOCK_SIZE-1, BLOCK_SIZE-1);
 	ga->original_color = color;
 	ghost_colors_init();
@@ -350,20 +473,25 @@ BEGIN_STATE_MACHINE(agent_ghost1_state_machine)
 	STATE(GHOST_STATE_FLEEING)
 		ON_ENTER
 			int *data;
+			int flee_time = g_tunables.ghost_flee_initial_time - (g_tunables.ghost_flee_less_time_per_level*pman_get_level());
 
+			if (flee_time < 0) flee_time = 0;
 			ghost->color = g_ghost_colors[GHOST_COLOR_SCARED];
-			ghost->speed = FIXED_MULT(ghost->speed, fixed_from_float(GHOST_FLEE_SPEED_MULTIPLIER));
+			ghost->speed = FIXED_MULT(ghost->speed, fixed_from_float(g_tunables.ghost_flee_speed_multiplier));
 			/* Change the "fleeing" id so that old fleeing messages that are still queued are
 			   now ignored.  All state messages dealing with fleeing behavior will have the
 			   current value of this variable passed as the message data, so as to "tag" which
 			   particular fleeing state the message belongs to. */
 			ghost->ghost_flee_times++;
 			ghost->ghost_flee_flash_times = GHOST_FLEE_FLASH_TIMES;
+			/* The ghost flashes once it's been fleeing for flee_time, and stops on
+			   its last flash. */
+			ghost->ghost_flee_end_time = state_timer_get_ticks(s->timer_id) + flee_time + GHOST_FLEE_FLASH_TIMES*GHOST_FLEE_FLASH_DELAY;
 			agent_ghost_scared_determine_next_move(ghost, 1);
 
 			data = temp_int_pool_get_int();
 			*data = ghost->ghost_flee_times;
-			state_send_message(GHOST_MSG_FLEE_FLASH, 0, s->state_id, GHOST_FLEE_INITIAL_TIME - (GHOST_FLEE_LESS_TIME_PER_LEVEL*pman_get_level()), data );
+			state_send_message(GHOST_MSG_FLEE_FLASH, 0, s->state_id, flee_time, data );
 		ON_EXIT
 			ghost->color = ghost->original_color;
 			ghost->speed = ghost->original_speed;
@@ -390,7 +518,6 @@ BEGIN_STATE_MACHINE(agent_ghost1_state_machine)
 			SET_STATE(GHOST_STATE_SPIRIT);
 		ON_EXIT
 			ghost->ghost_score_amount = 0;
-			game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
 	STATE(GHOST_STATE_SPIRIT)
 		ON_ENTER
 			ghost->color = g_ghost_colors[GHOST_COLOR_SPIRIT];
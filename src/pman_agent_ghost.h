@@ -71,6 +71,10 @@
    fleeing. */
 #define GHOST_MSG_START_FLEEING 502
 
+/* GHOST_FLEE_INITIAL_TIME, GHOST_FLEE_LESS_TIME_PER_LEVEL,
+   GHOST_FLEE_SPEED_MULTIPLIER and GHOST_ADDED_SPEED_PER_LEVEL are only the
+   defaults;  the game uses the tunables (see pman_tune.h). */
+
 /* Number of ms after the ghost starts fleeing that it should start flashing. */
 #define GHOST_FLEE_INITIAL_TIME 10000
 /* Amount of time to subtract from GHOST_FLEE_INITIAL_TIME per level. */
@@ -96,9 +100,29 @@
 /* Height of triangles at the bottom of the ghost body. */
 #define GHOST_SPRITE_TRIANGLE_HEIGHT 3
 
+/* Ghosts are drawn from a sprite sheet on the game's sprite atlas, rendered
+   by agent_ghost_add_sprites().  It has a row for each ghost body color, with
+   a sprite for each direction the eyes can look in (the DIRECTION_* constants,
+   then straight ahead), then a row of spirit-form eyes in the same order, then
+   a row with the scared sprite in it.  Ghosts whose color isn't on the sheet
+   are drawn from scratch. */
+
+/* Name of the sprite sheet on the atlas. */
+#define GHOST_SPRITE_NAME "ghosts"
+/* Width and height of each ghost sprite. */
+#define GHOST_SPRITE_SIZE (BLOCK_SIZE+8)
+
+/* Most ghost body colors on the sprite sheet. */
+#define GHOST_SPRITE_MAX_BODIES 8
+/* Sprites in each row of the sprite sheet. */
+#define GHOST_SPRITE_COLUMNS 5
+
 void agent_ghost_restart(GameAgent *ga, int block_x, int block_y, int state_id, int state_machine_id, int initial_state, int resting_hit_times);
 void agent_ghost_init(GameAgent *ga, Uint32 color);
+void agent_ghost_add_sprites(const Uint32 body_colors[], int num_bodies);
 void agent_ghost_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs);
+int agent_ghost_flee_time_left(GameAgent *ga);
+Uint32 agent_ghost_get_color(int color_id);
 
 DECLARE_STATE_MACHINE(agent_ghost1_state_machine);
 
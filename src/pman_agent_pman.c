@@ -5,12 +5,36 @@
 
 #include "SDL.h"
 
+#include "game.h"
 #include "fixed.h"
 #include "drawing.h"
 #include "pman.h"
 #include "pman_board.h"
 #include "pman_agent.h"
 #include "pman_agent_pman.h"
+#include "pman_planner.h"
+#include "pman_rollout.h"
+#include "pman_tune.h"
+
+/* How pac man is steered when he's under AI control.  See the PMAN_AI_* constants. */
+static int g_pman_ai_mode = PMAN_AI_PLANNER;
+
+/* The planner that steers pac man in PMAN_AI_PLANNER mode.  Its junction graph
+   is also used to find junctions in PMAN_AI_ROLLOUT mode. */
+static Planner g_pman_planner;
+
+/* Sets how pac man is steered when he's under AI control.  Should be one of the
+   PMAN_AI_* constants. */
+void agent_pman_set_ai_mode(int mode)
+{
+	g_pman_ai_mode = mode;
+}
+
+/* Returns how pac man is steered when he's under AI control. */
+int agent_pman_get_ai_mode()
+{
+	return g_pman_ai_mode;
+}
 
 /* Restarts the pac man game agent.  Should be called whenever a
    new level starts. */
@@ -18,7 +42,7 @@ void agent_pman_restart(GameAgent *ga)
 {
 	ga->frame_curr = 0;
 	ga->is_visible = 1;
-	ga->speed = fixed_from_float( CONVERT_PPDS_TO_PPMS(PMAN_BASE_SPEED) );
+	ga->speed = fixed_from_float( CONVERT_PPDS_TO_PPMS(g_tunables.pman_base_speed) );
 	ga->curr_move = fixed_vector_zero;
 	ga->next_move = fixed_vector_zero;
 	fixed_vector_set(&ga->loc, PMAN_START_BLOCK_X*BLOCK_SIZE+(BLOCK_SIZE/2), PMAN_START_BLOCK_Y*BLOCK_SIZE);
@@ -27,6 +51,8 @@ void agent_pman_restart(GameAgent *ga)
 
 	if (ga->pman_ai_flag) {
 		agent_set_next_move(ga, &fixed_vector_left);
+		planner_init(&g_pman_planner, pman_get_board());
+		planner_look_ahead(&g_pman_planner, pman_get_board(), PMAN_START_BLOCK_X, PMAN_START_BLOCK_Y, DIRECTION_LEFT);
 	} else {
 		agent_set_next_move(ga, &fixed_vector_zero);
 	}
@@ -39,10 +65,10 @@ void agent_pman_init(GameAgent *ga)
 {
 	ga->agent_type = GAME_AGENT_PMAN;
 	fixed_vector_set(&ga->graphical_offset, -3, -3);
-	fixed_vector_set(&ga->graphical_dim, BLOCK_SIZE+6, BLOCK_SIZE+6);
+	fixed_vector_set(&ga->graphical_dim, PMAN_SPRITE_SIZE, PMAN_SPRITE_SIZE);
 	fixed_vector_set(&ga->physical_dim, BLOCK_SIZE-1, BLOCK_SIZE-1);
 	ga->color = game_map_rgb(255, 255, 0);
-	agent_pman_generate_frames(ga);
+	ga->frames = game_get_sprite(PMAN_SPRITE_NAME, &ga->frames_rect);
 	ga->frame_speed = fixed_from_float( CONVERT_PPDS_TO_PPMS(PMAN_FRAME_SPEED) );
 	ga->pman_ai_flag = pman_in_demo_mode();
 }
@@ -50,7 +76,33 @@ void agent_pman_init(GameAgent *ga)
 /* Free all memory dynamically allocated by agent_pman_init(). */
 void agent_pman_destroy(GameAgent *ga)
 {
-	SDL_FreeSurface(ga->frames);
+	rollout_shutdown();
+}
+
+/* Decides where AI-controlled pac man goes next, given that he's just arrived
+   at a new block.  At junctions the planner or the rollout workers make the
+   decision; everywhere else he just follows the corridor. */
+void agent_pman_ai_determine_next_move(GameAgent *ga)
+{
+	Board *b = pman_get_board();
+	int x, y, dir;
+
+	if (agent_in_tunnel(ga)) return;
+
+	x = GET_BLOCK_FIXED(ga->loc.x);
+	y = GET_BLOCK_FIXED(ga->loc.y);
+	dir = PLANNER_NONE;
+	if (g_pman_ai_mode == PMAN_AI_PLANNER)
+		dir = planner_choose_move(&g_pman_planner, b, x, y, map_fixed_vector_to_direction(&ga->curr_move));
+	else if (g_pman_ai_mode == PMAN_AI_ROLLOUT && planner_is_node(&g_pman_planner, x, y))
+		dir = rollout_choose_move(b, pman_get_level());
+	if (dir != PLANNER_NONE)
+		agent_set_move(ga, map_direction_to_fixed_vector(dir));
+	else
+		agent_determine_next_random_move(ga);
+
+	if (g_pman_ai_mode == PMAN_AI_PLANNER)
+		planner_look_ahead(&g_pman_planner, b, x, y, map_fixed_vector_to_direction(&ga->curr_move));
 }
 
 /* Draw the pac man game agent to the given surface. */
@@ -61,14 +113,12 @@ void agent_pman_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs)
 	r_src.w = (Uint16) FIXED_GET_INT(ga->graphical_dim.x);
 	r_src.h = (Uint16) FIXED_GET_INT(ga->graphical_dim.y);
 
-	r_src.x = (Sint16) FIXED_GET_INT(ga->frame_curr) * r_src.w;
-	r_src.y = (Sint16) 0;
+	r_src.x = (Sint16) (ga->frames_rect.x + FIXED_GET_INT(ga->frame_curr) * r_src.w);
+	r_src.y = ga->frames_rect.y;
 
 	agent_get_draw_bounding_rect(ga, &r_dst, x_ofs, y_ofs);
 
-	game_update_rect_add(&r_dst);
-
-	SDL_BlitSurface(ga->frames, &r_src, surface, &r_dst);
+	game_blit_sprite(&r_src, surface, &r_dst);
 }
 
 /* Advance the frame of pac man's current movement animation, given
@@ -95,8 +145,9 @@ void agent_pman_frame_advance(GameAgent *ga, Uint32 time)
 	}
 }
 
-/* Generate the frames for pac man's movement animation. */
-void agent_pman_generate_frames(GameAgent *ga)
+/* Generate the frames for pac man's movement animation, and add them to the
+   game's sprite atlas. */
+void agent_pman_add_sprites()
 {
 	int w, h;
 	int f, i;
@@ -104,8 +155,7 @@ void agent_pman_generate_frames(GameAgent *ga)
 	int x, y;
 	SDL_Surface *s;
 
-	w = FIXED_GET_INT(ga->graphical_dim.x);
-	h = FIXED_GET_INT(ga->graphical_dim.y);
+	w = h = PMAN_SPRITE_SIZE;
 	
 	s = game_create_bitmap(0, w * PMAN_FRAMES_PER_DIRECTION * 4, h);
 
@@ -119,7 +169,7 @@ void agent_pman_generate_frames(GameAgent *ga)
 			int center_x = x + radius;
 			int center_y = y + radius;
 
-			pman_draw(s, center_x, center_y, radius, i, 1, f, ga->color);
+			pman_draw(s, center_x, center_y, radius, i, 1, f, game_map_rgb(255, 255, 0));
 
 			//drawCircle(s, center_x, center_y, radius, FILL_FULL, ga->color);
 			//drawPmanWedge(s, center_x, center_y, radius, i, 1, f);
@@ -127,10 +177,8 @@ void agent_pman_generate_frames(GameAgent *ga)
 		}
 	}
 	SDL_SetColorKey(s, SDL_SRCCOLORKEY | SDL_RLEACCEL, game_map_rgb(0,0,0));
-	ga->frames = SDL_DisplayFormatAlpha(s);
-	assert(ga->frames != NULL);
 
-	SDL_FreeSurface(s);
+	game_add_sprite(PMAN_SPRITE_NAME, s);
 }
 
 /* Draw a pac man sprite to the screen. */
@@ -268,6 +316,16 @@ BEGIN_STATE_MACHINE(agent_pman_state_machine)
 		int move_result;
 		Uint32 time = *(Uint32 *) sm->data;
 
+		if (pman->pman_ai_flag && g_pman_ai_mode == PMAN_AI_PLANNER) {
+			/* A headless game counts the planner's share of the frame in junctions
+			   rather than microseconds, so that it plays out the same on any machine. */
+			int budget_expansions = game_is_headless() ? PLANNER_FRAME_BUDGET_EXPANSIONS : 0;
+
+			/* The planner gets its share of the frame before pac man moves, since
+			   moving may bring him to the junction it's thinking about. */
+			planner_start_frame(&g_pman_planner, PLANNER_FRAME_BUDGET_US, budget_expansions);
+			planner_think(&g_pman_planner, pman_get_board());
+		}
 		move_result = agent_move(pman, time);
 		agent_pman_frame_advance(pman, time);
 		if (!move_result)
@@ -277,7 +335,7 @@ BEGIN_STATE_MACHINE(agent_pman_state_machine)
 				agent_determine_next_random_move(pman);
 	ON_MSG(GAME_AGENT_MSG_BLOCK_CHANGE)
 		if (pman->pman_ai_flag)
-			agent_determine_next_random_move(pman);
+			agent_pman_ai_determine_next_move(pman);
 		else
 			agent_next_move(pman);
 		state_send_message(BOARD_MSG_PMAN_ON_BLOCK, sm->to, STATE_ID_BOARD, 0, &pman->loc);
@@ -19,8 +19,14 @@
 /* Frames per "direction of movement" animation for pac man. */
 #define PMAN_FRAMES_PER_DIRECTION  10
 
+/* Name of pac man's animation frames on the game's sprite atlas, and the
+   width and height of each frame. */
+#define PMAN_SPRITE_NAME "pman"
+#define PMAN_SPRITE_SIZE (BLOCK_SIZE+6)
+
 /* Base speed for pacman (current level increases this). Measured in
-   pixels per decisecond (i.e. pixels per tenth of a second). */
+   pixels per decisecond (i.e. pixels per tenth of a second).  This is only
+   the default;  the game uses g_tunables.pman_base_speed (see pman_tune.h). */
 #define PMAN_BASE_SPEED 10.0
 
 /* Speed of pacman animation, in frames per decisecond. */
@@ -30,11 +36,23 @@
 #define PMAN_START_BLOCK_X 13
 #define PMAN_START_BLOCK_Y 23
 
-void agent_pman_generate_frames(GameAgent *ga);
+/* The PMAN_AI_* constants say how pac man decides where to go when he's
+   controlled by the CPU. */
+
+/* Picks a random way out of every junction. */
+#define PMAN_AI_RANDOM  0
+/* Uses the time-sliced junction planner (see pman_planner.h). */
+#define PMAN_AI_PLANNER 1
+/* Uses Monte-Carlo rollouts on worker threads (see pman_rollout.h). */
+#define PMAN_AI_ROLLOUT 2
+
+void agent_pman_add_sprites();
 void agent_pman_restart(GameAgent *ga);
 void agent_pman_init(GameAgent *ga);
 void agent_pman_destroy(GameAgent *ga);
 void agent_pman_draw(GameAgent *ga, SDL_Surface *surface, int x_ofs, int y_ofs);
+void agent_pman_set_ai_mode(int mode);
+int agent_pman_get_ai_mode();
 
 void pman_draw_wedge(SDL_Surface *screen, int x1, int y1, int r, int mouth_open, int mouth_inset, int segment);
 
@@ -0,0 +1,529 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+#include "SDL.h"
+
+#include "game.h"
+#include "debug.h"
+#include "fixed.h"
+#include "state.h"
+#include "pman.h"
+#include "pman_score.h"
+#include "pman_agent_pman.h"
+#include "pman_planner.h"
+#include "pman_rollout.h"
+#include "pman_results.h"
+#include "pman_heatmap.h"
+#include "pman_tune.h"
+#include "pman_batch.h"
+#include "workers.h"
+
+/* The columns of a run's results file, one per field of BatchResult. */
+static const ResultsColumn g_batch_columns[BATCH_NUM_COLUMNS] = {
+	{ "game",        RESULTS_TYPE_UINT32, 4 },
+	{ "seed",        RESULTS_TYPE_UINT32, 4 },
+	{ "score",       RESULTS_TYPE_SINT32, 4 },
+	{ "level",       RESULTS_TYPE_SINT32, 4 },
+	{ "duration_ms", RESULTS_TYPE_UINT32, 4 },
+	{ "deaths",      RESULTS_TYPE_SINT32, 4 },
+	{ "flags",       RESULTS_TYPE_UINT32, 4 },
+	{ "config",      RESULTS_TYPE_UINT32, 4 }
+};
+
+/* Names of the files a run's merged heatmap is rendered to, one for each
+   HEATMAP_LAYER_* constant. */
+static const char *g_batch_heatmap_images[HEATMAP_NUM_LAYERS] = {
+	"heatmap-deaths.ppm",
+	"heatmap-kills.ppm",
+	"heatmap-traffic.ppm"
+};
+
+/* Returns the seed of the given game of a run with the given seed. */
+Uint32 batch_game_seed(Uint32 seed, Uint32 game)
+{
+	Uint32 x = seed + game * 0x9e3779b9;
+
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+/* Plays a demo game seeded with the given seed until it's over, and fills in
+   r with what happened (except for r->game).  If heatmap isn't NULL, the game
+   is counted in it too.  The headless game session has to have been started. */
+void batch_play_game(Uint32 seed, BatchResult *r, Heatmap *heatmap)
+{
+	Score *s = pman_get_score();
+	Uint32 t = 0;
+	int lives;
+
+	rand_set_state(seed);
+	pman_demo_init();
+	/* Demo games end at pac man's first death;  give him the lives a player
+	   would have. */
+	s->lives_left = g_tunables.score_starting_lives;
+	if (heatmap) heatmap_set_walls(heatmap, pman_get_board());
+	heatmap_set_current(heatmap);
+	state_process_messages();
+
+	r->seed = seed;
+	r->deaths = 0;
+	r->flags = 0;
+	lives = s->lives_left;
+
+	/* Run frames of the game, as game_run() would. */
+	while (!pman_is_game_over()) {
+		if (t >= BATCH_MAX_GAME_MS) {
+			r->flags |= BATCH_RESULT_TIMED_OUT;
+			break;
+		}
+		pman_model(BATCH_STEP_MS);
+		state_process_messages();
+		state_timer_update(TIMER_ID_GAME, BATCH_STEP_MS);
+		t += BATCH_STEP_MS;
+
+		if (s->lives_left < lives) r->deaths++;
+		lives = s->lives_left;
+	}
+	/* The death that ends the game doesn't cost a life, since there are none
+	   left to lose. */
+	if (pman_is_game_over()) r->deaths++;
+
+	r->score = s->score;
+	r->level = pman_get_level();
+	r->duration = t;
+
+	heatmap_set_current(NULL);
+	if (heatmap) heatmap->games++;
+
+	/* Clear out the finished game the way game_change_state() would. */
+	pman_demo_shutdown();
+	state_shutdown();
+	state_init();
+}
+
+#ifndef WIN32
+
+/* Fills in the header that the given worker's shard should start with. */
+void batch_make_header(BatchShardHeader *h, Uint32 seed, int num_workers, int worker)
+{
+	memset(h, 0, sizeof(*h));
+	h->magic = BATCH_MAGIC;
+	h->result_size = sizeof(BatchResult);
+	h->seed = seed;
+	h->num_workers = (Uint32) num_workers;
+	h->worker = (Uint32) worker;
+	h->ai_mode = (Uint32) agent_pman_get_ai_mode();
+	h->num_configs = (Uint32) tune_num_configs();
+	h->tunables_hash = tune_hash();
+	h->planner_budget = PLANNER_FRAME_BUDGET_EXPANSIONS;
+	h->rollout_budget = ROLLOUT_DECISION_ROLLOUTS;
+	h->rollout_threads = BATCH_ROLLOUT_THREADS;
+}
+
+/* Puts the path of the file with the given name in the run's directory in the
+   given buffer.  The name is a printf() format, which gets the given worker's
+   number for shards' names. */
+void batch_make_path(char *path, size_t size, const char *dir, const char *format, int worker)
+{
+	char name[32];
+
+	sprintf(name, format, worker);
+	if (strlen(dir) + strlen(name) + 2 > size) err("Batch directory path is too long.\n", 1);
+	sprintf(path, "%s/%s", dir, name);
+}
+
+/* Returns the number of workers the run in the given directory was started on,
+   from its first shard, or 0 if it hasn't been started. */
+int batch_find_num_workers(const char *dir)
+{
+	char path[1024];
+	BatchShardHeader h;
+	FILE *f;
+	int num_workers = 0;
+
+	batch_make_path(path, sizeof(path), dir, BATCH_SHARD_NAME, 0);
+	f = fopen(path, "rb");
+	if (!f) return 0;
+	if (fread(&h, sizeof(h), 1, f) == 1 && h.magic == BATCH_MAGIC && h.num_workers > 0)
+		num_workers = (int) h.num_workers;
+	fclose(f);
+	return num_workers;
+}
+
+/* Opens the given worker's shard for appending, creating it if it doesn't
+   exist, and sets *num_results to the number of results already in it.
+   Anything after the last whole result of the right game (e.g. one that was
+   being written during a crash) is cut off. */
+FILE *batch_open_shard(const char *dir, Uint32 seed, int num_workers, int worker, int *num_results)
+{
+	char path[1024];
+	BatchShardHeader h, old;
+	BatchResult r;
+	FILE *f;
+
+	batch_make_path(path, sizeof(path), dir, BATCH_SHARD_NAME, worker);
+	batch_make_header(&h, seed, num_workers, worker);
+	*num_results = 0;
+
+	f = fopen(path, "r+b");
+	if (f && fread(&old, sizeof(old), 1, f) == 1) {
+		if (memcmp(&old, &h, sizeof(h)) != 0) {
+			fprintf(stderr, "%s was written by a run with a different setup.\n", path);
+			exit(1);
+		}
+		while (fread(&r, sizeof(r), 1, f) == 1 && r.game == (Uint32) (worker + *num_results * num_workers))
+			(*num_results)++;
+		fflush(f);
+		if (ftruncate(fileno(f), sizeof(h) + (off_t) *num_results * sizeof(BatchResult)) < 0)
+			err("Couldn't truncate batch shard.\n", 1);
+		fseek(f, 0, SEEK_END);
+		return f;
+	}
+
+	/* A new shard (or one that died before its header was written). */
+	if (f) fclose(f);
+	f = fopen(path, "wb");
+	if (!f || fwrite(&h, sizeof(h), 1, f) != 1 || fflush(f) != 0)
+		err("Couldn't create batch shard.\n", 1);
+	return f;
+}
+
+/* Opens the given worker's heatmap shard, creating it if it doesn't exist, and
+   loads it into h. */
+FILE *batch_open_heatmap(const char *dir, int worker, Heatmap *h)
+{
+	char path[1024];
+	FILE *f;
+
+	batch_make_path(path, sizeof(path), dir, BATCH_HEATMAP_SHARD_NAME, worker);
+	f = fopen(path, "r+b");
+	if (f && heatmap_load(h, f)) return f;
+
+	if (f) fclose(f);
+	heatmap_clear(h);
+	f = fopen(path, "w+b");
+	if (!f || !heatmap_save(h, f)) err("Couldn't create batch heatmap.\n", 1);
+	return f;
+}
+
+/* Plays the given worker's share of a run's games (num_games of them in all,
+   counting every config), appending them to its shard f, which already has
+   the given number of results in it, and counting them in its heatmap shard.
+   Returns nonzero on success. */
+int batch_run_worker(const char *dir, FILE *f, int num_games, int num_workers, Uint32 seed, int worker, int done)
+{
+	Heatmap heatmap;
+	FILE *heatmap_file;
+	BatchResult r;
+	int num_configs = tune_num_configs();
+	int game, ok = 1;
+
+	heatmap_file = batch_open_heatmap(dir, worker, &heatmap);
+
+	game_init_headless();
+	rollout_set_max_threads(BATCH_ROLLOUT_THREADS);
+	for (game = worker + done * num_workers; game < num_games && ok; game += num_workers) {
+		tune_select_config(game % num_configs);
+		batch_play_game(batch_game_seed(seed, (Uint32) (game / num_configs)), &r, &heatmap);
+		r.game = (Uint32) game;
+		r.config = (Uint32) (game % num_configs);
+		/* Flush every result, so that a crash loses at most the game in progress.
+		   The heatmap is saved after the result, so that it never counts a game
+		   that a resumed run will play again. */
+		ok = fwrite(&r, sizeof(r), 1, f) == 1 && fflush(f) == 0 && heatmap_save(&heatmap, heatmap_file);
+	}
+	game_shutdown();
+
+	if (fclose(heatmap_file) != 0) ok = 0;
+	if (fclose(f) != 0) ok = 0;
+	return ok;
+}
+
+/* Merges the first num_games results of the run's shards into its results
+   file, in order of game.  Returns nonzero on success. */
+int batch_merge(const char *dir, int num_games, int num_workers)
+{
+	char path[1024], tmp_path[1024 + 8];
+	FILE **shards;
+	ResultsWriter *out;
+	BatchResult r;
+	Uint32 row[BATCH_NUM_COLUMNS];
+	int i, ok = 1;
+
+	shards = (FILE **) malloc(sizeof(FILE *) * num_workers);
+	if (!shards) err("Couldn't allocate batch shards.\n", 1);
+	for (i = 0; i < num_workers; i++) {
+		batch_make_path(path, sizeof(path), dir, BATCH_SHARD_NAME, i);
+		shards[i] = fopen(path, "rb");
+		if (!shards[i] || fseek(shards[i], sizeof(BatchShardHeader), SEEK_SET) != 0)
+			err("Couldn't open batch shard.\n", 1);
+	}
+
+	/* Results files are only ever appended to, so write a new one from scratch
+	   and put it in place of the old one once it's done. */
+	if (strlen(dir) + strlen(BATCH_RESULTS_NAME) + 2 > sizeof(path)) err("Batch directory path is too long.\n", 1);
+	sprintf(path, "%s/%s", dir, BATCH_RESULTS_NAME);
+	sprintf(tmp_path, "%s.tmp", path);
+	remove(tmp_path);
+	out = results_open(tmp_path, g_batch_columns, BATCH_NUM_COLUMNS);
+	if (!out) err("Couldn't create batch results.\n", 1);
+
+	/* Game i is in shard i % num_workers, so taking a result from each shard in
+	   turn puts them in order. */
+	for (i = 0; i < num_games && ok; i++) {
+		if (fread(&r, sizeof(r), 1, shards[i % num_workers]) != 1 || r.game != (Uint32) i) {
+			ok = 0;
+			break;
+		}
+		row[BATCH_COLUMN_GAME] = r.game;
+		row[BATCH_COLUMN_SEED] = r.seed;
+		row[BATCH_COLUMN_SCORE] = (Uint32) r.score;
+		row[BATCH_COLUMN_LEVEL] = (Uint32) r.level;
+		row[BATCH_COLUMN_DURATION] = r.duration;
+		row[BATCH_COLUMN_DEATHS] = (Uint32) r.deaths;
+		row[BATCH_COLUMN_FLAGS] = r.flags;
+		row[BATCH_COLUMN_CONFIG] = r.config;
+		results_append(out, row);
+	}
+
+	if (!results_close(out)) ok = 0;
+	if (ok) {
+		remove(path);
+		if (rename(tmp_path, path) != 0) ok = 0;
+	}
+	for (i = 0; i < num_workers; i++) fclose(shards[i]);
+	free(shards);
+	return ok;
+}
+
+/* Adds up the run's heatmap shards, and saves the total in its directory,
+   along with a rendering of each layer.  Returns nonzero on success. */
+int batch_merge_heatmaps(const char *dir, int num_workers)
+{
+	char path[1024];
+	Heatmap total, h;
+	FILE *f;
+	int i, ok = 1;
+
+	heatmap_clear(&total);
+	for (i = 0; i < num_workers && ok; i++) {
+		batch_make_path(path, sizeof(path), dir, BATCH_HEATMAP_SHARD_NAME, i);
+		f = fopen(path, "rb");
+		ok = f && heatmap_load(&h, f);
+		if (f) fclose(f);
+		if (ok) heatmap_add(&total, &h);
+	}
+	if (!ok) return 0;
+
+	batch_make_path(path, sizeof(path), dir, BATCH_HEATMAP_NAME, 0);
+	f = fopen(path, "wb");
+	ok = f && heatmap_save(&total, f);
+	if (f && fclose(f) != 0) ok = 0;
+
+	for (i = 0; i < HEATMAP_NUM_LAYERS && ok; i++) {
+		batch_make_path(path, sizeof(path), dir, g_batch_heatmap_images[i], 0);
+		ok = heatmap_write_ppm(&total, i, path);
+	}
+	return ok;
+}
+
+/* Lists the configs of the sweep in the run's directory, one "NUMBER
+   DESCRIPTION" line for each.  Returns nonzero on success. */
+int batch_write_configs(const char *dir)
+{
+	char path[1024], desc[1024];
+	FILE *f;
+	int i, ok;
+
+	batch_make_path(path, sizeof(path), dir, BATCH_CONFIGS_NAME, 0);
+	f = fopen(path, "w");
+	if (!f) return 0;
+	for (i = 0; i < tune_num_configs(); i++) {
+		tune_describe_config(i, desc, sizeof(desc));
+		fprintf(f, "%d %s\n", i, desc);
+	}
+	ok = !ferror(f);
+	if (fclose(f) != 0) ok = 0;
+	return ok;
+}
+
+/* Plays a run of num_games games (under each config of the sweep) with the
+   given seed, on num_workers worker processes (or one per processor if it's
+   0), keeping its shards and results in the given directory.  Resumes the run
+   if the directory already has shards in it.  Returns nonzero if every game
+   was played and merged. */
+int batch_run(const char *dir, int num_games, int num_workers, Uint32 seed)
+{
+	pid_t *pids;
+	FILE **shards;
+	int *done;
+	int i, status, failed = 0;
+	int old_num_workers;
+
+	/* Every game's number, and the number after each worker's last game, has
+	   to fit in an int. */
+	if (num_games > INT_MAX / tune_num_configs()) err("Too many games to play under every config.\n", 1);
+	num_games *= tune_num_configs();
+
+	/* Which worker plays each game depends on how many workers there are, so
+	   a run that's resumed has to keep the number it was started on. */
+	old_num_workers = batch_find_num_workers(dir);
+	if (old_num_workers > 0) {
+		if (num_workers > 0 && num_workers != old_num_workers)
+			fprintf(stderr, "Carrying on a run started on %d workers;  ignoring -workers.\n", old_num_workers);
+		num_workers = old_num_workers;
+	} else {
+		if (num_workers <= 0) num_workers = workers_count_cpus();
+		if (num_workers > num_games) num_workers = num_games > 0 ? num_games : 1;
+	}
+	if (num_workers > INT_MAX - num_games) err("Too many games to play under every config.\n", 1);
+
+	if (mkdir(dir, 0777) < 0 && errno != EEXIST) err("Couldn't create batch directory.\n", 1);
+
+	pids = (pid_t *) malloc(sizeof(pid_t) * num_workers);
+	shards = (FILE **) malloc(sizeof(FILE *) * num_workers);
+	done = (int *) malloc(sizeof(int) * num_workers);
+	if (!pids || !shards || !done) err("Couldn't allocate batch workers.\n", 1);
+
+	/* Open (and check) every shard before starting any workers, so that a run
+	   that can't be resumed fails straight away. */
+	for (i = 0; i < num_workers; i++) {
+		shards[i] = batch_open_shard(dir, seed, num_workers, i, &done[i]);
+	}
+
+	/* Make sure nothing buffered gets written twice by the workers. */
+	fflush(NULL);
+
+	for (i = 0; i < num_workers; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) err("Couldn't start batch worker.\n", 1);
+		if (pids[i] == 0) {
+			_exit(batch_run_worker(dir, shards[i], num_games, num_workers, seed, i, done[i]) ? 0 : 1);
+		}
+		fclose(shards[i]);
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "Batch worker %d failed;  run again with the same arguments to resume.\n", i);
+			failed = 1;
+		}
+	}
+	free(pids);
+	free(shards);
+	free(done);
+	if (failed) return 0;
+
+	if (!batch_merge(dir, num_games, num_workers)) {
+		err("Couldn't merge batch shards.\n", 0);
+		return 0;
+	}
+	if (!batch_merge_heatmaps(dir, num_workers)) {
+		err("Couldn't merge batch heatmaps.\n", 0);
+		return 0;
+	}
+	if (!batch_write_configs(dir)) {
+		err("Couldn't write batch configs.\n", 0);
+		return 0;
+	}
+	printf("%d games on %d workers, merged into %s/%s\n", num_games, num_workers, dir, BATCH_RESULTS_NAME);
+	return 1;
+}
+
+#else
+
+int batch_run(const char *dir, int num_games, int num_workers, Uint32 seed)
+{
+	err("Batch runs aren't supported on this platform.\n", 1);
+	return 0;
+}
+
+#endif
+
+/* Prints a summary of the results file of a run:  its scores, the levels its
+   games ended on, and so on.  Returns nonzero on success. */
+int batch_print_stats(const char *path)
+{
+	static const double percents[BATCH_NUM_PERCENTILES] = { 10, 50, 90, 99 };
+	double scores[BATCH_NUM_PERCENTILES];
+	Uint32 levels[BATCH_STATS_LEVELS];
+	ResultsStats score, duration, deaths, timed_out, config;
+	ResultsStats *config_scores;
+	ResultsFile *rf;
+	int i, last, num_configs;
+
+	rf = results_map(path);
+	if (!rf) {
+		err("Couldn't read batch results.\n", 0);
+		return 0;
+	}
+	if (rf->num_columns != BATCH_NUM_COLUMNS ||
+		memcmp(rf->columns, g_batch_columns, sizeof(g_batch_columns)) != 0) {
+		err("Not a batch results file.\n", 0);
+		results_unmap(rf);
+		return 0;
+	}
+
+	results_column_stats(rf, BATCH_COLUMN_SCORE, &score);
+	results_column_stats(rf, BATCH_COLUMN_DURATION, &duration);
+	results_column_stats(rf, BATCH_COLUMN_DEATHS, &deaths);
+	/* BATCH_RESULT_TIMED_OUT is the only flag, so the flags add up to the
+	   number of games that timed out. */
+	results_column_stats(rf, BATCH_COLUMN_FLAGS, &timed_out);
+	results_column_percentiles(rf, BATCH_COLUMN_SCORE, percents, scores, BATCH_NUM_PERCENTILES);
+	results_column_histogram(rf, BATCH_COLUMN_LEVEL, levels, BATCH_STATS_LEVELS);
+
+	printf("games:       %u\n", rf->num_rows);
+	printf("score:       mean %.1f, min %.0f, max %.0f\n", score.mean, score.min, score.max);
+	printf("percentiles:");
+	for (i = 0; i < BATCH_NUM_PERCENTILES; i++) {
+		printf(" p%.0f %.0f%s", percents[i], scores[i], i + 1 < BATCH_NUM_PERCENTILES ? "," : "\n");
+	}
+	printf("duration:    mean %.1f s\n", duration.mean / 1000);
+	printf("deaths:      mean %.2f\n", deaths.mean);
+	printf("timed out:   %.0f\n", timed_out.sum);
+
+	printf("final level:\n");
+	for (last = BATCH_STATS_LEVELS - 1; last > 0 && levels[last] == 0; last--) { }
+	for (i = 0; i <= last; i++) {
+		printf("  %2d%s %10u  %5.1f%%\n", i + 1, i == BATCH_STATS_LEVELS - 1 ? "+" : " ",
+			levels[i], rf->num_rows ? 100.0 * levels[i] / rf->num_rows : 0.0);
+	}
+
+	/* Break the scores down by config, if there was a sweep (see configs.txt in
+	   the run's directory for what each one is). */
+	results_column_stats(rf, BATCH_COLUMN_CONFIG, &config);
+	num_configs = (int) config.max + 1;
+	if (num_configs > 1) {
+		if (num_configs > BATCH_STATS_CONFIGS) num_configs = BATCH_STATS_CONFIGS;
+		config_scores = (ResultsStats *) malloc(sizeof(ResultsStats) * num_configs);
+		if (!config_scores) err("Couldn't allocate config stats.\n", 1);
+		results_column_group_stats(rf, BATCH_COLUMN_SCORE, BATCH_COLUMN_CONFIG, config_scores, num_configs);
+
+		printf("score by config:\n");
+		for (i = 0; i < num_configs; i++) {
+			printf("  %4d %10u games  mean %.1f, min %.0f, max %.0f\n", i, config_scores[i].count,
+				config_scores[i].mean, config_scores[i].min, config_scores[i].max);
+		}
+		free(config_scores);
+	}
+
+	results_unmap(rf);
+	return 1;
+}
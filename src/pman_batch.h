@@ -0,0 +1,140 @@
+#ifndef INCLUDE_PMAN_BATCH
+#define INCLUDE_PMAN_BATCH
+
+/* pman_batch.h
+
+   Batch runs of headless demo games, spread over several worker processes
+   (POSIX systems only).
+
+   A run plays a number of games, each one a demo game (pac man steered by the
+   AI picked with -ai) seeded from the run's seed and the game's index, played
+   until pac man runs out of lives.  The AIs get fixed budgets in a headless
+   game (see planner_start_frame() and rollout_choose_move()), so a game plays
+   out the same from the same seed under the same tunables, whichever worker
+   plays it and however busy the machine is.
+
+   If the tunables (see pman_tune.h) are being swept, the run plays that many
+   games under each config of the sweep:  game i is played under config
+   i % configs, with the same seed as the other games from i - i % configs up,
+   so that the configs are compared on the same games, with nothing but the
+   config to tell their scores apart.
+
+   The driver forks one worker per processor (or as many as asked for), and
+   worker w plays games w, w + workers, w + 2*workers, ..., appending a
+   BatchResult for each one to its own shard file in the run's directory as soon
+   as the game is over.  Once every worker is done, the driver merges the shards
+   into a columnar results file (see pman_results.h), in order of game, with a
+   column for each field of BatchResult.  batch_print_stats() sums one up.  Each worker also keeps a
+   heatmap (see pman_heatmap.h) of its games in a shard of its own, which the
+   driver adds up and renders as a PPM image for each of its layers.
+
+   Since a shard only ever has whole games appended to it, a run that crashed
+   or was killed can be resumed by starting it again with the same directory:
+   each worker skips the games its shard already has (dropping any half-written
+   result at its end) and carries on from there.  A run can also be extended by
+   resuming it with more games.  Since the games are dealt out by worker, a
+   resumed run always keeps the number of workers it was started with, on
+   whatever machine it's resumed on.
+*/
+
+#include "SDL.h"
+
+#include "pman_heatmap.h"
+
+/* Number of ms of game time that each frame of a batch game covers. */
+#define BATCH_STEP_MS 16
+
+/* Longest a batch game is played for, in ms of game time, in case the AI gets
+   pac man stuck somewhere the ghosts never go. */
+#define BATCH_MAX_GAME_MS (4*60*60*1000)
+
+/* Number of threads each worker's rollout AI plays on.  The run already has a
+   worker per processor. */
+#define BATCH_ROLLOUT_THREADS 1
+
+/* Number of games a run plays if it isn't told otherwise. */
+#define BATCH_DEFAULT_GAMES 1000
+
+/* Value of BatchShardHeader.magic. */
+#define BATCH_MAGIC 0x48534250
+
+/* Names of the files in a run's directory. */
+#define BATCH_SHARD_NAME         "shard-%03d.bin"
+#define BATCH_HEATMAP_SHARD_NAME "heatmap-%03d.bin"
+#define BATCH_RESULTS_NAME       "results.col"
+#define BATCH_HEATMAP_NAME       "heatmap.bin"
+#define BATCH_CONFIGS_NAME       "configs.txt"
+
+/* The BATCH_RESULT_* constants go in BatchResult.flags. */
+
+/* The game was stopped after BATCH_MAX_GAME_MS, with lives still left. */
+#define BATCH_RESULT_TIMED_OUT 1
+
+/* The BATCH_COLUMN_* constants are the columns of a run's results file. */
+#define BATCH_COLUMN_GAME     0
+#define BATCH_COLUMN_SEED     1
+#define BATCH_COLUMN_SCORE    2
+#define BATCH_COLUMN_LEVEL    3
+#define BATCH_COLUMN_DURATION 4
+#define BATCH_COLUMN_DEATHS   5
+#define BATCH_COLUMN_FLAGS    6
+#define BATCH_COLUMN_CONFIG   7
+#define BATCH_NUM_COLUMNS     8
+
+/* Number of score percentiles batch_print_stats() shows, and the number of
+   levels it counts separately (games that end on later ones are counted with
+   the last). */
+#define BATCH_NUM_PERCENTILES 4
+#define BATCH_STATS_LEVELS    32
+
+/* Most configs whose scores batch_print_stats() shows separately. */
+#define BATCH_STATS_CONFIGS 1024
+
+/* How a run was set up.  Every shard starts with one, and resuming a run with
+   a different setup is an error. */
+typedef struct BatchShardHeader {
+	/* Always BATCH_MAGIC. */
+	Uint32 magic;
+	/* Size of each BatchResult that follows. */
+	Uint32 result_size;
+	/* The run's seed, its number of workers, and the worker that wrote the shard. */
+	Uint32 seed;
+	Uint32 num_workers;
+	Uint32 worker;
+	/* PMAN_AI_* constant that steered pac man. */
+	Uint32 ai_mode;
+	/* Number of configs in the sweep, and tune_hash() of the tunables. */
+	Uint32 num_configs;
+	Uint32 tunables_hash;
+	/* The AIs' budgets, which are fixed in a headless game:  the junctions the
+	   planner expands each frame, the rollouts each rollout thread plays for each
+	   decision, and the number of rollout threads. */
+	Uint32 planner_budget;
+	Uint32 rollout_budget;
+	Uint32 rollout_threads;
+} BatchShardHeader;
+
+/* What happened in one game. */
+typedef struct BatchResult {
+	/* Index of the game in the run, and the seed its random number generator
+	   was seeded with. */
+	Uint32 game;
+	Uint32 seed;
+	Sint32 score;
+	/* Level the game ended on (starting at 0). */
+	Sint32 level;
+	/* Length of the game, in ms of game time. */
+	Uint32 duration;
+	/* Number of times pac man died. */
+	Sint32 deaths;
+	/* BATCH_RESULT_* constants. */
+	Uint32 flags;
+	/* Config of the sweep the game was played under. */
+	Uint32 config;
+} BatchResult;
+
+void batch_play_game(Uint32 seed, BatchResult *r, Heatmap *heatmap);
+int batch_run(const char *dir, int num_games, int num_workers, Uint32 seed);
+int batch_print_stats(const char *path);
+
+#endif
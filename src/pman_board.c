@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <string.h>
 
 #include "SDL.h"
 
@@ -9,6 +10,7 @@
 #include "state.h"
 #include "debug.h"
 #include "fixed.h"
+#include "drawing.h"
 #include "pman.h"
 #include "pman_board.h"
 #include "pman_score.h"
@@ -16,7 +18,32 @@
 #include "pman_agent_ghost.h"
 #include "pman_agent_pman.h"
 #include "pman_agent_fruit.h"
+#include "pman_obs.h"
 #include "menu.h"
+#include "compositor.h"
+
+/* The level data shared by every board in the process, and the number of boards
+   using it (it's loaded by the first board_init() and freed by the last
+   board_destroy()). */
+static BoardLevel g_board_level;
+static int g_board_level_users = 0;
+
+/* Body color of each ghost, in RGB. */
+static const Uint8 g_board_ghost_colors[4][3] = {
+	{ 255, 0, 255 }, { 0, 0, 255 }, { 0, 255, 0 }, { 255, 0, 0 }
+};
+
+const int board_dir_dx[4] = { 0, 0, -1, 1 };
+const int board_dir_dy[4] = { -1, 1, 0, 0 };
+const int board_dir_reverse[4] = { DIRECTION_DOWN, DIRECTION_UP, DIRECTION_RIGHT, DIRECTION_LEFT };
+
+/* Wraps the given x-coordinate (in blocks) around the tunnel. */
+int board_wrap_x(int x)
+{
+	if (x < 0) return x + BOARD_WIDTH;
+	if (x >= BOARD_WIDTH) return x - BOARD_WIDTH;
+	return x;
+}
 
 /* At the given block on the board, returns the cardinal direction (as
    a fixed vector) in which to go to get back to the asylum. */
@@ -27,11 +54,11 @@ FixedVector board_get_asylum_directions_at_block(Board *b, int x, int y)
 	if (x < 0 || x >= BOARD_WIDTH) {
 		return fixed_vector_left;
 	} else {
-		return b->goto_asylum_directions[x][y];
+		return b->level->goto_asylum_directions[x][y];
 	}
 }
 
-int board_generate_asylum_directions_helper(Board *b, int temp_board[BOARD_WIDTH][BOARD_HEIGHT], int curr_iter, int x, int y, const FixedVector *direction)
+int board_generate_asylum_directions_helper(BoardLevel *l, int temp_board[BOARD_WIDTH][BOARD_HEIGHT], int curr_iter, int x, int y, const FixedVector *direction)
 {
 	int next_x = x + FIXED_GET_INT(direction->x);
 	int next_y = y + FIXED_GET_INT(direction->y);
@@ -39,10 +66,10 @@ int board_generate_asylum_directions_helper(Board *b, int temp_board[BOARD_WIDTH
 	if (next_x < 0 || next_x >= BOARD_WIDTH || next_y < 0 || next_y >= BOARD_HEIGHT)
 		return 0;
 
-	if ( (board_get_block(b, next_x, next_y) != BLOCK_WALL ) &&
+	if ( (l->blocks[next_x][next_y] != BLOCK_WALL ) &&
 		 (temp_board[next_x][next_y] == 0) ) {
 			 temp_board[next_x][next_y] = curr_iter;
-			 b->goto_asylum_directions[next_x][next_y] = fixed_vector_reverse(direction);
+			 l->goto_asylum_directions[next_x][next_y] = fixed_vector_reverse(direction);
 			 return 1;
 	}
 	return 0;
@@ -51,7 +78,7 @@ int board_generate_asylum_directions_helper(Board *b, int temp_board[BOARD_WIDTH
 /* Generates the array that gives information about how to get back to the
    asylum from any given block on the board.  The directions are calculated
    using Moore's Breadth-First Search algorithm. */
-void board_generate_asylum_directions(Board *b)
+void board_generate_asylum_directions(BoardLevel *l)
 {
 	int temp_board[BOARD_WIDTH][BOARD_HEIGHT];
 	int curr_iter;
@@ -60,7 +87,7 @@ void board_generate_asylum_directions(Board *b)
 	for (i = 0; i < BOARD_WIDTH; i++) {
 		for (j = 0; j < BOARD_HEIGHT; j++) {
 			temp_board[i][j] = 0;
-			b->goto_asylum_directions[i][j] = fixed_vector_zero;
+			l->goto_asylum_directions[i][j] = fixed_vector_zero;
 		}
 	}
 	temp_board[BLOCK_ASYLUM_CENTER_X][BLOCK_ASYLUM_ENTER_Y] = 1;
@@ -76,10 +103,10 @@ void board_generate_asylum_directions(Board *b)
 			for (i = 0; i < BOARD_WIDTH; i++) {
 				if (temp_board[i][j] == curr_iter) {
 						blocks_found += 
-							board_generate_asylum_directions_helper(b, temp_board, curr_iter+1, i, j, &fixed_vector_left) +
-							board_generate_asylum_directions_helper(b, temp_board, curr_iter+1, i, j, &fixed_vector_right) +
-							board_generate_asylum_directions_helper(b, temp_board, curr_iter+1, i, j, &fixed_vector_up) +
-							board_generate_asylum_directions_helper(b, temp_board, curr_iter+1, i, j, &fixed_vector_down);
+							board_generate_asylum_directions_helper(l, temp_board, curr_iter+1, i, j, &fixed_vector_left) +
+							board_generate_asylum_directions_helper(l, temp_board, curr_iter+1, i, j, &fixed_vector_right) +
+							board_generate_asylum_directions_helper(l, temp_board, curr_iter+1, i, j, &fixed_vector_up) +
+							board_generate_asylum_directions_helper(l, temp_board, curr_iter+1, i, j, &fixed_vector_down);
 				}
 			}
 		}
@@ -88,20 +115,29 @@ void board_generate_asylum_directions(Board *b)
 	}
 }
 
+/* Takes the nib at the given block coordinates off the board, and marks its block
+   as dirty on the nib layer, without any of the consequences of eating it. */
+void board_erase_nib(Board *b, int x, int y)
+{
+	SDL_Rect r;
+
+	BOARD_CLEAR_NIB(b, x, y);
+	r.x = (Sint16) (b->draw_rect.x + x * BLOCK_SIZE);
+	r.y = (Sint16) (b->draw_rect.y + y * BLOCK_SIZE);
+	r.w = BLOCK_SIZE;
+	r.h = BLOCK_SIZE;
+	game_invalidate_layer(COMPOSITOR_LAYER_NIBS, &r);
+}
+
 /* Destroys the nibblet/nibbloon on the given board at the given block coordinates,
    if there's actually a nib there. */
 void board_destroy_nib(Board *b, int x, int y)
 {
 	if (board_get_block(b, x, y) == BLOCK_NIBBLET || board_get_block(b, x, y) == BLOCK_NIBBLOON) {
-		SDL_Rect r;
 		int block_type_eaten = board_get_block(b, x, y);
 
-		b->blocks[x][y] = BLOCK_NOTHING;
-		r.x = (Sint16) (x * BLOCK_SIZE);
-		r.y = (Sint16) (y * BLOCK_SIZE);
-		r.w = BLOCK_SIZE;
-		r.h = BLOCK_SIZE;
-		SDL_FillRect(b->background, &r, 0);
+		board_erase_nib(b, x, y);
+		obs_clear_nib(b, x, y);
 		b->nibs_left--;
 		if (block_type_eaten == BLOCK_NIBBLOON) {
 			// send message to ghosts, change music, etc...
@@ -118,83 +154,62 @@ void board_destroy_nib(Board *b, int x, int y)
 /* Returns the block ID of the block at the given block coordinates. */
 int board_get_block(Board *b, int x, int y)
 {
+	int block;
+
 	//assert(x >= 0); assert(y >= 0);
 	//assert(x < BOARD_WIDTH); assert(y < BOARD_HEIGHT);
 	if (x < 0 || y < 0 || x >= BOARD_WIDTH || y >= BOARD_HEIGHT) {
 		return BLOCK_NOTHING;
 	}
-	return b->blocks[x][y];
+	block = b->level->blocks[x][y];
+	if ((block == BLOCK_NIBBLET || block == BLOCK_NIBBLOON) && !BOARD_HAS_NIB(b, x, y))
+		return BLOCK_NOTHING;
+	return block;
 }
 
-/* Loads the board's block data (e.g., walls, nibs, pathways) from a
-   board data file (which is a BMP image). */
+/* Puts all of the level's nibs back on the board. */
 void board_load_data(Board *b)
 {
-	SDL_Surface *s;
-	int i,j;
-	char *pixels;
-
-	s = game_load_bmp(BOARD_FILE_NAME);
-
-	assert(s != NULL);
-	assert(s->w == BOARD_WIDTH);
-	assert(s->h == BOARD_HEIGHT);
-	assert(s->pitch == BOARD_WIDTH);
-
-	SDL_LockSurface(s);
-	pixels = (char *)s->pixels;
-
-	b->nibs_left = 0;
-
-	for (j = 0; j < BOARD_HEIGHT; j++) {
-		for (i = 0; i < BOARD_WIDTH; i++) {
-			b->blocks[i][j] = pixels[j * BOARD_WIDTH + i];
-			if (b->blocks[i][j] == BLOCK_NIBBLET ||
-				b->blocks[i][j] == BLOCK_NIBBLOON)
-				b->nibs_left++;
-		}
-	}
-	SDL_UnlockSurface(s);
-	SDL_FreeSurface(s);
-
-	board_generate_asylum_directions(b);
+	memcpy(b->nibs, b->level->nibs, sizeof(b->nibs));
+	b->nibs_left = b->level->num_nibs;
+	obs_refresh_blocks(b);
 }
 
 /* Helper function for the board_redraw_walls() function that returns whether
    the given block coordinates contain a wall, an asylum door, or asylum space.
    Used for figuring out what wall tile to use. */
-int board_redraw_walls_is_block_wall(Board *b, int x, int y)
+int board_redraw_walls_is_block_wall(BoardLevel *l, int x, int y)
 {
 	if (x < 0 || y < 0 || x >= BOARD_WIDTH || y >= BOARD_HEIGHT)
 		return 1;
-	if (b->blocks[x][y] == BLOCK_WALL || b->blocks[x][y] == BLOCK_ASYLUM_DOOR ||
-		b->blocks[x][y] == BLOCK_ASYLUM_SPACE) return 1;
+	if (l->blocks[x][y] == BLOCK_WALL || l->blocks[x][y] == BLOCK_ASYLUM_DOOR ||
+		l->blocks[x][y] == BLOCK_ASYLUM_SPACE) return 1;
 	return 0;
 }
 
-/* Helper function for board_redraw_walls().  Given the given board and block coordinates,
+/* Helper function for board_redraw_walls().  Given the given level and block coordinates,
    determines the right kind of wall tile to use and blits it to the location. */
-void board_redraw_walls_draw_wall(Board *b, SDL_Rect *dst_rect, int x, int y)
+void board_redraw_walls_draw_wall(BoardLevel *l, SDL_Rect *dst_rect, int x, int y)
 {
 	SDL_Surface *surface;
 	SDL_Rect src_rect;
 
-	surface = b->background;
+	surface = l->walls;
 	src_rect.h = BLOCK_SIZE;
 	src_rect.w = BLOCK_SIZE;
 
 	src_rect.x = src_rect.y = -1;
 
-	if (b->blocks[x][y] == BLOCK_ASYLUM_DOOR) {
+	if (l->blocks[x][y] == BLOCK_ASYLUM_DOOR) {
 		src_rect.x = 0;
 		src_rect.y = 3;
-	} else if (!board_redraw_walls_is_block_wall(b, x, y-1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x, y-1)) {
 		// if the spot to the top is blank
-		if (!board_redraw_walls_is_block_wall(b, x-1, y)) {
+		if (!board_redraw_walls_is_block_wall(l, x-1, y)) {
 			// top-left wall
 			src_rect.x = 3;
 			src_rect.y = 1;
-		} else if (!board_redraw_walls_is_block_wall(b, x+1, y)) {
+		} else if (!board_redraw_walls_is_block_wall(l, x+1, y)) {
 			// top-right wall
 			src_rect.x = 2;
 			src_rect.y = 1;
@@ -203,13 +218,13 @@ void board_redraw_walls_draw_wall(Board *b, SDL_Rect *dst_rect, int x, int y)
 			src_rect.x = 3;
 			src_rect.y = 0;			
 		}
-	} else if (!board_redraw_walls_is_block_wall(b, x, y+1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x, y+1)) {
 		// if the spot to the bottom is blank
-		if (!board_redraw_walls_is_block_wall(b, x-1, y)) {
+		if (!board_redraw_walls_is_block_wall(l, x-1, y)) {
 			// bottom-left wall
 			src_rect.x = 1;
 			src_rect.y = 1;
-		} else if (!board_redraw_walls_is_block_wall(b, x+1, y)) {
+		} else if (!board_redraw_walls_is_block_wall(l, x+1, y)) {
 			// bottom-right wall
 			src_rect.x = 0;
 			src_rect.y = 1;
@@ -218,27 +233,27 @@ void board_redraw_walls_draw_wall(Board *b, SDL_Rect *dst_rect, int x, int y)
 			src_rect.x = 2;
 			src_rect.y = 0;			
 		}
-	} else if (!board_redraw_walls_is_block_wall(b, x-1, y)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x-1, y)) {
 		// left wall
 		src_rect.x = 1;
 		src_rect.y = 0;
-	} else if (!board_redraw_walls_is_block_wall(b, x+1, y)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x+1, y)) {
 		// right wall
 		src_rect.x = 0;
 		src_rect.y = 0;
-	} else if (!board_redraw_walls_is_block_wall(b, x+1, y+1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x+1, y+1)) {
 		// juncture w/ space at bottom-right
 		src_rect.x = 2;
 		src_rect.y = 2;
-	} else if (!board_redraw_walls_is_block_wall(b, x+1, y-1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x+1, y-1)) {
 		// juncture w/ space at top-right
 		src_rect.x = 1;
 		src_rect.y = 2;
-	} else if (!board_redraw_walls_is_block_wall(b, x-1, y-1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x-1, y-1)) {
 		// juncture w/ space at top-left
 		src_rect.x = 0;
 		src_rect.y = 2;
-	} else if (!board_redraw_walls_is_block_wall(b, x-1, y+1)) {
+	} else if (!board_redraw_walls_is_block_wall(l, x-1, y+1)) {
 		// juncture w/ space at bottom-left
 		src_rect.x = 3;
 		src_rect.y = 2;
@@ -246,19 +261,24 @@ void board_redraw_walls_draw_wall(Board *b, SDL_Rect *dst_rect, int x, int y)
 
 	if (src_rect.x == -1) return;
 
-	src_rect.x *= BLOCK_SIZE;
-	src_rect.y *= BLOCK_SIZE;
+	src_rect.x = (Sint16) (l->walls_bitmap_rect.x + src_rect.x * BLOCK_SIZE);
+	src_rect.y = (Sint16) (l->walls_bitmap_rect.y + src_rect.y * BLOCK_SIZE);
 
-	SDL_BlitSurface(b->walls_bitmap, &src_rect, surface, dst_rect);
+	game_blit_sprite(&src_rect, surface, dst_rect);
 }
 
-/* Blits the board's walls to the board's background.  This includes asylum doors. */
-void board_redraw_walls(Board *b)
+/* Blits the level's walls to the level's wall layer, creating it if needed.  This
+   includes asylum doors. */
+void board_redraw_walls(BoardLevel *l)
 {
 	int i;
 	int j;
 	SDL_Rect r;
 
+	if (l->walls == NULL)
+		l->walls = game_create_bitmap(0, BOARD_PIXEL_WIDTH, BOARD_PIXEL_HEIGHT);
+	SDL_FillRect(l->walls, NULL, 0);
+
 	r.w = BLOCK_SIZE;
 	r.h = BLOCK_SIZE;
 
@@ -266,48 +286,61 @@ void board_redraw_walls(Board *b)
 		r.y = (Sint16) (BLOCK_SIZE * j);
 		for (i = 0; i < BOARD_WIDTH; i++) {
 			r.x = (Sint16) (BLOCK_SIZE * i);
-			if (b->blocks[i][j] == BLOCK_WALL ||
-				b->blocks[i][j] == BLOCK_ASYLUM_DOOR)
-				board_redraw_walls_draw_wall(b, &r, i, j);
+			if (l->blocks[i][j] == BLOCK_WALL ||
+				l->blocks[i][j] == BLOCK_ASYLUM_DOOR)
+				board_redraw_walls_draw_wall(l, &r, i, j);
 		}
 	}
 }
 
-/* Blits the board's nibblets and nibbloons to the board's background. */
-void board_redraw_nibbles(Board *b)
+/* Loads the level's block data (e.g., walls, nibs, pathways) from a
+   board data file (which is a BMP image), and the wall tiles, and draws the
+   walls (unless the game is headless, and has no tiles to draw them with). */
+void board_load_level(BoardLevel *l)
 {
-	int i;
-	int j;
-	SDL_Rect r;
-	SDL_Surface *surface = b->background;
-	
+	SDL_Surface *s;
+	int i,j;
+	char *pixels;
+
+	s = game_load_bmp(BOARD_FILE_NAME);
+
+	assert(s != NULL);
+	assert(s->w == BOARD_WIDTH);
+	assert(s->h == BOARD_HEIGHT);
+	assert(s->pitch == BOARD_WIDTH);
+
+	SDL_LockSurface(s);
+	pixels = (char *)s->pixels;
+
+	l->num_nibs = 0;
+	memset(l->nibs, 0, sizeof(l->nibs));
+
 	for (j = 0; j < BOARD_HEIGHT; j++) {
 		for (i = 0; i < BOARD_WIDTH; i++) {
-			r.y = (Sint16) (BLOCK_SIZE * j);
-			r.x = (Sint16) (BLOCK_SIZE * i);
-			if (b->blocks[i][j] == BLOCK_NIBBLET) {
-				r.x += (BLOCK_SIZE / 2) - 1;				
-				r.y += (BLOCK_SIZE / 2) - 1;
-				r.w = 2;
-				r.h = 2;
-				SDL_FillRect(surface, &r, game_map_rgb(255, 255, 0));
-			}
-			if (b->blocks[i][j] == BLOCK_NIBBLOON) {
-				r.x += (BLOCK_SIZE / 2) - 2;
-				r.y += (BLOCK_SIZE / 2) - 2;
-				r.w = 4;
-				r.h = 4;
-				SDL_FillRect(surface, &r, game_map_rgb(255,255,0));
+			l->blocks[i][j] = (Uint8) pixels[j * BOARD_WIDTH + i];
+			if (l->blocks[i][j] == BLOCK_NIBBLET ||
+				l->blocks[i][j] == BLOCK_NIBBLOON) {
+				l->nibs[BOARD_NIB_WORD(i, j)] |= BOARD_NIB_MASK(i, j);
+				l->num_nibs++;
 			}
 		}
 	}
+	SDL_UnlockSurface(s);
+	SDL_FreeSurface(s);
+
+	board_generate_asylum_directions(l);
+
+	l->walls_bitmap = game_get_sprite(BOARD_WALLS_FILE_NAME, &l->walls_bitmap_rect);
+	l->walls = NULL;
+	if (l->walls_bitmap)
+		board_redraw_walls(l);
 }
 
-/* Generates the board's background surface (the walls and nibbleats/nibbloons). */
-void board_generate_background(Board *b)
+/* Frees the level's surfaces.  (The wall tiles belong to the game's sprite
+   atlas.) */
+void board_free_level(BoardLevel *l)
 {
-	board_redraw_walls(b);
-	board_redraw_nibbles(b);
+	if (l->walls) SDL_FreeSurface(l->walls);
 }
 
 /* Restarts the game board.  Should be called whenever a new level is started. */
@@ -315,7 +348,7 @@ void board_restart(Board *b, int reload_board_data)
 {
 	b->is_visible = 1;
 	if (reload_board_data) board_load_data(b);
-	board_generate_background(b);
+	game_invalidate_layer(COMPOSITOR_LAYER_NIBS, &b->draw_rect);
 	state_construct(&b->state, STATE_ID_BOARD, STATE_ID_BOARD, b, TIMER_ID_GAME);
 	agent_pman_restart(&b->pman);
 
@@ -328,23 +361,44 @@ void board_restart(Board *b, int reload_board_data)
 	agent_fruit_restart(&b->fruit);
 }
 
+/* Adds the graphics of the board and everything on it (the wall tiles, pac
+   man, the ghosts and the fruit) to the game's sprite atlas.  Should be called
+   once, before the atlas is built. */
+void board_add_sprites()
+{
+	Uint32 ghost_colors[4];
+	int i;
+
+	game_add_sprite(BOARD_WALLS_FILE_NAME, game_load_bmp(BOARD_WALLS_FILE_NAME));
+
+	for (i = 0; i < 4; i++)
+		ghost_colors[i] = game_map_rgb(g_board_ghost_colors[i][0], g_board_ghost_colors[i][1], g_board_ghost_colors[i][2]);
+	agent_ghost_add_sprites(ghost_colors, 4);
+
+	agent_pman_add_sprites();
+	agent_fruit_add_sprites();
+}
+
 /* Initializes the game board by dynamically allocating memory, etc.  Should be
    used only once per game session, and always countered with board_destroy(). */
 void board_init(Board *b, int x_ofs, int y_ofs)
 {
+	int i;
+
 	b->draw_rect.h = BOARD_PIXEL_HEIGHT;
 	b->draw_rect.w = BOARD_PIXEL_WIDTH;
 	b->draw_rect.x = (Uint16) x_ofs;
 	b->draw_rect.y = (Uint16) y_ofs;
+	b->obs_planes = NULL;
+
+	if (g_board_level_users++ == 0)
+		board_load_level(&g_board_level);
+	b->level = &g_board_level;
 
-	b->background = game_create_bitmap(0, BOARD_WIDTH*BLOCK_SIZE, BOARD_HEIGHT*BLOCK_SIZE);
-	b->walls_bitmap = game_load_bmp(BOARD_WALLS_FILE_NAME);
 	agent_pman_init(&b->pman);
 
-	agent_ghost_init(&b->ghosts[0], game_map_rgb(255, 0, 255));
-	agent_ghost_init(&b->ghosts[1], game_map_rgb(0, 0, 255));
-	agent_ghost_init(&b->ghosts[2], game_map_rgb(0, 255, 0));
-	agent_ghost_init(&b->ghosts[3], game_map_rgb(255, 0, 0));
+	for (i = 0; i < 4; i++)
+		agent_ghost_init(&b->ghosts[i], game_map_rgb(g_board_ghost_colors[i][0], g_board_ghost_colors[i][1], g_board_ghost_colors[i][2]));
 
 	agent_fruit_init(&b->fruit);
 }
@@ -352,55 +406,127 @@ void board_init(Board *b, int x_ofs, int y_ofs)
 /* Deallocates memory gathered in board_init(). */
 void board_destroy(Board *b)
 {
-	SDL_FreeSurface(b->background);
-	SDL_FreeSurface(b->walls_bitmap);
+	if (--g_board_level_users == 0)
+		board_free_level(&g_board_level);
 	agent_pman_destroy(&b->pman);
 	agent_fruit_destroy(&b->fruit);
 }
 
-/* Draws the game board to the given surface. */
-void board_draw(Board *b, SDL_Surface *surface, int game_view_flags)
+/* Returns the i'th agent on the board, in the order they're drawn in:  the fruit,
+   then pac man, then the ghosts. */
+GameAgent *board_get_agent(Board *b, int i)
 {
-	SDL_Rect old_clip_rect;
-	int i;
+	if (i == 0) return &b->fruit;
+	if (i == 1) return &b->pman;
+	return &b->ghosts[i-2];
+}
 
-	/* Set the clipping rectangle of the game board to the surface, so we
-	   don't blit outside it (this is used for when a game agent is in
-	   the wraparound tunnel and part of it can't be seen). */
-	SDL_GetClipRect(surface, &old_clip_rect);
-	SDL_SetClipRect(surface, &b->draw_rect);
-
-	if (b->is_visible) {
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW)
-			/* If we have to redraw the whole board, blit it to the surface. */
-			SDL_BlitSurface(b->background, NULL, surface, &b->draw_rect);
-		else {
-			/* Otherwise, only blit the area of the board behind the location of
-			   pac man and the ghosts in the LAST frame. */
-			agent_replace_background(&b->pman, surface, b->background, b->draw_rect.x, b->draw_rect.y);
-			for (i = 0; i < 4; i++) {
-				agent_replace_background(&b->ghosts[i], surface, b->background, b->draw_rect.x, b->draw_rect.y);
+/* Draws the board's walls into the given rectangle of the surface, or, if the board
+   isn't visible, a black box where they'd be.  This is the board's wall layer (see
+   compositor.h), and it's opaque, so that the rest of the board can be drawn over it. */
+void board_draw_walls(SDL_Surface *surface, SDL_Rect *r, void *data)
+{
+	Board *b = (Board *) data;
+	SDL_Rect r_src, r_dst;
+
+	if (!rects_clip(r, &b->draw_rect, &r_dst)) return;
+
+	if (!b->is_visible) {
+		SDL_FillRect(surface, &r_dst, 0);
+		return;
+	}
+
+	r_src.x = (Sint16) (r_dst.x - b->draw_rect.x);
+	r_src.y = (Sint16) (r_dst.y - b->draw_rect.y);
+	r_src.w = r_dst.w;
+	r_src.h = r_dst.h;
+	/* The walls are drawn once per level and shared by every board. */
+	SDL_BlitSurface(b->level->walls, &r_src, surface, &r_dst);
+}
+
+/* Draws the board's nibblets and nibbloons that are in the given rectangle of the
+   surface.  This is the board's nib layer. */
+void board_draw_nibs(SDL_Surface *surface, SDL_Rect *r, void *data)
+{
+	Board *b = (Board *) data;
+	SDL_Rect area, nib;
+	Uint32 color;
+	int i, j, x1, y1, x2, y2;
+
+	if (!b->is_visible || !rects_clip(r, &b->draw_rect, &area)) return;
+
+	color = game_map_rgb(255, 255, 0);
+
+	/* The blocks that the rectangle touches. */
+	x1 = (area.x - b->draw_rect.x) / BLOCK_SIZE;
+	y1 = (area.y - b->draw_rect.y) / BLOCK_SIZE;
+	x2 = (area.x + area.w - 1 - b->draw_rect.x) / BLOCK_SIZE;
+	y2 = (area.y + area.h - 1 - b->draw_rect.y) / BLOCK_SIZE;
+
+	for (j = y1; j <= y2; j++) {
+		for (i = x1; i <= x2; i++) {
+			int block = board_get_block(b, i, j);
+			nib.y = (Sint16) (b->draw_rect.y + BLOCK_SIZE * j);
+			nib.x = (Sint16) (b->draw_rect.x + BLOCK_SIZE * i);
+			if (block == BLOCK_NIBBLET) {
+				nib.x += (BLOCK_SIZE / 2) - 1;
+				nib.y += (BLOCK_SIZE / 2) - 1;
+				nib.w = 2;
+				nib.h = 2;
+				SDL_FillRect(surface, &nib, color);
+			}
+			if (block == BLOCK_NIBBLOON) {
+				nib.x += (BLOCK_SIZE / 2) - 2;
+				nib.y += (BLOCK_SIZE / 2) - 2;
+				nib.w = 4;
+				nib.h = 4;
+				SDL_FillRect(surface, &nib, color);
 			}
-			agent_replace_background(&b->fruit, surface, b->background, b->draw_rect.x, b->draw_rect.y);
 		}
-	} else {
-		/* If we're not visible, blit a big black box to where we're supposed
-		   to be. */
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW)
-			SDL_FillRect(surface, &b->draw_rect, 0);
 	}
+}
+
+/* Draws the agents on the board that are in the given rectangle of the surface.
+   This is the board's sprite layer. */
+void board_draw_sprites(SDL_Surface *surface, SDL_Rect *r, void *data)
+{
+	Board *b = (Board *) data;
+	SDL_Rect clip_rect;
+	int i;
 
-	/* Draw the fruit. */
-	agent_draw(&b->fruit, surface, b->draw_rect.x, b->draw_rect.y);
+	/* Clip to the game board, so we don't blit outside it (this is used for when
+	   a game agent is in the wraparound tunnel and part of it can't be seen). */
+	if (!rects_clip(r, &b->draw_rect, &clip_rect)) return;
+	SDL_SetClipRect(surface, &clip_rect);
 
-	/* Draw pac man and the ghosts. */
-	agent_draw(&b->pman, surface, b->draw_rect.x, b->draw_rect.y);
-	for (i = 0; i < 4; i++) {
-		agent_draw(&b->ghosts[i], surface, b->draw_rect.x, b->draw_rect.y);
+	for (i = 0; i < BOARD_NUM_AGENTS; i++) {
+		GameAgent *ga = board_get_agent(b, i);
+
+		if (ga->drawn_rect.w && rects_intersect(&ga->drawn_rect, &clip_rect))
+			agent_draw(ga, surface, b->draw_rect.x, b->draw_rect.y);
 	}
 
-	/* Restore the surface's old clipping rectangle. */
-	SDL_SetClipRect(surface, &old_clip_rect);
+	SDL_SetClipRect(surface, r);
+}
+
+/* Makes the board's wall, nib and sprite layers the game's (see game_set_layer()). */
+void board_set_layers(Board *b)
+{
+	game_set_layer(COMPOSITOR_LAYER_WALLS, board_draw_walls, b);
+	game_set_layer(COMPOSITOR_LAYER_NIBS, board_draw_nibs, b);
+	game_set_layer(COMPOSITOR_LAYER_SPRITES, board_draw_sprites, b);
+}
+
+/* Marks whatever on the board has changed since the last frame as dirty on the board's
+   layers, so that it's redrawn.  Changes to the board itself are marked as they happen,
+   so this only has to look for agents that have moved or changed how they look.  Should
+   be called once a frame by the view of the game state that shows the board. */
+void board_invalidate_changes(Board *b)
+{
+	int i;
+
+	for (i = 0; i < BOARD_NUM_AGENTS; i++)
+		agent_invalidate_changes(board_get_agent(b, i), b->draw_rect.x, b->draw_rect.y);
 }
 
 /* The board controller handles input and connects keystrokes to the
@@ -495,7 +621,7 @@ void board_toggle_visible(Board *b)
 	else
 		b->is_visible = 1;
 
-	game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+	game_invalidate_layer(COMPOSITOR_LAYER_WALLS, &b->draw_rect);
 }
 
 /* The game board's state machine function. */
@@ -34,7 +34,7 @@
 #define BOARD_PIXEL_HEIGHT (BOARD_HEIGHT*BLOCK_SIZE)
 
 /* The BLOCK_* constants refer to the values of a
-   game board's blocks[][] array and signify the type
+   level's blocks[][] array and signify the type
    of block at a given location on the game board. */
 #define BLOCK_NOTHING        3
 #define BLOCK_WALL           0
@@ -64,6 +64,9 @@
 /* Pacman just landed on a new block! */
 #define BOARD_MSG_PMAN_ON_BLOCK 10
 
+/* Number of game agents on the board:  the fruit, pac man and the four ghosts. */
+#define BOARD_NUM_AGENTS 6
+
 /* Number of times to flash the board when the player wins a level. */
 #define BOARD_WIN_FLASH_TIMES 10
 
@@ -79,11 +82,52 @@
 /* Find out what block a given fixed-point pixel coordinate is in. */
 #define GET_BLOCK_FIXED(x) GET_BLOCK(FIXED_GET_INT(x))
 
+/* Number of words in a bitset with one bit per block, and the word and bit of
+   a given block in it. */
+#define BOARD_BLOCK_WORDS ((BOARD_WIDTH*BOARD_HEIGHT+31)/32)
+#define BOARD_NIB_WORD(x, y) (((y)*BOARD_WIDTH + (x)) >> 5)
+#define BOARD_NIB_MASK(x, y) ((Uint32)1 << (((y)*BOARD_WIDTH + (x)) & 31))
+
+/* Whether there's still a nib at the given block of a board, and eat it. */
+#define BOARD_HAS_NIB(b, x, y) ((b)->nibs[BOARD_NIB_WORD(x, y)] & BOARD_NIB_MASK(x, y))
+#define BOARD_CLEAR_NIB(b, x, y) ((b)->nibs[BOARD_NIB_WORD(x, y)] &= ~BOARD_NIB_MASK(x, y))
+
+/* The parts of a level that never change during play.  There's only one of
+   these, which every board points to and none of them writes to, so a board
+   (and a snapshot of one) only has to carry the nibs that are left on it. */
+typedef struct BoardLevel {
+	/* Array of blocks on the level as it starts.  Each element corresponds to
+	   a BLOCK_* constant. */
+	Uint8 blocks[BOARD_WIDTH][BOARD_HEIGHT];
+
+	/* Bitset of the blocks that start with a nib, and how many there are. */
+	Uint32 nibs[BOARD_BLOCK_WORDS];
+	int num_nibs;
+
+	/* Array that tells ghosts how to get back to the asylum. 
+	   Each array index represents a block whose FixedVector indicates
+	   the direction to go to get back to the asylum. */
+	FixedVector goto_asylum_directions[BOARD_WIDTH][BOARD_HEIGHT];
+
+	/* The bitmap that contains tiles of each wall segment (the game's sprite
+	   atlas), and where they are on it.  Used for creating the wall layer. */
+	SDL_Surface *walls_bitmap;
+	SDL_Rect walls_bitmap_rect;
+
+	/* The level's walls drawn on an otherwise empty surface, or NULL if the game
+	   is headless. */
+	SDL_Surface *walls;
+} BoardLevel;
+
 /* This structure represents the game board, including its walls, nibblets,
    nibbloons, empty space, and the asylum that the ghosts rest in. */
 typedef struct Board {
-	/* Array of blocks on the board.  Each element correpsonds to a BLOCK_* constant. */
-	int blocks[BOARD_WIDTH][BOARD_HEIGHT];
+	/* The level the board is playing.  Shared with every other board. */
+	const BoardLevel *level;
+
+	/* Bitset of the blocks whose nibblet or nibbloon hasn't been eaten yet.  Use
+	   board_get_block() to find out what's at a block. */
+	Uint32 nibs[BOARD_BLOCK_WORDS];
 
 	/* Number of nibblets/nibloons left.  When this hits 0, the level has been won. */
 	int nibs_left;
@@ -95,13 +139,6 @@ typedef struct Board {
 	/* The state of the game board. */
 	State state;
 
-	/* The fully-drawn game board surface. */
-	SDL_Surface *background;
-
-	/* The bitmap that contains tiles of each wall segment.  Used for creating
-	   the bitmap of the board surface. */
-	SDL_Surface *walls_bitmap;
-
 	/* Absolute pixel coodinates of the rectangle that the board is drawn on. */
 	SDL_Rect draw_rect;
 
@@ -114,23 +151,39 @@ typedef struct Board {
 	/* The fruit. */
 	GameAgent fruit;
 
-	/* Array that tells ghosts how to get back to the asylum. 
-	   Each array index represents a block whose FixedVector indicates
-	   the direction to go to get back to the asylum. */
-	FixedVector goto_asylum_directions[BOARD_WIDTH][BOARD_HEIGHT];
+	/* Caller-owned observation planes that are kept up to date as the board
+	   changes, or NULL.  See pman_obs.h. */
+	Uint8 *obs_planes;
+
+	/* Index into obs_planes of the mark of each agent (see the OBS_AGENT_*
+	   constants), or -1 if it isn't marked. */
+	int obs_agent_marks[BOARD_NUM_AGENTS];
 
 } Board;
 
 DECLARE_STATE_MACHINE(board_state_machine);
 
+/* Block offsets for moving in each DIRECTION_* constant, and the opposite of
+   each DIRECTION_* constant. */
+extern const int board_dir_dx[4];
+extern const int board_dir_dy[4];
+extern const int board_dir_reverse[4];
+
+int board_wrap_x(int x);
 int board_get_block(Board *b, int x, int y);
 
+void board_erase_nib(Board *b, int x, int y);
 void board_load_data(Board *b);
-void board_generate_background(Board *b);
 void board_restart(Board *b, int reload_board_data);
+void board_add_sprites();
 void board_init(Board *b, int x_ofs, int y_ofs);
 void board_destroy(Board *b);
-void board_draw(Board *b, SDL_Surface *surface, int game_view_flags);
+GameAgent *board_get_agent(Board *b, int i);
+void board_draw_walls(SDL_Surface *surface, SDL_Rect *r, void *data);
+void board_draw_nibs(SDL_Surface *surface, SDL_Rect *r, void *data);
+void board_draw_sprites(SDL_Surface *surface, SDL_Rect *r, void *data);
+void board_set_layers(Board *b);
+void board_invalidate_changes(Board *b);
 int board_controller(Board *b, SDL_Event *e);
 void board_toggle_visible(Board *b);
 FixedVector board_get_asylum_directions_at_block(Board *b, int x, int y);
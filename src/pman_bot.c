@@ -0,0 +1,295 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "SDL.h"
+
+#include "debug.h"
+#include "state.h"
+#include "drawing.h"
+#include "pman_agent.h"
+#include "pman_obs.h"
+#include "pman_env.h"
+#include "pman_bot.h"
+#include "pman_spectate.h"
+
+/* The bot's current batch of worlds, or NULL. */
+static Env *g_bot_env = NULL;
+
+/* Size of each frame sent for the current batch. */
+static int g_bot_frame_size;
+
+/* Buffer that each reply is put together in before it's sent in one go.  The
+   worlds' grid observation planes are kept up to date right in it. */
+static Uint8 *g_bot_reply = NULL;
+
+/* The actions of a step as they arrive, as env_step() wants them, and its results. */
+static Sint8 *g_bot_action_bytes = NULL;
+static int *g_bot_actions = NULL;
+static EnvResult *g_bot_results = NULL;
+
+/* Frees the current batch of worlds, if there is one. */
+void bot_destroy_worlds()
+{
+	if (!g_bot_env) return;
+	env_destroy(g_bot_env);
+	g_bot_env = NULL;
+	free(g_bot_reply);
+	free(g_bot_action_bytes);
+	free(g_bot_actions);
+	free(g_bot_results);
+}
+
+/* Returns the frame of the given world in the reply buffer. */
+BotFrame *bot_get_frame(int world)
+{
+	return (BotFrame *) (g_bot_reply + sizeof(BotReply) + world * g_bot_frame_size);
+}
+
+/* Replaces the current batch of worlds with a new one. */
+void bot_create_worlds(int num_worlds, Uint32 seed, Uint32 flags)
+{
+	int i;
+
+	bot_destroy_worlds();
+
+	g_bot_frame_size = sizeof(BotFrame) + ((flags & BOT_FLAG_PLANES) ? OBS_SIZE : 0);
+	g_bot_reply = (Uint8 *) malloc(sizeof(BotReply) + num_worlds * g_bot_frame_size);
+	g_bot_action_bytes = (Sint8 *) malloc(num_worlds);
+	g_bot_actions = (int *) malloc(sizeof(int) * num_worlds);
+	g_bot_results = (EnvResult *) malloc(sizeof(EnvResult) * num_worlds);
+	if (!g_bot_reply || !g_bot_action_bytes || !g_bot_actions || !g_bot_results) {
+		err("Couldn't allocate bot buffers.\n", 1);
+	}
+
+	g_bot_env = env_create(seed, num_worlds);
+	if (flags & BOT_FLAG_PLANES) {
+		for (i = 0; i < num_worlds; i++)
+			env_set_observation_planes(g_bot_env, i, (Uint8 *) bot_get_frame(i) + sizeof(BotFrame));
+	}
+	env_reset_all(g_bot_env, g_bot_results);
+}
+
+/* Copies the given result into the given frame. */
+void bot_fill_frame(BotFrame *f, const EnvResult *r)
+{
+	int i;
+
+	f->reward = r->reward;
+	f->done = r->done;
+	f->pman_x = r->obs.pman_x;
+	f->pman_y = r->obs.pman_y;
+	f->pman_dir = r->obs.pman_dir;
+	for (i = 0; i < 4; i++) {
+		f->ghost_x[i] = r->obs.ghost_x[i];
+		f->ghost_y[i] = r->obs.ghost_y[i];
+		f->ghost_state[i] = r->obs.ghost_state[i];
+	}
+	f->fruit_is_visible = r->obs.fruit_is_visible;
+	f->fruit_x = r->obs.fruit_x;
+	f->fruit_y = r->obs.fruit_y;
+	f->nibs_left = r->obs.nibs_left;
+	f->lives_left = r->obs.lives_left;
+	f->level = r->obs.level;
+	f->score = r->obs.score;
+}
+
+/* Sends a reply with the given status to the bot.  If the status is
+   BOT_STATUS_OK and with_frames is nonzero, it comes with a frame for every
+   world.  Returns zero if the reply couldn't be sent. */
+int bot_send_reply(FILE *out, int status, int with_frames)
+{
+	BotReply reply;
+	int i, n = 0;
+
+	if (status == BOT_STATUS_OK && with_frames) {
+		n = g_bot_env->num_worlds;
+		for (i = 0; i < n; i++)
+			bot_fill_frame(bot_get_frame(i), &g_bot_results[i]);
+	}
+
+	reply.magic = BOT_MAGIC;
+	reply.status = (Uint32) status;
+	reply.count = (Uint32) n;
+	reply.frame_size = (Uint32) (g_bot_env ? g_bot_frame_size : sizeof(BotFrame));
+
+	if (n) {
+		/* The frames are already in place after the header, so the whole reply
+		   goes out in a single write. */
+		memcpy(g_bot_reply, &reply, sizeof(BotReply));
+		if (fwrite(g_bot_reply, sizeof(BotReply) + n * g_bot_frame_size, 1, out) != 1)
+			return 0;
+	} else {
+		if (fwrite(&reply, sizeof(BotReply), 1, out) != 1)
+			return 0;
+	}
+	return fflush(out) == 0;
+}
+
+/* Steps every world of the given batch with the given wire actions, using
+   env_actions (one int per world) as scratch space.  Worlds whose action is
+   BOT_ACTION_RESET are started over instead.  Returns zero, without stepping
+   anything, if any action is out of range. */
+int bot_step_env(Env *env, const Sint8 *actions, int *env_actions, EnvResult results[])
+{
+	int i, n = env->num_worlds;
+
+	for (i = 0; i < n; i++) {
+		int action = actions[i];
+
+		if (action < BOT_ACTION_RESET || action > DIRECTION_RIGHT) return 0;
+		env_actions[i] = (action == BOT_ACTION_RESET) ? ENV_ACTION_NONE : action;
+	}
+
+	env_step(env, env_actions, n, results);
+
+	/* Stepping a world that's about to be reset doesn't matter, since the reset
+	   throws away what happened;  it's usually done anyway, and so left alone. */
+	for (i = 0; i < n; i++) {
+		if (actions[i] == BOT_ACTION_RESET)
+			env_reset(env, i, &results[i]);
+	}
+
+	if (spectate_is_listening()) {
+		Board *b;
+		Score *s;
+		int level;
+
+		env_get_world(env, 0, &b, &s, &level);
+		spectate_update(b, s, level);
+	}
+	return 1;
+}
+
+/* Plays the protocol with a bot over the given streams until it quits, the
+   connection ends, or it sends something that makes no sense.  Returns nonzero
+   if the bot asked to quit. */
+int bot_serve(FILE *in, FILE *out)
+{
+	BotRequest req;
+	int quit = 0;
+
+	while (fread(&req, sizeof(BotRequest), 1, in) == 1) {
+		if (req.command == BOT_CMD_CREATE) {
+			if (req.count == 0 || req.count > ENV_MAX_WORLDS) {
+				bot_send_reply(out, BOT_STATUS_BAD_REQUEST, 0);
+				break;
+			}
+			bot_create_worlds((int) req.count, req.seed, req.flags);
+			if (!bot_send_reply(out, BOT_STATUS_OK, 1)) break;
+		} else if (req.command == BOT_CMD_STEP) {
+			if (!g_bot_env) {
+				bot_send_reply(out, BOT_STATUS_NO_WORLDS, 0);
+				break;
+			}
+			if (req.count != (Uint32) g_bot_env->num_worlds) {
+				bot_send_reply(out, BOT_STATUS_BAD_REQUEST, 0);
+				break;
+			}
+			if (fread(g_bot_action_bytes, req.count, 1, in) != 1) break;
+			if (!bot_step_env(g_bot_env, g_bot_action_bytes, g_bot_actions, g_bot_results)) {
+				bot_send_reply(out, BOT_STATUS_BAD_REQUEST, 0);
+				break;
+			}
+			if (!bot_send_reply(out, BOT_STATUS_OK, 1)) break;
+		} else if (req.command == BOT_CMD_QUIT) {
+			bot_send_reply(out, BOT_STATUS_OK, 0);
+			quit = 1;
+			break;
+		} else {
+			bot_send_reply(out, BOT_STATUS_BAD_REQUEST, 0);
+			break;
+		}
+	}
+
+	bot_destroy_worlds();
+	return quit;
+}
+
+/* Serves a single bot over stdin and stdout, then ends the game session. */
+void bot_run_stdio()
+{
+#ifdef WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	bot_serve(stdin, stdout);
+	spectate_shutdown();
+	env_shutdown();
+}
+
+/* Listens on a Unix domain socket at the given path and serves the bots that
+   connect to it, one after another, until one of them asks to quit. */
+void bot_run_socket(const char *path)
+{
+#ifdef WIN32
+	err("Unix domain sockets aren't supported on this platform.\n", 1);
+#else
+	struct sockaddr_un addr;
+	int listener;
+	int quit = 0;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		err("Bot socket path is too long.\n", 1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) err("Couldn't create bot socket.\n", 1);
+	unlink(path);
+	if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(listener, 1) < 0) {
+		err("Couldn't listen on bot socket.\n", 1);
+	}
+
+	/* A bot that goes away while its reply is being sent only ends its own
+	   connection (the write fails, and bot_serve() returns), so the next one
+	   can still be served. */
+	signal(SIGPIPE, SIG_IGN);
+
+	while (!quit) {
+		int fd = accept(listener, NULL, NULL);
+		FILE *in, *out;
+
+		if (fd < 0) {
+			/* Out of file descriptors or memory:  wait for some to be freed. */
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				SDL_Delay(BOT_ACCEPT_RETRY_MS);
+				continue;
+			}
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			err("Couldn't accept bot connection.\n", 1);
+		}
+		in = fdopen(fd, "rb");
+		out = fdopen(dup(fd), "wb");
+		if (!in || !out) {
+			err("Couldn't open bot connection.\n", 0);
+			if (in) fclose(in); else close(fd);
+			if (out) fclose(out);
+			continue;
+		}
+		quit = bot_serve(in, out);
+		fclose(in);
+		fclose(out);
+	}
+
+	close(listener);
+	unlink(path);
+	spectate_shutdown();
+	env_shutdown();
+#endif
+}
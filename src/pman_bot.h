@@ -0,0 +1,111 @@
+#ifndef INCLUDE_PMAN_BOT
+#define INCLUDE_PMAN_BOT
+
+/* pman_bot.h
+
+   Binary pipe protocol that lets a bot written in any language play a batch of
+   worlds (see pman_env.h) over stdin/stdout, or over a Unix domain socket.
+
+   The bot drives the exchange.  It sends a BotRequest, followed for
+   BOT_CMD_STEP by one Sint8 action per world, and the game answers every
+   request with a BotReply, followed by one frame per world.  A frame is a
+   BotFrame, followed by the world's OBS_SIZE bytes of grid observation planes
+   (see pman_obs.h) if BOT_FLAG_PLANES was given when the worlds were created.
+   Everything is in the host's byte order, and every field is 32 bits wide, so
+   a frame can be read straight into a struct or an array.
+
+   A typical session is:
+
+     bot:  BOT_CMD_CREATE, count = worlds, seed, flags
+     game: reply + the first frame of every world
+     bot:  BOT_CMD_STEP, count = worlds, then the actions
+     game: reply + a frame per world
+     ...   (more steps)
+     bot:  BOT_CMD_QUIT
+     game: reply with no frames
+*/
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+#include "pman_env.h"
+
+/* Value of BotReply.magic ("PMAN" in a little-endian dump). */
+#define BOT_MAGIC 0x4e414d50
+
+/* The BOT_CMD_* constants are the requests a bot can make. */
+
+/* Creates a new batch of count worlds (replacing any old one), seeded from seed,
+   and replies with their first frames. */
+#define BOT_CMD_CREATE 1
+/* Steps every world, and replies with their new frames.  count has to be the
+   number of worlds, and is followed by that many actions. */
+#define BOT_CMD_STEP   2
+/* Ends the session.  The game replies, then closes the connection and quits. */
+#define BOT_CMD_QUIT   3
+
+/* The BOT_FLAG_* constants go in BotRequest.flags for BOT_CMD_CREATE. */
+
+/* Sends each world's grid observation planes along with its frames. */
+#define BOT_FLAG_PLANES 1
+
+/* Actions are DIRECTION_* constants, ENV_ACTION_NONE, or BOT_ACTION_RESET to
+   start a new game in the world instead of stepping it. */
+#define BOT_ACTION_RESET -2
+
+/* The BOT_STATUS_* constants are the values of BotReply.status.  After anything
+   but BOT_STATUS_OK, the game closes the connection. */
+#define BOT_STATUS_OK          0
+#define BOT_STATUS_BAD_REQUEST 1
+#define BOT_STATUS_NO_WORLDS   2
+
+/* Number of ms to wait before accepting another bot connection when there
+   aren't enough file descriptors to. */
+#define BOT_ACCEPT_RETRY_MS 100
+
+/* A request from the bot. */
+typedef struct BotRequest {
+	/* BOT_CMD_* constant. */
+	Uint32 command;
+	/* Number of worlds (for BOT_CMD_CREATE) or of actions that follow (for
+	   BOT_CMD_STEP). */
+	Uint32 count;
+	/* Seed for the worlds' games (BOT_CMD_CREATE only). */
+	Uint32 seed;
+	/* BOT_FLAG_* constants (BOT_CMD_CREATE only). */
+	Uint32 flags;
+} BotRequest;
+
+/* The game's answer to a request. */
+typedef struct BotReply {
+	/* Always BOT_MAGIC. */
+	Uint32 magic;
+	/* BOT_STATUS_* constant. */
+	Uint32 status;
+	/* Number of frames that follow. */
+	Uint32 count;
+	/* Size of each frame in bytes, including any planes. */
+	Uint32 frame_size;
+} BotReply;
+
+/* What happened in one world (an EnvResult, laid out for the wire). */
+typedef struct BotFrame {
+	Sint32 reward;
+	Sint32 done;
+	Sint32 pman_x, pman_y, pman_dir;
+	Sint32 ghost_x[4], ghost_y[4], ghost_state[4];
+	Sint32 fruit_is_visible, fruit_x, fruit_y;
+	Sint32 nibs_left;
+	Sint32 lives_left;
+	Sint32 level;
+	Sint32 score;
+} BotFrame;
+
+void bot_fill_frame(BotFrame *f, const EnvResult *r);
+int bot_step_env(Env *env, const Sint8 *actions, int *env_actions, EnvResult results[]);
+int bot_serve(FILE *in, FILE *out);
+void bot_run_stdio();
+void bot_run_socket(const char *path);
+
+#endif
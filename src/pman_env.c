@@ -0,0 +1,260 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "SDL.h"
+
+#include "game.h"
+#include "state.h"
+#include "debug.h"
+#include "fixed.h"
+#include "drawing.h"
+#include "pman.h"
+#include "pman_agent.h"
+#include "pman_board.h"
+#include "pman_score.h"
+#include "pman_obs.h"
+#include "pman_pixobs.h"
+#include "pman_env.h"
+
+/* Whether the headless game session the worlds are played in has been started. */
+static int g_env_session_started = 0;
+
+/* The game world as it is at the very start of a game. */
+static WorldSnapshot g_env_start;
+
+/* The world whose contents are currently in the game's globals (i.e. the live
+   one), or NULL if none is.  The live world's snapshot is out of date until
+   another world is swapped in. */
+static WorldSnapshot *g_env_live = NULL;
+
+/* Starts the headless game session, and takes a snapshot of a brand new game. */
+void env_start_session()
+{
+	game_init_headless();
+	/* Seed the start of the session too, so that every session's new games
+	   start out the same. */
+	rand_set_state(0);
+	pman_init();
+	state_process_messages();
+	pman_snapshot_save(&g_env_start);
+	g_env_session_started = 1;
+}
+
+/* Returns the next seed from the given seed generator. */
+Uint32 env_next_seed(Uint32 *s)
+{
+	Uint32 x;
+
+	*s = *s * 1664525 + 1013904223;
+	x = *s;
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	return x;
+}
+
+/* Makes the given world the live one, saving the world that was live before. */
+void env_make_live(WorldSnapshot *ws)
+{
+	if (g_env_live == ws) return;
+	if (g_env_live) pman_snapshot_save(g_env_live);
+	pman_snapshot_restore(ws);
+	g_env_live = ws;
+}
+
+/* Fills in an observation of the given board, scoreboard and level. */
+void env_observe(EnvObservation *obs, Board *b, Score *s, int level)
+{
+	int i;
+
+	obs_get_agent_block(&b->pman, &obs->pman_x, &obs->pman_y);
+	obs->pman_dir = map_fixed_vector_to_direction(&b->pman.curr_move);
+	for (i = 0; i < 4; i++) {
+		obs_get_agent_block(&b->ghosts[i], &obs->ghost_x[i], &obs->ghost_y[i]);
+		obs->ghost_state[i] = b->ghosts[i].state.state;
+	}
+	obs->fruit_is_visible = b->fruit.is_visible;
+	obs_get_agent_block(&b->fruit, &obs->fruit_x, &obs->fruit_y);
+	obs->nibs_left = b->nibs_left;
+	obs->lives_left = s->lives_left;
+	obs->level = level;
+	obs->score = s->score;
+}
+
+/* Gets the board, scoreboard and level of the given world, whether or not it's
+   live.  They're only good until another world is stepped or reset. */
+void env_get_world(Env *env, int world, Board **b, Score **s, int *level)
+{
+	WorldSnapshot *ws = &env->worlds[world];
+
+	if (ws == g_env_live) {
+		*b = pman_get_board();
+		*s = pman_get_score();
+		*level = pman_get_level();
+	} else {
+		*b = &ws->board;
+		*s = &ws->score;
+		*level = ws->level;
+	}
+}
+
+/* Fills in an observation of the given world, whether or not it's live. */
+void env_observe_world(Env *env, int world, EnvObservation *obs)
+{
+	Board *b;
+	Score *s;
+	int level;
+
+	env_get_world(env, world, &b, &s, &level);
+	env_observe(obs, b, s, level);
+}
+
+/* Creates a batch of the given number of worlds, whose games are all seeded from
+   the given seed.  Every world starts out reset. */
+Env *env_create(Uint32 seed, int num_worlds)
+{
+	Env *env;
+	int i;
+
+	assert(num_worlds > 0 && num_worlds <= ENV_MAX_WORLDS);
+
+	if (!g_env_session_started) env_start_session();
+
+	env = (Env *) malloc(sizeof(Env));
+	env->num_worlds = num_worlds;
+	env->worlds = (WorldSnapshot *) malloc(sizeof(WorldSnapshot) * num_worlds);
+	env->seeds = (Uint32 *) malloc(sizeof(Uint32) * num_worlds);
+	env->planes = (Uint8 **) malloc(sizeof(Uint8 *) * num_worlds);
+	env->boards = (Board **) malloc(sizeof(Board *) * num_worlds);
+	if (!env->worlds || !env->seeds || !env->planes || !env->boards) {
+		err("Couldn't allocate environment.\n", 1);
+	}
+
+	for (i = 0; i < num_worlds; i++) {
+		env->planes[i] = NULL;
+		env->seeds[i] = seed;
+		/* Give every world a different sequence of seeds. */
+		env->seeds[i] = env_next_seed(&env->seeds[i]) + (Uint32) i;
+		env_reset(env, i, NULL);
+	}
+	return env;
+}
+
+/* Frees the given batch of worlds. */
+void env_destroy(Env *env)
+{
+	if (g_env_live >= env->worlds && g_env_live < env->worlds + env->num_worlds)
+		g_env_live = NULL;
+	free(env->worlds);
+	free(env->seeds);
+	free(env->planes);
+	free(env->boards);
+	free(env);
+}
+
+/* Starts a new game in the given world.  If result isn't NULL, it's filled in
+   with the new game's first observation. */
+void env_reset(Env *env, int world, EnvResult *result)
+{
+	WorldSnapshot *ws = &env->worlds[world];
+
+	if (g_env_live == ws) g_env_live = NULL;
+	*ws = g_env_start;
+	ws->rand_state = env_next_seed(&env->seeds[world]);
+	obs_attach(&ws->board, env->planes[world]);
+
+	if (result) {
+		result->reward = 0;
+		result->done = 0;
+		env_observe_world(env, world, &result->obs);
+	}
+}
+
+/* Gives the given world a buffer of OBS_SIZE bytes to keep its grid observation
+   in (see pman_obs.h), or takes it away if planes is NULL.  The buffer is filled
+   in straight away, and kept up to date from then on by env_reset() and
+   env_step(). */
+void env_set_observation_planes(Env *env, int world, Uint8 *planes)
+{
+	WorldSnapshot *ws = &env->worlds[world];
+
+	env->planes[world] = planes;
+	obs_attach(ws == g_env_live ? pman_get_board() : &ws->board, planes);
+}
+
+/* Starts a new game in every world of the batch. */
+void env_reset_all(Env *env, EnvResult results[])
+{
+	int i;
+
+	for (i = 0; i < env->num_worlds; i++) {
+		env_reset(env, i, results ? &results[i] : NULL);
+	}
+}
+
+/* Steps the first n worlds of the batch, giving world i action actions[i] and
+   writing what happened to results[i]. */
+void env_step(Env *env, const int actions[], int n, EnvResult results[])
+{
+	Board *b = pman_get_board();
+	Score *s = pman_get_score();
+	int i;
+
+	assert(n <= env->num_worlds);
+
+	for (i = 0; i < n; i++) {
+		WorldSnapshot *ws = &env->worlds[i];
+		EnvResult *r = &results[i];
+		int old_score;
+
+		if (ws == g_env_live ? pman_is_game_over() : ws->is_game_over) {
+			r->reward = 0;
+			r->done = 1;
+			env_observe_world(env, i, &r->obs);
+			continue;
+		}
+
+		env_make_live(ws);
+
+		old_score = s->score;
+		if (actions[i] != ENV_ACTION_NONE) {
+			agent_set_next_move(&b->pman, map_direction_to_fixed_vector(actions[i]));
+		}
+
+		/* Run one frame of the game, as game_run() would. */
+		pman_model(ENV_STEP_MS);
+		state_process_messages();
+		state_timer_update(TIMER_ID_GAME, ENV_STEP_MS);
+		obs_update_agents(b);
+
+		r->reward = s->score - old_score;
+		r->done = pman_is_game_over();
+		env_observe(&r->obs, b, s, pman_get_level());
+	}
+}
+
+/* Renders a w x h pixel observation (see pman_pixobs.h) of each world's board in
+   the given PIXOBS_FORMAT_*, one after another, into out. */
+void env_render_pixels(Env *env, Uint8 *out, int w, int h, int format)
+{
+	Score *s;
+	int i, level;
+
+	for (i = 0; i < env->num_worlds; i++) {
+		env_get_world(env, i, &env->boards[i], &s, &level);
+	}
+	pixobs_render_batch(env->boards, out, env->num_worlds, w, h, format);
+}
+
+/* Ends the headless game session.  Any Envs must be destroyed first. */
+void env_shutdown()
+{
+	if (!g_env_session_started) return;
+	pixobs_shutdown();
+	pman_shutdown();
+	game_shutdown();
+	g_env_live = NULL;
+	g_env_session_started = 0;
+}
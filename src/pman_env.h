@@ -0,0 +1,88 @@
+#ifndef INCLUDE_PMAN_ENV
+#define INCLUDE_PMAN_ENV
+
+/* pman_env.h
+
+   Step/reset environment API for training agents on pac man.
+
+   An Env is a batch of independent games ("worlds") that are stepped together.
+   Every world is played by the real game (pman_model() and the play state
+   machine) in a headless session, with nothing drawn and no sound.  Since the
+   game's objects are all globals, only one world can be "live" at a time;  the
+   others are kept as WorldSnapshots and swapped in when they're stepped.  A world
+   that's stepped on its own over and over stays live, and costs no copying at
+   all.
+
+   Each step feeds pac man one action (the way a key press would) and runs
+   ENV_STEP_MS of game time.  Besides the small EnvObservation each step
+   returns, a world can be given a buffer that's kept up to date with a grid
+   observation of its board (see pman_obs.h), and env_render_pixels() renders
+   small pixel observations of every world (see pman_pixobs.h).  Like the game itself, the session has to be run
+   from the directory that holds the game's BMP files.
+*/
+
+#include "SDL.h"
+
+#include "pman.h"
+
+/* Number of ms of game time that each step covers. */
+#define ENV_STEP_MS 16
+
+/* Maximum number of worlds in one Env. */
+#define ENV_MAX_WORLDS 4096
+
+/* Actions are DIRECTION_* constants, or ENV_ACTION_NONE to leave pac man's
+   queued move alone. */
+#define ENV_ACTION_NONE -1
+
+/* What an agent gets to see of a world after each step. */
+typedef struct EnvObservation {
+	/* Block pac man is on, and the DIRECTION_* constant he's heading in (or -1
+	   if he's standing still). */
+	int pman_x, pman_y, pman_dir;
+	/* Block each ghost is on, and its GHOST_STATE_* constant. */
+	int ghost_x[4], ghost_y[4], ghost_state[4];
+	/* Whether the fruit is out, and the block it's on. */
+	int fruit_is_visible, fruit_x, fruit_y;
+	/* Nibs left on the board, lives left, the level (starting at 0) and the score. */
+	int nibs_left;
+	int lives_left;
+	int level;
+	int score;
+} EnvObservation;
+
+/* Result of resetting or stepping one world. */
+typedef struct EnvResult {
+	/* Points scored during the step. */
+	int reward;
+	/* Whether the game is over.  A world that's done is left alone by env_step()
+	   (which reports no reward for it) until it's reset. */
+	int done;
+	EnvObservation obs;
+} EnvResult;
+
+/* A batch of worlds. */
+typedef struct Env {
+	int num_worlds;
+	/* The worlds themselves, when they aren't live. */
+	WorldSnapshot *worlds;
+	/* Each world's own seed generator, from which the random number generator
+	   of every new game in it is seeded. */
+	Uint32 *seeds;
+	/* Each world's grid observation buffer, or NULL. */
+	Uint8 **planes;
+	/* Each world's board, gathered up for rendering. */
+	Board **boards;
+} Env;
+
+Env *env_create(Uint32 seed, int num_worlds);
+void env_destroy(Env *env);
+void env_reset(Env *env, int world, EnvResult *result);
+void env_reset_all(Env *env, EnvResult results[]);
+void env_get_world(Env *env, int world, Board **b, Score **s, int *level);
+void env_set_observation_planes(Env *env, int world, Uint8 *planes);
+void env_render_pixels(Env *env, Uint8 *out, int w, int h, int format);
+void env_step(Env *env, const int actions[], int n, EnvResult results[]);
+void env_shutdown();
+
+#endif
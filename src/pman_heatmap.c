@@ -0,0 +1,160 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "fixed.h"
+#include "state.h"
+#include "pman_agent.h"
+#include "pman_board.h"
+#include "pman_heatmap.h"
+
+/* The heatmap the play state adds to, or NULL if nothing's being counted. */
+static Heatmap *g_heatmap = NULL;
+
+/* Zeroes every counter of the given heatmap. */
+void heatmap_clear(Heatmap *h)
+{
+	memset(h, 0, sizeof(Heatmap));
+	h->magic = HEATMAP_MAGIC;
+}
+
+/* Marks the walls of the given board in the given heatmap. */
+void heatmap_set_walls(Heatmap *h, Board *b)
+{
+	int x, y;
+
+	for (y = 0; y < BOARD_HEIGHT; y++) {
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			h->walls[y][x] = board_get_block(b, x, y) == BLOCK_WALL;
+		}
+	}
+}
+
+/* Makes the given heatmap the one that the play state adds to.  NULL stops
+   the counting. */
+void heatmap_set_current(Heatmap *h)
+{
+	g_heatmap = h;
+}
+
+/* Counts the block the given agent is on in the given HEATMAP_LAYER_* of the
+   current heatmap, if there is one. */
+void heatmap_record(int layer, GameAgent *ga)
+{
+	int x, y;
+
+	if (!g_heatmap) return;
+
+	/* The block under the middle of the agent.  Agents in the tunnel can be off
+	   the edge of the board;  they're counted on the block at its end. */
+	x = GET_BLOCK(FIXED_GET_INT(ga->loc.x) + BLOCK_SIZE/2);
+	y = GET_BLOCK(FIXED_GET_INT(ga->loc.y) + BLOCK_SIZE/2);
+	if (x < 0) x = 0;
+	if (x >= BOARD_WIDTH) x = BOARD_WIDTH - 1;
+	if (y < 0) y = 0;
+	if (y >= BOARD_HEIGHT) y = BOARD_HEIGHT - 1;
+
+	g_heatmap->counts[layer][y][x]++;
+}
+
+/* Adds the counters of heatmap h to those of heatmap into. */
+void heatmap_add(Heatmap *into, const Heatmap *h)
+{
+	const Uint32 *src = &h->counts[0][0][0];
+	Uint32 *dst = &into->counts[0][0][0];
+	int i;
+
+	for (i = 0; i < HEATMAP_NUM_LAYERS * BOARD_HEIGHT * BOARD_WIDTH; i++) {
+		dst[i] += src[i];
+	}
+	for (i = 0; i < BOARD_HEIGHT * BOARD_WIDTH; i++) {
+		(&into->walls[0][0])[i] |= (&h->walls[0][0])[i];
+	}
+	into->games += h->games;
+}
+
+/* Reads a heatmap saved by heatmap_save() from the start of the given file.
+   Returns nonzero on success. */
+int heatmap_load(Heatmap *h, FILE *f)
+{
+	if (fseek(f, 0, SEEK_SET) != 0 || fread(h, sizeof(Heatmap), 1, f) != 1)
+		return 0;
+	return h->magic == HEATMAP_MAGIC;
+}
+
+/* Writes the given heatmap over the start of the given file.  Returns nonzero
+   on success. */
+int heatmap_save(const Heatmap *h, FILE *f)
+{
+	return fseek(f, 0, SEEK_SET) == 0 && fwrite(h, sizeof(Heatmap), 1, f) == 1 && fflush(f) == 0;
+}
+
+/* Returns log2(x+1) in fixed point with 8 fractional bits.  Counts are shown
+   on a log scale, since a few blocks (the start, the corridors next to the
+   asylum) see far more of everything than the rest. */
+Uint32 heatmap_log_scale(Uint32 x)
+{
+	Uint32 bits = 0;
+
+	x++;
+	while (x >> (bits + 1)) bits++;
+	/* The bits below the top one make a good enough fraction. */
+	if (bits >= 8)
+		return (bits << 8) | ((x >> (bits - 8)) & 0xff);
+	return (bits << 8) | ((x << (8 - bits)) & 0xff);
+}
+
+/* Renders the given HEATMAP_LAYER_* of a heatmap as a binary PPM file:  walls
+   in blue, and the counters going from black through red and yellow to white.
+   Returns nonzero on success. */
+int heatmap_write_ppm(const Heatmap *h, int layer, const char *path)
+{
+	Uint8 row[BOARD_WIDTH * HEATMAP_BLOCK_PIXELS * 3];
+	Uint32 max = 0;
+	FILE *f;
+	int x, y, i, ok;
+
+	for (y = 0; y < BOARD_HEIGHT; y++) {
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			if (h->counts[layer][y][x] > max) max = h->counts[layer][y][x];
+		}
+	}
+	max = heatmap_log_scale(max);
+
+	f = fopen(path, "wb");
+	if (!f) return 0;
+	fprintf(f, "P6\n%d %d\n255\n", BOARD_WIDTH * HEATMAP_BLOCK_PIXELS, BOARD_HEIGHT * HEATMAP_BLOCK_PIXELS);
+
+	ok = 1;
+	for (y = 0; y < BOARD_HEIGHT && ok; y++) {
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			Uint8 r, g, b;
+
+			if (h->walls[y][x]) {
+				r = 0; g = 0; b = 128;
+			} else {
+				/* 0 to 767 along the black, red, yellow, white ramp. */
+				Uint32 heat = max ? heatmap_log_scale(h->counts[layer][y][x]) * 767 / max : 0;
+
+				r = (Uint8) (heat > 255 ? 255 : heat);
+				g = (Uint8) (heat > 511 ? 255 : (heat > 255 ? heat - 256 : 0));
+				b = (Uint8) (heat > 511 ? heat - 512 : 0);
+			}
+			for (i = 0; i < HEATMAP_BLOCK_PIXELS; i++) {
+				Uint8 *p = row + (x * HEATMAP_BLOCK_PIXELS + i) * 3;
+
+				p[0] = r; p[1] = g; p[2] = b;
+			}
+		}
+		for (i = 0; i < HEATMAP_BLOCK_PIXELS && ok; i++) {
+			ok = fwrite(row, sizeof(row), 1, f) == 1;
+		}
+	}
+
+	if (fclose(f) != 0) ok = 0;
+	return ok;
+}
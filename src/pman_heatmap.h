@@ -0,0 +1,63 @@
+#ifndef INCLUDE_PMAN_HEATMAP
+#define INCLUDE_PMAN_HEATMAP
+
+/* pman_heatmap.h
+
+   Per-block counters of where things happen on the board over many games:
+   where pac man dies, where ghosts get eaten, and where pac man spends his
+   time.
+
+   The play state adds to the current heatmap (if there is one) as the game
+   goes.  Since the game's objects are all globals, a process only ever plays
+   one game at a time, so each batch worker process (see pman_batch.h) keeps a
+   heatmap of its own, and the driver adds them up at the end of the run.
+
+   A heatmap is saved exactly as it is in memory, in the host's byte order.
+   Along with the counters, it keeps which blocks are walls, so that it can be
+   rendered without loading the board.
+*/
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+#include "state.h"
+#include "pman_agent.h"
+#include "pman_board.h"
+
+/* Value of Heatmap.magic. */
+#define HEATMAP_MAGIC 0x50414d48
+
+/* The HEATMAP_LAYER_* constants are the things a heatmap counts. */
+
+/* Times pac man was killed on each block. */
+#define HEATMAP_LAYER_DEATHS  0
+/* Times a ghost was eaten on each block. */
+#define HEATMAP_LAYER_KILLS   1
+/* Frames of play that pac man spent on each block. */
+#define HEATMAP_LAYER_TRAFFIC 2
+#define HEATMAP_NUM_LAYERS    3
+
+/* Width and height, in pixels, of each block in a rendered heatmap. */
+#define HEATMAP_BLOCK_PIXELS 8
+
+typedef struct Heatmap {
+	/* Always HEATMAP_MAGIC. */
+	Uint32 magic;
+	/* Number of games counted. */
+	Uint32 games;
+	/* Nonzero for each block that's a wall. */
+	Uint8 walls[BOARD_HEIGHT][BOARD_WIDTH];
+	Uint32 counts[HEATMAP_NUM_LAYERS][BOARD_HEIGHT][BOARD_WIDTH];
+} Heatmap;
+
+void heatmap_clear(Heatmap *h);
+void heatmap_set_walls(Heatmap *h, Board *b);
+void heatmap_set_current(Heatmap *h);
+void heatmap_record(int layer, GameAgent *ga);
+void heatmap_add(Heatmap *into, const Heatmap *h);
+int heatmap_load(Heatmap *h, FILE *f);
+int heatmap_save(const Heatmap *h, FILE *f);
+int heatmap_write_ppm(const Heatmap *h, int layer, const char *path);
+
+#endif
@@ -0,0 +1,121 @@
+#include "globals.h"
+
+#include <string.h>
+
+#include "SDL.h"
+
+#include "state.h"
+#include "fixed.h"
+#include "pman_board.h"
+#include "pman_agent.h"
+#include "pman_obs.h"
+
+/* Puts the block nearest to the given agent, clamped to the board, into x, y. */
+void obs_get_agent_block(GameAgent *ga, int *x, int *y)
+{
+	*x = GET_BLOCK(FIXED_GET_INT(ga->loc.x) + BLOCK_SIZE/2);
+	*y = GET_BLOCK(FIXED_GET_INT(ga->loc.y) + BLOCK_SIZE/2);
+	if (*x < 0) *x = 0;
+	if (*x >= BOARD_WIDTH) *x = BOARD_WIDTH - 1;
+	if (*y < 0) *y = 0;
+	if (*y >= BOARD_HEIGHT) *y = BOARD_HEIGHT - 1;
+}
+
+/* Returns the agent with the given OBS_AGENT_* index, and puts the plane it's
+   marked in and the value it's marked with into plane, value.  The value is 0
+   if the agent shouldn't be marked at all. */
+GameAgent *obs_get_agent(Board *b, int i, int *plane, Uint8 *value)
+{
+	GameAgent *ga;
+
+	if (i == OBS_AGENT_PMAN) {
+		ga = &b->pman;
+		*plane = OBS_PLANE_PMAN;
+		*value = 1;
+	} else if (i == OBS_AGENT_FRUIT) {
+		ga = &b->fruit;
+		*plane = OBS_PLANE_FRUIT;
+		*value = (Uint8) (ga->is_visible ? 1 : 0);
+	} else {
+		ga = &b->ghosts[i - OBS_AGENT_GHOST];
+		*plane = OBS_PLANE_GHOST_1 + (i - OBS_AGENT_GHOST);
+		*value = (Uint8) ga->state.state;
+	}
+	return ga;
+}
+
+/* Attaches the given observation buffer (OBS_SIZE bytes) to the board and fills it
+   in, or detaches the board's buffer if planes is NULL. */
+void obs_attach(Board *b, Uint8 *planes)
+{
+	int i;
+
+	b->obs_planes = planes;
+	for (i = 0; i < OBS_NUM_AGENTS; i++) {
+		b->obs_agent_marks[i] = -1;
+	}
+	if (!planes) return;
+
+	memset(planes, 0, OBS_SIZE);
+	obs_refresh_blocks(b);
+	obs_update_agents(b);
+}
+
+/* Rewrites the wall and nib planes from the board's blocks.  Used whenever a
+   new board has been loaded. */
+void obs_refresh_blocks(Board *b)
+{
+	Uint8 *planes = b->obs_planes;
+	int x, y;
+
+	if (!planes) return;
+
+	for (y = 0; y < BOARD_HEIGHT; y++) {
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			int block = board_get_block(b, x, y);
+
+			planes[OBS_INDEX(OBS_PLANE_WALLS, x, y)] = (Uint8) (block == BLOCK_WALL || block == BLOCK_ASYLUM_DOOR);
+			planes[OBS_INDEX(OBS_PLANE_NIBBLETS, x, y)] = (Uint8) (block == BLOCK_NIBBLET);
+			planes[OBS_INDEX(OBS_PLANE_NIBBLOONS, x, y)] = (Uint8) (block == BLOCK_NIBBLOON);
+		}
+	}
+}
+
+/* Clears the nib at the given block from the board's observation.  Called by
+   board_destroy_nib(). */
+void obs_clear_nib(Board *b, int x, int y)
+{
+	if (!b->obs_planes) return;
+	b->obs_planes[OBS_INDEX(OBS_PLANE_NIBBLETS, x, y)] = 0;
+	b->obs_planes[OBS_INDEX(OBS_PLANE_NIBBLOONS, x, y)] = 0;
+}
+
+/* Brings the marks of pac man, the ghosts and the fruit in the board's observation
+   up to date.  Only agents that have changed block or state since the last call
+   are touched. */
+void obs_update_agents(Board *b)
+{
+	Uint8 *planes = b->obs_planes;
+	int i;
+
+	if (!planes) return;
+
+	for (i = 0; i < OBS_NUM_AGENTS; i++) {
+		GameAgent *ga;
+		int plane, x, y, mark;
+		Uint8 value;
+
+		ga = obs_get_agent(b, i, &plane, &value);
+		obs_get_agent_block(ga, &x, &y);
+		mark = value ? OBS_INDEX(plane, x, y) : -1;
+
+		if (mark == b->obs_agent_marks[i] && (mark < 0 || planes[mark] == value))
+			continue;
+
+		if (b->obs_agent_marks[i] >= 0)
+			planes[b->obs_agent_marks[i]] = 0;
+		if (mark >= 0)
+			planes[mark] = value;
+		b->obs_agent_marks[i] = mark;
+	}
+}
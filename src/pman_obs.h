@@ -0,0 +1,68 @@
+#ifndef INCLUDE_PMAN_OBS
+#define INCLUDE_PMAN_OBS
+
+/* pman_obs.h
+
+   Grid observations of the game board for learning agents.
+
+   An observation is a stack of OBS_NUM_PLANES planes of bytes, one byte per
+   block of the board, stored plane by plane and row by row within each plane:
+   the byte for block (x, y) of plane p is at
+
+     planes[OBS_INDEX(p, x, y)]
+
+   The planes are written straight into a buffer the caller owns, which is
+   attached to a board with obs_attach().  They're filled in completely only
+   then (and when a new board is loaded);  after that, nibs are cleared from
+   them as board_destroy_nib() eats them, and obs_update_agents() only moves the
+   marks of agents whose block or state has changed since it last looked.
+*/
+
+#include "SDL.h"
+
+#include "pman_board.h"
+
+/* The OBS_PLANE_* constants are the planes of an observation. */
+
+/* 1 for each wall (or asylum door) block. */
+#define OBS_PLANE_WALLS     0
+/* 1 for each block holding a nibblet. */
+#define OBS_PLANE_NIBBLETS  1
+/* 1 for each block holding a nibbloon. */
+#define OBS_PLANE_NIBBLOONS 2
+/* 1 on the block pac man is on. */
+#define OBS_PLANE_PMAN      3
+/* One plane per ghost, holding the ghost's GHOST_STATE_* constant (which is
+   never 0) on the block it's on. */
+#define OBS_PLANE_GHOST_1   4
+#define OBS_PLANE_GHOST_2   5
+#define OBS_PLANE_GHOST_3   6
+#define OBS_PLANE_GHOST_4   7
+/* 1 on the block the fruit is on, while it's out. */
+#define OBS_PLANE_FRUIT     8
+
+#define OBS_NUM_PLANES      9
+
+/* Number of bytes in one plane, and in a whole observation. */
+#define OBS_PLANE_SIZE (BOARD_WIDTH*BOARD_HEIGHT)
+#define OBS_SIZE (OBS_NUM_PLANES*OBS_PLANE_SIZE)
+
+/* Index of block (x, y) of the given plane in an observation. */
+#define OBS_INDEX(p, x, y) ((p)*OBS_PLANE_SIZE + (y)*BOARD_WIDTH + (x))
+
+/* Number of agents that are marked in an observation (every agent on the board:
+   pac man, the ghosts, and the fruit), and the index of each in
+   Board.obs_agent_marks[]. */
+#define OBS_NUM_AGENTS BOARD_NUM_AGENTS
+#define OBS_AGENT_PMAN  0
+#define OBS_AGENT_GHOST 1
+#define OBS_AGENT_FRUIT 5
+
+void obs_get_agent_block(GameAgent *ga, int *x, int *y);
+
+void obs_attach(Board *b, Uint8 *planes);
+void obs_refresh_blocks(Board *b);
+void obs_clear_nib(Board *b, int x, int y);
+void obs_update_agents(Board *b);
+
+#endif
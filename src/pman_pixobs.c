@@ -0,0 +1,302 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXOBS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "SDL.h"
+
+#include "state.h"
+#include "fixed.h"
+#include "pman_board.h"
+#include "pman_agent.h"
+#include "pman_agent_ghost.h"
+#include "pman_pixobs.h"
+#include "workers.h"
+
+/* Brightness of each PIXOBS_COLOR_* in a grayscale frame. */
+static const Uint8 g_pixobs_gray[PIXOBS_NUM_COLORS] = { 0, 70, 150, 200, 170, 90, 110, 230, 255 };
+
+/* Each PIXOBS_COLOR_* as itself, for palette frames. */
+static const Uint8 g_pixobs_palette[PIXOBS_NUM_COLORS] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+/* Working space for rendering one frame.  Each worker thread has its own. */
+typedef struct PixobsScratch {
+	/* The full-size frame. */
+	Uint8 pixels[BOARD_PIXEL_WIDTH*BOARD_PIXEL_HEIGHT];
+	/* Sums (or maxima) of each column of a band of rows of the full-size frame. */
+	Uint16 sums[BOARD_PIXEL_WIDTH];
+	Uint8 maxes[BOARD_PIXEL_WIDTH];
+	/* First column of each output column's span, and one over its width. */
+	int x_edges[BOARD_PIXEL_WIDTH+1];
+	float x_scales[BOARD_PIXEL_WIDTH];
+} PixobsScratch;
+
+/* A batch of frames, shared by all the workers. */
+typedef struct PixobsBatch {
+	Board **boards;
+	Uint8 *out;
+	int n;
+	int w, h;
+	int format;
+} PixobsBatch;
+
+/* The worker threads, and their scratch space.  Of n workers, worker k renders
+   frames k, k + n, and so on. */
+static WorkerPool g_pixobs_workers;
+static PixobsScratch *g_pixobs_scratch[PIXOBS_MAX_THREADS];
+static PixobsBatch g_pixobs_batch;
+
+/* Scratch space for frames rendered on the calling thread. */
+static PixobsScratch g_pixobs_main_scratch;
+
+/* Fills the given rectangle of the full-size frame, clipped to the board. */
+void pixobs_fill(Uint8 *pixels, int x, int y, int w, int h, Uint8 color)
+{
+	int j;
+
+	if (x < 0) { w += x; x = 0; }
+	if (y < 0) { h += y; y = 0; }
+	if (x + w > BOARD_PIXEL_WIDTH) w = BOARD_PIXEL_WIDTH - x;
+	if (y + h > BOARD_PIXEL_HEIGHT) h = BOARD_PIXEL_HEIGHT - y;
+	if (w <= 0 || h <= 0) return;
+
+	for (j = y; j < y + h; j++) {
+		memset(&pixels[j * BOARD_PIXEL_WIDTH + x], color, w);
+	}
+}
+
+/* Fills the given agent's sprite rectangle. */
+void pixobs_fill_agent(Uint8 *pixels, GameAgent *ga, Uint8 color)
+{
+	SDL_Rect r;
+
+	agent_get_draw_bounding_rect(ga, &r, 0, 0);
+	pixobs_fill(pixels, r.x, r.y, r.w, r.h, color);
+}
+
+/* Renders the board into the full-size frame, using the given colors. */
+void pixobs_draw_board(Board *b, Uint8 *pixels, const Uint8 *colors)
+{
+	int x, y, i;
+
+	/* Walls fill whole blocks, so each row of blocks is drawn as one row of
+	   pixels copied BLOCK_SIZE times; the nibs go on top. */
+	for (y = 0; y < BOARD_HEIGHT; y++) {
+		Uint8 *row = &pixels[BLOCK(y) * BOARD_PIXEL_WIDTH];
+
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			int block = board_get_block(b, x, y);
+			Uint8 color = colors[(block == BLOCK_WALL || block == BLOCK_ASYLUM_DOOR) ? PIXOBS_COLOR_WALL : PIXOBS_COLOR_EMPTY];
+
+			memset(&row[BLOCK(x)], color, BLOCK_SIZE);
+		}
+		for (i = 1; i < BLOCK_SIZE; i++) {
+			memcpy(&row[i * BOARD_PIXEL_WIDTH], row, BOARD_PIXEL_WIDTH);
+		}
+		for (x = 0; x < BOARD_WIDTH; x++) {
+			if (board_get_block(b, x, y) == BLOCK_NIBBLET) {
+				pixobs_fill(pixels, BLOCK(x) + (BLOCK_SIZE - PIXOBS_NIBBLET_SIZE) / 2, BLOCK(y) + (BLOCK_SIZE - PIXOBS_NIBBLET_SIZE) / 2,
+					PIXOBS_NIBBLET_SIZE, PIXOBS_NIBBLET_SIZE, colors[PIXOBS_COLOR_NIBBLET]);
+			} else if (board_get_block(b, x, y) == BLOCK_NIBBLOON) {
+				pixobs_fill(pixels, BLOCK(x) + (BLOCK_SIZE - PIXOBS_NIBBLOON_SIZE) / 2, BLOCK(y) + (BLOCK_SIZE - PIXOBS_NIBBLOON_SIZE) / 2,
+					PIXOBS_NIBBLOON_SIZE, PIXOBS_NIBBLOON_SIZE, colors[PIXOBS_COLOR_NIBBLOON]);
+			}
+		}
+	}
+
+	if (b->fruit.is_visible)
+		pixobs_fill_agent(pixels, &b->fruit, colors[PIXOBS_COLOR_FRUIT]);
+
+	for (i = 0; i < 4; i++) {
+		GameAgent *ga = &b->ghosts[i];
+		int color;
+
+		if (!ga->is_visible) continue;
+		switch (ga->state.state) {
+			case GHOST_STATE_FLEEING:
+				color = PIXOBS_COLOR_GHOST_SCARED;
+				break;
+			case GHOST_STATE_SPIRIT:
+			case GHOST_STATE_GOTO_ASYLUM_ENTRANCE:
+			case GHOST_STATE_ENTER_ASYLUM:
+			case GHOST_STATE_RESPAWN:
+				color = PIXOBS_COLOR_GHOST_SPIRIT;
+				break;
+			default:
+				color = PIXOBS_COLOR_GHOST;
+		}
+		pixobs_fill_agent(pixels, ga, colors[color]);
+	}
+
+	pixobs_fill_agent(pixels, &b->pman, colors[PIXOBS_COLOR_PMAN]);
+}
+
+/* Adds the given row of the full-size frame into sums[]. */
+void pixobs_add_row(Uint16 *sums, const Uint8 *row)
+{
+	int x = 0;
+
+#ifdef PIXOBS_USE_SSE2
+	__m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 <= BOARD_PIXEL_WIDTH; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (row + x));
+		__m128i lo = _mm_loadu_si128((const __m128i *) (sums + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *) (sums + x + 8));
+
+		lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+		hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i *) (sums + x), lo);
+		_mm_storeu_si128((__m128i *) (sums + x + 8), hi);
+	}
+#endif
+	for (; x < BOARD_PIXEL_WIDTH; x++) {
+		sums[x] = (Uint16) (sums[x] + row[x]);
+	}
+}
+
+/* Takes the maximum of the given row of the full-size frame and maxes[]. */
+void pixobs_max_row(Uint8 *maxes, const Uint8 *row)
+{
+	int x = 0;
+
+#ifdef PIXOBS_USE_SSE2
+	for (; x + 16 <= BOARD_PIXEL_WIDTH; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (row + x));
+		__m128i m = _mm_loadu_si128((const __m128i *) (maxes + x));
+
+		_mm_storeu_si128((__m128i *) (maxes + x), _mm_max_epu8(m, v));
+	}
+#endif
+	for (; x < BOARD_PIXEL_WIDTH; x++) {
+		if (row[x] > maxes[x]) maxes[x] = row[x];
+	}
+}
+
+/* Renders a w x h frame of the board into out, using the given scratch space.
+   Each output row first collapses its band of full-size rows into one row of
+   column sums (or maxima), 16 pixels at a time; each output pixel then only has
+   to add up (or take the maximum of) its span of that row.  The sums fit in 16
+   bits as long as a band is no more than 257 rows tall, which it is as long as
+   h is at least 2. */
+void pixobs_render_scratch(Board *b, Uint8 *out, int w, int h, int format, PixobsScratch *s)
+{
+	int i, j, x, y;
+
+	pixobs_draw_board(b, s->pixels, format == PIXOBS_FORMAT_GRAY ? g_pixobs_gray : g_pixobs_palette);
+
+	for (i = 0; i <= w; i++) {
+		s->x_edges[i] = i * BOARD_PIXEL_WIDTH / w;
+		if (i > 0) s->x_scales[i-1] = 1.0f / (float) (s->x_edges[i] - s->x_edges[i-1]);
+	}
+
+	for (j = 0; j < h; j++) {
+		int y0 = j * BOARD_PIXEL_HEIGHT / h;
+		int y1 = (j + 1) * BOARD_PIXEL_HEIGHT / h;
+		Uint8 *out_row = &out[j * w];
+
+		if (format == PIXOBS_FORMAT_GRAY) {
+			float y_scale = 1.0f / (float) (y1 - y0);
+
+			memset(s->sums, 0, sizeof(s->sums));
+			for (y = y0; y < y1; y++)
+				pixobs_add_row(s->sums, &s->pixels[y * BOARD_PIXEL_WIDTH]);
+
+			for (i = 0; i < w; i++) {
+				Uint32 sum = 0;
+
+				for (x = s->x_edges[i]; x < s->x_edges[i+1]; x++)
+					sum += s->sums[x];
+				out_row[i] = (Uint8) ((float) sum * s->x_scales[i] * y_scale + 0.5f);
+			}
+		} else {
+			memset(s->maxes, 0, sizeof(s->maxes));
+			for (y = y0; y < y1; y++)
+				pixobs_max_row(s->maxes, &s->pixels[y * BOARD_PIXEL_WIDTH]);
+
+			for (i = 0; i < w; i++) {
+				Uint8 m = 0;
+
+				for (x = s->x_edges[i]; x < s->x_edges[i+1]; x++)
+					if (s->maxes[x] > m) m = s->maxes[x];
+				out_row[i] = m;
+			}
+		}
+	}
+}
+
+/* Renders a w x h frame of the given board in the given PIXOBS_FORMAT_* into out,
+   on the calling thread.  w and h can't be larger than the board itself, and h
+   must be at least 2. */
+void pixobs_render(Board *b, Uint8 *out, int w, int h, int format)
+{
+	assert(w >= 1 && w <= BOARD_PIXEL_WIDTH);
+	assert(h >= 2 && h <= BOARD_PIXEL_HEIGHT);
+
+	pixobs_render_scratch(b, out, w, h, format, &g_pixobs_main_scratch);
+}
+
+/* Renders worker k's share of the batch. */
+void pixobs_worker_job(int k, int n, void *data)
+{
+	PixobsBatch *batch = (PixobsBatch *) data;
+	int i;
+
+	for (i = k; i < batch->n; i += n) {
+		pixobs_render_scratch(batch->boards[i], batch->out + i * batch->w * batch->h,
+			batch->w, batch->h, batch->format, g_pixobs_scratch[k]);
+	}
+}
+
+/* Starts up one worker thread per processor. */
+void pixobs_start_threads()
+{
+	int k;
+
+	workers_start(&g_pixobs_workers, PIXOBS_MAX_THREADS, pixobs_worker_job, &g_pixobs_batch);
+	for (k = 0; k < g_pixobs_workers.num_threads; k++) {
+		g_pixobs_scratch[k] = (PixobsScratch *) malloc(sizeof(PixobsScratch));
+		assert(g_pixobs_scratch[k] != NULL);
+	}
+}
+
+/* Renders a frame of each of the n given boards into out, one after another,
+   on the worker threads.  Returns once they're all done.  The boards mustn't
+   change in the meantime. */
+void pixobs_render_batch(Board *boards[], Uint8 *out, int n, int w, int h, int format)
+{
+	assert(w >= 1 && w <= BOARD_PIXEL_WIDTH);
+	assert(h >= 2 && h <= BOARD_PIXEL_HEIGHT);
+
+	if (n == 1) {
+		pixobs_render(boards[0], out, w, h, format);
+		return;
+	}
+
+	if (g_pixobs_workers.num_threads == 0) pixobs_start_threads();
+
+	g_pixobs_batch.boards = boards;
+	g_pixobs_batch.out = out;
+	g_pixobs_batch.n = n;
+	g_pixobs_batch.w = w;
+	g_pixobs_batch.h = h;
+	g_pixobs_batch.format = format;
+
+	workers_run(&g_pixobs_workers);
+}
+
+/* Stops the worker threads.  They're started again the next time they're needed. */
+void pixobs_shutdown()
+{
+	int k, n = g_pixobs_workers.num_threads;
+
+	workers_stop(&g_pixobs_workers);
+	for (k = 0; k < n; k++)
+		free(g_pixobs_scratch[k]);
+}
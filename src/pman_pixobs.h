@@ -0,0 +1,56 @@
+#ifndef INCLUDE_PMAN_PIXOBS
+#define INCLUDE_PMAN_PIXOBS
+
+/* pman_pixobs.h
+
+   Low-resolution pixel observations of the game board, for learning agents
+   that want pixels rather than the grid planes of pman_obs.h.
+
+   A frame is rendered off-screen from the board's blocks and its agents'
+   positions and states, one byte per pixel at the board's full size, into a
+   scratch buffer;  nothing is drawn with SDL, and the screen is never touched.
+   It's then shrunk to the size asked for with a box filter.  In grayscale
+   frames each output pixel is the average brightness of its box.  In palette
+   frames it's the highest PIXOBS_COLOR_* found in its box, so that a small
+   thing like a nib still shows up when it's shrunk to less than a pixel.
+
+   Batches of frames are rendered on a pool of worker threads, one per
+   processor.
+*/
+
+#include "SDL.h"
+
+#include "pman_board.h"
+
+/* Maximum number of worker threads. */
+#define PIXOBS_MAX_THREADS 16
+
+/* The PIXOBS_FORMAT_* constants are the kinds of frame that can be rendered. */
+#define PIXOBS_FORMAT_GRAY    0
+#define PIXOBS_FORMAT_PALETTE 1
+
+/* The PIXOBS_COLOR_* constants are the colors of a palette frame, from the
+   least to the most important. */
+#define PIXOBS_COLOR_EMPTY        0
+#define PIXOBS_COLOR_WALL         1
+#define PIXOBS_COLOR_NIBBLET      2
+#define PIXOBS_COLOR_NIBBLOON     3
+#define PIXOBS_COLOR_FRUIT        4
+/* A ghost that's been eaten and is on its way back to the asylum. */
+#define PIXOBS_COLOR_GHOST_SPIRIT 5
+/* A ghost that's fleeing from pac man. */
+#define PIXOBS_COLOR_GHOST_SCARED 6
+#define PIXOBS_COLOR_GHOST        7
+#define PIXOBS_COLOR_PMAN         8
+
+#define PIXOBS_NUM_COLORS         9
+
+/* Sizes in pixels of a nibblet and a nibbloon in the full-size frame. */
+#define PIXOBS_NIBBLET_SIZE  2
+#define PIXOBS_NIBBLOON_SIZE 8
+
+void pixobs_render(Board *b, Uint8 *out, int w, int h, int format);
+void pixobs_render_batch(Board *boards[], Uint8 *out, int n, int w, int h, int format);
+void pixobs_shutdown();
+
+#endif
@@ -0,0 +1,485 @@
+#include "globals.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDL.h"
+
+#include "game.h"
+#include "fixed.h"
+#include "drawing.h"
+#include "pman_board.h"
+#include "pman_agent.h"
+#include "pman_agent_ghost.h"
+#include "pman_planner.h"
+
+/* Returns whether pac man can travel through the given block. */
+int planner_is_open(Board *b, int x, int y)
+{
+	int block;
+
+	if (y < 0 || y >= BOARD_HEIGHT) return 0;
+	block = board_get_block(b, board_wrap_x(x), y);
+	return (block != BLOCK_WALL && block != BLOCK_ASYLUM_DOOR && block != BLOCK_ASYLUM_SPACE);
+}
+
+/* Returns the number of directions pac man can leave the given block in. */
+int planner_count_exits(Board *b, int x, int y)
+{
+	int d, exits = 0;
+
+	for (d = 0; d < 4; d++)
+		if (planner_is_open(b, x + board_dir_dx[d], y + board_dir_dy[d]))
+			exits++;
+	return exits;
+}
+
+/* Scales a value down by how far away (in blocks) it is. */
+int planner_discount(int value, int time)
+{
+	return value * PLANNER_DISCOUNT_BLOCKS / (PLANNER_DISCOUNT_BLOCKS + time);
+}
+
+/* Follows the corridor leaving the given junction in the given direction until it
+   reaches another junction, recording every block along the way. */
+void planner_build_edge(Planner *p, Board *b, int n, int dir)
+{
+	PlannerEdge *e = &p->nodes[n].edges[dir];
+	int x = p->nodes[n].x;
+	int y = p->nodes[n].y;
+
+	e->to = PLANNER_NONE;
+	e->length = 0;
+	e->path_start = p->path_pool_used;
+	e->arrive_dir = dir;
+
+	if (!planner_is_open(b, x + board_dir_dx[dir], y + board_dir_dy[dir])) return;
+
+	while (1) {
+		int d;
+
+		x = board_wrap_x(x + board_dir_dx[dir]);
+		y += board_dir_dy[dir];
+		assert(p->path_pool_used < PLANNER_PATH_POOL_SIZE);
+		p->path_pool[p->path_pool_used++] = (Uint16) (x + y*BOARD_WIDTH);
+		e->length++;
+		if (p->node_at[x][y] != PLANNER_NONE) break;
+
+		/* We're in the middle of a corridor, so there's exactly one way onward. */
+		for (d = 0; d < 4; d++)
+			if (d != board_dir_reverse[dir] && planner_is_open(b, x + board_dir_dx[d], y + board_dir_dy[d]))
+				break;
+		assert(d < 4);
+		dir = d;
+	}
+
+	e->to = p->node_at[x][y];
+	e->arrive_dir = dir;
+}
+
+/* Builds the planner's junction graph from the board's walls.  Should be called
+   whenever a new level starts. */
+void planner_init(Planner *p, Board *b)
+{
+	int i, j, d;
+
+	p->num_nodes = 0;
+	p->path_pool_used = 0;
+
+	for (i = 0; i < BOARD_WIDTH; i++)
+		for (j = 0; j < BOARD_HEIGHT; j++) {
+			p->node_at[i][j] = PLANNER_NONE;
+			if (planner_is_open(b, i, j) && planner_count_exits(b, i, j) != 2) {
+				assert(p->num_nodes < PLANNER_MAX_NODES);
+				p->nodes[p->num_nodes].x = i;
+				p->nodes[p->num_nodes].y = j;
+				p->node_at[i][j] = p->num_nodes++;
+			}
+		}
+
+	for (i = 0; i < p->num_nodes; i++)
+		for (d = 0; d < 4; d++)
+			planner_build_edge(p, b, i, d);
+
+	p->root = PLANNER_NONE;
+	p->best_dir = PLANNER_NONE;
+	p->is_done = 1;
+	p->frame_start_us = 0;
+	p->frame_budget_us = 0;
+	p->frame_expansions_left = -1;
+}
+
+/* Returns whether the given block is a junction (or dead end). */
+int planner_is_node(Planner *p, int x, int y)
+{
+	if (x < 0 || x >= BOARD_WIDTH || y < 0 || y >= BOARD_HEIGHT) return 0;
+	return (p->node_at[x][y] != PLANNER_NONE);
+}
+
+/* Starts a brand new search for the given junction. */
+void planner_begin(Planner *p, int node, int arrive_dir)
+{
+	p->root = node;
+	p->root_arrive_dir = arrive_dir;
+	p->is_prepared = 0;
+	p->stack_depth = 0;
+	p->depth_limit = 0;
+	p->best_dir = PLANNER_NONE;
+	p->best_depth = 0;
+	p->is_done = (node == PLANNER_NONE);
+}
+
+/* Tells the planner that pac man is at the given block, heading in the given
+   direction.  If the junction he's heading towards isn't the one the planner is
+   already thinking about, a new search is started for it. */
+void planner_look_ahead(Planner *p, Board *b, int x, int y, int dir)
+{
+	int steps;
+
+	if (dir < 0) return;
+	x = board_wrap_x(x);
+
+	for (steps = 0; steps < BOARD_WIDTH*BOARD_HEIGHT; steps++) {
+		if (!planner_is_open(b, x + board_dir_dx[dir], y + board_dir_dy[dir])) {
+			int d;
+
+			/* Follow the corner, unless we're at a junction, in which case
+			   pac man is about to stop. */
+			if (p->node_at[x][y] != PLANNER_NONE) break;
+			for (d = 0; d < 4; d++)
+				if (d != board_dir_reverse[dir] && planner_is_open(b, x + board_dir_dx[d], y + board_dir_dy[d]))
+					break;
+			if (d == 4) break;
+			dir = d;
+		}
+		x = board_wrap_x(x + board_dir_dx[dir]);
+		y += board_dir_dy[dir];
+		if (p->node_at[x][y] != PLANNER_NONE) {
+			if (p->node_at[x][y] != p->root || dir != p->root_arrive_dir)
+				planner_begin(p, p->node_at[x][y], dir);
+			return;
+		}
+	}
+
+	planner_begin(p, PLANNER_NONE, PLANNER_NONE);
+}
+
+/* Fills in a distance field by searching breadth-first outward from the blocks
+   already in the given queue (whose distances must already be set). */
+void planner_spread_distance(Board *b, Uint8 dist[BOARD_WIDTH][BOARD_HEIGHT], Uint16 *queue, int queue_len)
+{
+	int head = 0;
+
+	while (head < queue_len) {
+		int x = queue[head] % BOARD_WIDTH;
+		int y = queue[head] / BOARD_WIDTH;
+		int d;
+
+		head++;
+		for (d = 0; d < 4; d++) {
+			int nx = board_wrap_x(x + board_dir_dx[d]);
+			int ny = y + board_dir_dy[d];
+
+			if (!planner_is_open(b, nx, ny) || dist[nx][ny] != PLANNER_UNREACHABLE)
+				continue;
+			dist[nx][ny] = (Uint8) ((dist[x][y] < PLANNER_UNREACHABLE-1) ? dist[x][y]+1 : PLANNER_UNREACHABLE-1);
+			queue[queue_len++] = (Uint16) (nx + ny*BOARD_WIDTH);
+		}
+	}
+}
+
+/* Takes a snapshot of where the ghosts, nibs and fruit are for the current search. */
+void planner_prepare(Planner *p, Board *b)
+{
+	Uint16 queue[BOARD_WIDTH*BOARD_HEIGHT];
+	int queue_len;
+	int g, i, j;
+
+	p->pman_speed = b->pman.speed;
+
+	for (g = 0; g < 4; g++) {
+		GameAgent *ghost = &b->ghosts[g];
+		int x = board_wrap_x(GET_BLOCK(FIXED_GET_INT(ghost->loc.x) + BLOCK_SIZE/2));
+		int y = GET_BLOCK(FIXED_GET_INT(ghost->loc.y) + BLOCK_SIZE/2);
+		int start_dist = 0;
+
+		memset(p->ghost_dist[g], PLANNER_UNREACHABLE, sizeof(p->ghost_dist[g]));
+		p->ghost_speed[g] = ghost->original_speed;
+		p->ghost_is_threat[g] = 1;
+		p->ghost_edible_blocks[g] = 0;
+
+		switch (ghost->state.state) {
+			case GHOST_STATE_SPIRIT:
+			case GHOST_STATE_GOTO_ASYLUM_ENTRANCE:
+			case GHOST_STATE_ENTER_ASYLUM:
+			case GHOST_STATE_RESPAWN:
+			case GHOST_STATE_FREEZE_KILLED:
+				p->ghost_is_threat[g] = 0;
+				continue;
+			case GHOST_STATE_RESTING:
+			case GHOST_STATE_GOTO_ASYLUM_EXIT:
+			case GHOST_STATE_LEAVE_ASYLUM:
+				/* Ghosts in the asylum come out right above the door. */
+				start_dist = abs(x - BLOCK_ASYLUM_CENTER_X) + abs(y - BLOCK_ASYLUM_ENTER_Y);
+				x = BLOCK_ASYLUM_CENTER_X;
+				y = BLOCK_ASYLUM_ENTER_Y;
+				break;
+			case GHOST_STATE_FLEEING:
+				p->ghost_edible_blocks[g] = FIXED_GET_INT( fixed_mult(FIXED_SET_INT(agent_ghost_flee_time_left(ghost)), p->pman_speed) ) / BLOCK_SIZE;
+				break;
+		}
+
+		if (y < 0 || y >= BOARD_HEIGHT) continue;
+		p->ghost_dist[g][x][y] = (Uint8) ((start_dist < PLANNER_UNREACHABLE) ? start_dist : PLANNER_UNREACHABLE-1);
+		queue[0] = (Uint16) (x + y*BOARD_WIDTH);
+		planner_spread_distance(b, p->ghost_dist[g], queue, 1);
+	}
+
+	memset(p->nib_dist, PLANNER_UNREACHABLE, sizeof(p->nib_dist));
+	queue_len = 0;
+	for (i = 0; i < BOARD_WIDTH; i++)
+		for (j = 0; j < BOARD_HEIGHT; j++)
+			if (board_get_block(b, i, j) == BLOCK_NIBBLET || board_get_block(b, i, j) == BLOCK_NIBBLOON) {
+				p->nib_dist[i][j] = 0;
+				queue[queue_len++] = (Uint16) (i + j*BOARD_WIDTH);
+			}
+	planner_spread_distance(b, p->nib_dist, queue, queue_len);
+
+	if (b->fruit.is_visible && !b->fruit.ghost_score_amount) {
+		p->fruit_x = GET_BLOCK_FIXED(b->fruit.loc.x);
+		p->fruit_y = GET_BLOCK_FIXED(b->fruit.loc.y);
+	} else {
+		p->fruit_x = p->fruit_y = PLANNER_NONE;
+	}
+
+	memset(p->visits, 0, sizeof(p->visits));
+	p->is_prepared = 1;
+}
+
+/* Unmarks the first 'length' blocks of the given corridor as visited. */
+void planner_unmark_edge(Planner *p, PlannerEdge *e, int length)
+{
+	int i;
+
+	for (i = 0; i < length; i++) {
+		int block = p->path_pool[e->path_start + i];
+		p->visits[block % BOARD_WIDTH][block / BOARD_WIDTH]--;
+	}
+}
+
+/* Walks pac man down the given corridor, adding up the value of everything he finds
+   along the way into 'child' and marking the corridor's blocks as visited.  Returns 0
+   if a ghost would get him first, in which case 'child' holds the death penalty and
+   nothing is left marked. */
+int planner_walk_edge(Planner *p, Board *b, PlannerFrame *parent, PlannerEdge *e, PlannerFrame *child)
+{
+	int i, g;
+
+	child->value = parent->value;
+	child->time = parent->time;
+	child->ghosts_eaten = parent->ghosts_eaten;
+
+	for (i = 0; i < e->length; i++) {
+		int block = p->path_pool[e->path_start + i];
+		int x = block % BOARD_WIDTH;
+		int y = block / BOARD_WIDTH;
+		int t = ++child->time;
+
+		if (!p->visits[x][y]) {
+			if (board_get_block(b, x, y) == BLOCK_NIBBLET)
+				child->value += planner_discount(PLANNER_VALUE_NIBBLET, t);
+			else if (board_get_block(b, x, y) == BLOCK_NIBBLOON)
+				child->value += planner_discount(PLANNER_VALUE_NIBBLOON, t);
+			if (x == p->fruit_x && y == p->fruit_y)
+				child->value += planner_discount(PLANNER_VALUE_FRUIT, t);
+		}
+		p->visits[x][y]++;
+
+		for (g = 0; g < 4; g++) {
+			int dist = p->ghost_dist[g][x][y];
+
+			if (dist == PLANNER_UNREACHABLE || (child->ghosts_eaten & (1 << g)))
+				continue;
+			if (t < p->ghost_edible_blocks[g]) {
+				/* Chasing a fleeing ghost down: count it once it's within reach. */
+				if (dist <= t) {
+					child->ghosts_eaten |= (1 << g);
+					child->value += planner_discount(PLANNER_VALUE_GHOST, t);
+				}
+			} else if (p->ghost_is_threat[g] &&
+			           (fixed) dist * p->pman_speed <= (fixed) (t + PLANNER_GHOST_SAFETY_BLOCKS) * p->ghost_speed[g]) {
+				planner_unmark_edge(p, e, i+1);
+				child->value += t * PLANNER_VALUE_SURVIVAL - PLANNER_VALUE_DEATH;
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/* Remembers the value of a path that has come to an end. */
+void planner_record_leaf(Planner *p, PlannerFrame *leaf)
+{
+	if (leaf->value > p->iter_best[leaf->root_dir])
+		p->iter_best[leaf->root_dir] = leaf->value;
+}
+
+/* Returns the root direction with the best value in the current iteration, or
+   PLANNER_NONE if nothing has been found yet.  Ties go to carrying straight on. */
+int planner_iteration_best_dir(Planner *p)
+{
+	int d, best = PLANNER_NONE;
+
+	if (p->root_arrive_dir != PLANNER_NONE && p->iter_best[p->root_arrive_dir] != PLANNER_NO_VALUE)
+		best = p->root_arrive_dir;
+	for (d = 0; d < 4; d++)
+		if (p->iter_best[d] != PLANNER_NO_VALUE && (best == PLANNER_NONE || p->iter_best[d] > p->iter_best[best]))
+			best = d;
+	return best;
+}
+
+/* Returns whether the current frame's budget has run out. */
+int planner_frame_is_over(Planner *p)
+{
+	if (p->frame_expansions_left >= 0)
+		return p->frame_expansions_left == 0;
+	return game_get_microseconds() - p->frame_start_us >= p->frame_budget_us;
+}
+
+/* Thinks about the current junction until the frame's budget runs out or the
+   search can't go any deeper.  Each call picks up right where the last one left off. */
+void planner_think(Planner *p, Board *b)
+{
+	int expansions = 0;
+
+	if (p->root == PLANNER_NONE || planner_frame_is_over(p))
+		return;
+
+	/* If the search has gone as deep as it can and there's still time to spare,
+	   start over with fresh information about where the ghosts are. */
+	if (p->is_done) {
+		p->is_prepared = 0;
+		p->stack_depth = 0;
+		p->depth_limit = 0;
+		p->is_done = 0;
+	}
+
+	if (!p->is_prepared) planner_prepare(p, b);
+
+	while (1) {
+		PlannerFrame *f, *child;
+		PlannerNode *node;
+		PlannerEdge *e;
+		int d;
+
+		if (p->stack_depth == 0) {
+			/* Finished an iteration, so it's time to start a deeper one. */
+			if (p->depth_limit > 0 && p->depth_limit >= p->best_depth) {
+				p->best_dir = planner_iteration_best_dir(p);
+				p->best_depth = p->depth_limit;
+			}
+			if (p->depth_limit == PLANNER_MAX_DEPTH) {
+				p->is_done = 1;
+				return;
+			}
+			p->depth_limit++;
+			for (d = 0; d < 4; d++)
+				p->iter_best[d] = PLANNER_NO_VALUE;
+			f = &p->stack[0];
+			f->node = p->root;
+			f->arrive_dir = p->root_arrive_dir;
+			f->next_dir = 0;
+			f->root_dir = PLANNER_NONE;
+			f->value = f->time = f->ghosts_eaten = 0;
+			p->stack_depth = 1;
+		}
+
+		if (p->frame_expansions_left >= 0) {
+			if (p->frame_expansions_left == 0) return;
+			p->frame_expansions_left--;
+		} else if (++expansions % PLANNER_CLOCK_CHECK_INTERVAL == 0 && planner_frame_is_over(p)) {
+			return;
+		}
+
+		f = &p->stack[p->stack_depth-1];
+		if (f->next_dir == 4) {
+			/* Done with this junction, so back up to the one before. */
+			if (p->stack_depth > 1) {
+				PlannerFrame *parent = &p->stack[p->stack_depth-2];
+				e = &p->nodes[parent->node].edges[parent->next_dir-1];
+				planner_unmark_edge(p, e, e->length);
+			}
+			p->stack_depth--;
+			continue;
+		}
+
+		d = f->next_dir++;
+		node = &p->nodes[f->node];
+		e = &node->edges[d];
+		if (e->to == PLANNER_NONE) continue;
+		/* Pac man could turn around anywhere, but it's only worth considering at the
+		   junction we're planning for, or when there's no other way to go. */
+		if (p->stack_depth > 1 && d == board_dir_reverse[f->arrive_dir] &&
+		    planner_count_exits(b, node->x, node->y) > 1)
+			continue;
+
+		child = &p->stack[p->stack_depth];
+		child->root_dir = (p->stack_depth == 1) ? d : f->root_dir;
+		if (!planner_walk_edge(p, b, f, e, child)) {
+			planner_record_leaf(p, child);
+			continue;
+		}
+
+		if (p->stack_depth == p->depth_limit) {
+			/* As far as we look this time around; give the path some credit for
+			   how close it ends up to the nibs that are left. */
+			int end = p->path_pool[e->path_start + e->length - 1];
+			int dist = p->nib_dist[end % BOARD_WIDTH][end / BOARD_WIDTH];
+			if (dist != PLANNER_UNREACHABLE)
+				child->value += planner_discount(PLANNER_VALUE_NIBBLET, child->time + dist);
+			planner_record_leaf(p, child);
+			planner_unmark_edge(p, e, e->length);
+			continue;
+		}
+
+		child->node = e->to;
+		child->arrive_dir = e->arrive_dir;
+		child->next_dir = 0;
+		p->stack_depth++;
+	}
+}
+
+/* Starts the clock on a frame's worth of thinking.  All calls to planner_think()
+   until the next call to this function share the given budget.  If
+   budget_expansions isn't 0, the budget is that many junction expansions
+   instead of budget_us microseconds, so that the planner thinks just as far on
+   any machine. */
+void planner_start_frame(Planner *p, Uint32 budget_us, int budget_expansions)
+{
+	p->frame_start_us = game_get_microseconds();
+	p->frame_budget_us = budget_us;
+	p->frame_expansions_left = budget_expansions ? budget_expansions : -1;
+}
+
+/* Returns the DIRECTION_* constant pac man should take out of the junction he's
+   arrived at, or PLANNER_NONE if the planner has no idea. */
+int planner_choose_move(Planner *p, Board *b, int x, int y, int dir)
+{
+	int best;
+
+	if (!planner_is_node(p, x, y)) return PLANNER_NONE;
+
+	/* If we weren't expecting to be here, make the most of what's left of the frame. */
+	if (p->node_at[x][y] != p->root) {
+		planner_begin(p, p->node_at[x][y], dir);
+		planner_think(p, b);
+	}
+
+	best = p->best_dir;
+	if (best == PLANNER_NONE && p->root != PLANNER_NONE && p->depth_limit > 0)
+		best = planner_iteration_best_dir(p);
+
+	return best;
+}
@@ -0,0 +1,165 @@
+#ifndef INCLUDE_PMAN_PLANNER
+#define INCLUDE_PMAN_PLANNER
+
+/* pman_planner.h
+
+   Time-sliced junction planner for AI-controlled pac man.
+
+   The board is reduced to a graph whose nodes are junctions (and dead ends) and
+   whose edges are the corridors between them.  Whenever pac man leaves a junction,
+   the planner starts an iterative-deepening search from the NEXT junction he will
+   reach, weighing the nibs, fruit and ghosts along every path a few junctions
+   ahead.  The search is resumable: planner_think() works for at most a given
+   number of microseconds and picks up where it left off on the next frame, and
+   when pac man finally reaches the junction, the best move found so far is used.
+*/
+
+#include <limits.h>
+
+#include "SDL.h"
+
+#include "pman_board.h"
+
+/* Maximum number of junctions on the board. */
+#define PLANNER_MAX_NODES 200
+
+/* Size of the pool that stores the blocks of every corridor (each corridor is
+   stored once for each direction it can be travelled in). */
+#define PLANNER_PATH_POOL_SIZE (BOARD_WIDTH*BOARD_HEIGHT*2)
+
+/* Deepest the search will go, in junctions. */
+#define PLANNER_MAX_DEPTH 8
+
+/* Number of microseconds per frame the planner is allowed to think for. */
+#define PLANNER_FRAME_BUDGET_US 500
+
+/* Number of junctions the planner expands per frame instead when it's on a
+   fixed budget (see planner_start_frame()), which is about what it gets through
+   in PLANNER_FRAME_BUDGET_US. */
+#define PLANNER_FRAME_BUDGET_EXPANSIONS 500
+
+/* Number of junctions expanded between each look at the clock. */
+#define PLANNER_CLOCK_CHECK_INTERVAL 4
+
+/* The PLANNER_VALUE_* constants are how much the planner thinks each thing it
+   finds along a path is worth. */
+#define PLANNER_VALUE_NIBBLET  10
+#define PLANNER_VALUE_NIBBLOON 50
+#define PLANNER_VALUE_FRUIT    200
+#define PLANNER_VALUE_GHOST    300
+#define PLANNER_VALUE_DEATH    100000
+
+/* Values of things found this many blocks away are worth half as much. */
+#define PLANNER_DISCOUNT_BLOCKS 32
+
+/* A ghost that can reach a block within this many blocks of pac man's arrival
+   there is considered deadly. */
+#define PLANNER_GHOST_SAFETY_BLOCKS 2
+
+/* How much each block pac man survives for is worth on a path where a ghost
+   eventually gets him (so that, if every path is deadly, he runs for longest). */
+#define PLANNER_VALUE_SURVIVAL 100
+
+/* Marks a missing junction, direction, or value, or a distance that can't be reached. */
+#define PLANNER_NONE -1
+#define PLANNER_NO_VALUE INT_MIN
+#define PLANNER_UNREACHABLE 255
+
+/* A corridor leading out of a junction in a given direction. */
+typedef struct PlannerEdge {
+	/* The junction at the other end, or PLANNER_NONE if there's a wall this way. */
+	int to;
+	/* Length of the corridor, in blocks. */
+	int length;
+	/* Index of the corridor's first block in the path pool.  The corridor's blocks
+	   don't include the junction it starts at, but do include the one it ends at. */
+	int path_start;
+	/* Direction pac man is heading in when he arrives at the other end. */
+	int arrive_dir;
+} PlannerEdge;
+
+/* A junction (or dead end) on the board. */
+typedef struct PlannerNode {
+	int x, y;
+	/* Corridors out of the junction, indexed by DIRECTION_* constant. */
+	PlannerEdge edges[4];
+} PlannerNode;
+
+/* One level of the planner's depth-first search stack. */
+typedef struct PlannerFrame {
+	/* Junction this frame is exploring out of. */
+	int node;
+	/* Direction pac man arrived at the junction in, or PLANNER_NONE at the root. */
+	int arrive_dir;
+	/* Next direction to try out of the junction. */
+	int next_dir;
+	/* Direction taken out of the root junction to get here. */
+	int root_dir;
+	/* Value of the path so far, and its length in blocks. */
+	int value;
+	int time;
+	/* Bitmask of ghosts already eaten along the path so far. */
+	int ghosts_eaten;
+} PlannerFrame;
+
+/* The planner. */
+typedef struct Planner {
+	/* The junction graph.  node_at[][] gives the junction at each block. */
+	PlannerNode nodes[PLANNER_MAX_NODES];
+	int num_nodes;
+	int node_at[BOARD_WIDTH][BOARD_HEIGHT];
+	Uint16 path_pool[PLANNER_PATH_POOL_SIZE];
+	int path_pool_used;
+
+	/* Junction the current search is for (PLANNER_NONE if there's no search), and
+	   the direction pac man will arrive at it in. */
+	int root;
+	int root_arrive_dir;
+	/* Whether the distance fields below have been set up for the current search. */
+	int is_prepared;
+
+	/* Distance in blocks from each block to each ghost, and to the nearest nib. */
+	Uint8 ghost_dist[4][BOARD_WIDTH][BOARD_HEIGHT];
+	Uint8 nib_dist[BOARD_WIDTH][BOARD_HEIGHT];
+	/* Ghost speeds and pac man's speed as they were when the search started. */
+	fixed ghost_speed[4];
+	fixed pman_speed;
+	/* Per-ghost flags: whether it's a threat, and for how many blocks it stays edible. */
+	int ghost_is_threat[4];
+	int ghost_edible_blocks[4];
+	/* Fruit block, or PLANNER_NONE if the fruit isn't out. */
+	int fruit_x, fruit_y;
+
+	/* Number of times each block has been counted along the current path. */
+	Uint8 visits[BOARD_WIDTH][BOARD_HEIGHT];
+
+	/* Depth-first search state for the current iteration of iterative deepening. */
+	PlannerFrame stack[PLANNER_MAX_DEPTH+1];
+	int stack_depth;
+	int depth_limit;
+	/* Best value found for each root direction in the current iteration. */
+	int iter_best[4];
+	/* Best root direction out of the last completed iteration, or PLANNER_NONE. */
+	int best_dir;
+	/* Depth of the iteration best_dir came from.  A refreshed search only replaces
+	   best_dir once it has looked at least this deep. */
+	int best_depth;
+	/* Whether the search has gone as deep as it can. */
+	int is_done;
+
+	/* When the current frame's thinking started, and how long it may go on for. */
+	Uint32 frame_start_us;
+	Uint32 frame_budget_us;
+	/* Number of junctions the current frame may still expand, or -1 if it's
+	   going by the clock. */
+	int frame_expansions_left;
+} Planner;
+
+void planner_init(Planner *p, Board *b);
+int planner_is_node(Planner *p, int x, int y);
+void planner_look_ahead(Planner *p, Board *b, int x, int y, int dir);
+void planner_start_frame(Planner *p, Uint32 budget_us, int budget_expansions);
+void planner_think(Planner *p, Board *b);
+int planner_choose_move(Planner *p, Board *b, int x, int y, int dir);
+
+#endif
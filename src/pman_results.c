@@ -0,0 +1,487 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "SDL.h"
+
+#include "debug.h"
+#include "pman_results.h"
+
+/* Rounds the given size up to a multiple of RESULTS_ALIGN. */
+#define RESULTS_ROUND_UP(x) (((x) + RESULTS_ALIGN - 1) & ~(RESULTS_ALIGN - 1))
+
+/* Size of the start of a block (its ResultsBlock and column offsets) in a file
+   with the given number of columns. */
+#define RESULTS_BLOCK_HEADER_SIZE(num_columns) RESULTS_ROUND_UP(sizeof(ResultsBlock) + sizeof(Uint32) * (num_columns))
+
+/* Returns whether the given block, whose column offsets are the given ones
+   and which has the given number of bytes of file left from its start, is a
+   whole, sane block of a file with the given columns. */
+int results_is_valid_block(const ResultsBlock *blk, const Uint32 offsets[], size_t avail, const ResultsColumn columns[], int num_columns)
+{
+	int i;
+
+	if (blk->magic != RESULTS_BLOCK_MAGIC || blk->size > avail || blk->num_rows > RESULTS_BLOCK_ROWS)
+		return 0;
+	for (i = 0; i < num_columns; i++) {
+		if (offsets[i] % RESULTS_ALIGN != 0 || offsets[i] < RESULTS_BLOCK_HEADER_SIZE(num_columns) ||
+			offsets[i] > blk->size || blk->num_rows * columns[i].width > blk->size - offsets[i])
+			return 0;
+	}
+	return 1;
+}
+
+/* Returns whether the given header and column descriptions make sense. */
+int results_is_valid_header(const ResultsHeader *h, const ResultsColumn columns[])
+{
+	int i;
+
+	if (h->magic != RESULTS_MAGIC || h->version != RESULTS_VERSION ||
+		h->num_columns == 0 || h->num_columns > RESULTS_MAX_COLUMNS ||
+		h->size != sizeof(ResultsHeader) + sizeof(ResultsColumn) * h->num_columns)
+		return 0;
+	for (i = 0; i < (int) h->num_columns; i++) {
+		if (columns[i].width != sizeof(Uint32) || memchr(columns[i].name, 0, RESULTS_NAME_SIZE) == NULL)
+			return 0;
+	}
+	return 1;
+}
+
+/* Opens the results file at the given path for appending rows with the given
+   columns, creating it if it doesn't exist.  Any block that was cut short at
+   its end is dropped.  Returns NULL if the file can't be opened, or already has
+   different columns. */
+ResultsWriter *results_open(const char *path, const ResultsColumn columns[], int num_columns)
+{
+	ResultsWriter *w;
+	ResultsHeader h;
+	ResultsBlock blk;
+	Uint32 offsets[RESULTS_MAX_COLUMNS];
+	long ofs, end;
+
+	if (num_columns <= 0 || num_columns > RESULTS_MAX_COLUMNS) return NULL;
+
+	w = (ResultsWriter *) malloc(sizeof(ResultsWriter));
+	if (!w) return NULL;
+	w->values = (Uint32 *) malloc(sizeof(Uint32) * RESULTS_BLOCK_ROWS * num_columns);
+	if (!w->values) {
+		free(w);
+		return NULL;
+	}
+	w->num_columns = num_columns;
+	memset(w->columns, 0, sizeof(w->columns));
+	memcpy(w->columns, columns, sizeof(ResultsColumn) * num_columns);
+	w->num_rows = 0;
+
+	h.magic = RESULTS_MAGIC;
+	h.version = RESULTS_VERSION;
+	h.num_columns = (Uint32) num_columns;
+	h.size = sizeof(ResultsHeader) + sizeof(ResultsColumn) * num_columns;
+
+	w->f = fopen(path, "r+b");
+	if (w->f) {
+		ResultsHeader old;
+		ResultsColumn old_columns[RESULTS_MAX_COLUMNS];
+
+		if (fread(&old, sizeof(old), 1, w->f) != 1 || memcmp(&old, &h, sizeof(h)) != 0 ||
+			fread(old_columns, sizeof(ResultsColumn), num_columns, w->f) != (size_t) num_columns ||
+			memcmp(old_columns, w->columns, sizeof(ResultsColumn) * num_columns) != 0) {
+			fclose(w->f);
+			free(w->values);
+			free(w);
+			return NULL;
+		}
+
+		/* Find the end of the last whole block. */
+		fseek(w->f, 0, SEEK_END);
+		end = ftell(w->f);
+		ofs = (long) h.size;
+		while (fseek(w->f, ofs, SEEK_SET) == 0 &&
+			fread(&blk, sizeof(blk), 1, w->f) == 1 &&
+			fread(offsets, sizeof(Uint32), num_columns, w->f) == (size_t) num_columns &&
+			results_is_valid_block(&blk, offsets, (size_t) (end - ofs), w->columns, num_columns)) {
+			ofs += (long) blk.size;
+		}
+		fflush(w->f);
+#ifndef WIN32
+		if (ofs < end && ftruncate(fileno(w->f), ofs) < 0) {
+			fclose(w->f);
+			free(w->values);
+			free(w);
+			return NULL;
+		}
+#endif
+		fseek(w->f, ofs, SEEK_SET);
+		return w;
+	}
+
+	w->f = fopen(path, "wb");
+	if (!w->f || fwrite(&h, sizeof(h), 1, w->f) != 1 ||
+		fwrite(w->columns, sizeof(ResultsColumn), num_columns, w->f) != (size_t) num_columns) {
+		if (w->f) fclose(w->f);
+		free(w->values);
+		free(w);
+		return NULL;
+	}
+	return w;
+}
+
+/* Writes the rows gathered so far out as a block.  Returns nonzero on success. */
+int results_flush_block(ResultsWriter *w)
+{
+	static const Uint8 zeros[RESULTS_ALIGN];
+	ResultsBlock blk;
+	Uint32 offsets[RESULTS_MAX_COLUMNS];
+	Uint32 header_size = RESULTS_BLOCK_HEADER_SIZE(w->num_columns);
+	Uint32 column_size = RESULTS_ROUND_UP(w->num_rows * sizeof(Uint32));
+	int i, ok;
+
+	if (w->num_rows == 0) return 1;
+
+	blk.magic = RESULTS_BLOCK_MAGIC;
+	blk.num_rows = (Uint32) w->num_rows;
+	blk.size = header_size + column_size * w->num_columns;
+	blk.reserved = 0;
+	for (i = 0; i < w->num_columns; i++) {
+		offsets[i] = header_size + column_size * i;
+	}
+
+	ok = fwrite(&blk, sizeof(blk), 1, w->f) == 1 &&
+		fwrite(offsets, sizeof(Uint32), w->num_columns, w->f) == (size_t) w->num_columns &&
+		fwrite(zeros, 1, header_size - sizeof(blk) - sizeof(Uint32) * w->num_columns, w->f) ==
+			header_size - sizeof(blk) - sizeof(Uint32) * w->num_columns;
+	for (i = 0; i < w->num_columns && ok; i++) {
+		ok = fwrite(w->values + i * RESULTS_BLOCK_ROWS, sizeof(Uint32), w->num_rows, w->f) == (size_t) w->num_rows &&
+			fwrite(zeros, 1, column_size - w->num_rows * sizeof(Uint32), w->f) == column_size - w->num_rows * sizeof(Uint32);
+	}
+
+	w->num_rows = 0;
+	return ok && fflush(w->f) == 0;
+}
+
+/* Appends a row to the file, with one value per column (signed values just
+   cast to Uint32).  Rows are written out a block at a time. */
+void results_append(ResultsWriter *w, const Uint32 row[])
+{
+	int i;
+
+	for (i = 0; i < w->num_columns; i++) {
+		w->values[i * RESULTS_BLOCK_ROWS + w->num_rows] = row[i];
+	}
+	if (++w->num_rows == RESULTS_BLOCK_ROWS) {
+		if (!results_flush_block(w)) err("Couldn't write results block.\n", 1);
+	}
+}
+
+/* Writes out any rows that are left, and closes the file.  Returns nonzero on
+   success. */
+int results_close(ResultsWriter *w)
+{
+	int ok;
+
+	ok = results_flush_block(w);
+	if (fclose(w->f) != 0) ok = 0;
+	free(w->values);
+	free(w);
+	return ok;
+}
+
+/* Maps the results file at the given path into memory, or returns NULL if it
+   can't be read or isn't a results file. */
+ResultsFile *results_map(const char *path)
+{
+	ResultsFile *rf;
+	const ResultsHeader *h;
+	size_t ofs;
+	int capacity = 16;
+
+	rf = (ResultsFile *) malloc(sizeof(ResultsFile));
+	if (!rf) return NULL;
+
+#ifndef WIN32
+	{
+		struct stat st;
+		int fd = open(path, O_RDONLY);
+
+		if (fd < 0) {
+			free(rf);
+			return NULL;
+		}
+		if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(ResultsHeader)) {
+			close(fd);
+			free(rf);
+			return NULL;
+		}
+		rf->size = (size_t) st.st_size;
+		rf->base = (Uint8 *) mmap(NULL, rf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (rf->base == MAP_FAILED) {
+			free(rf);
+			return NULL;
+		}
+	}
+#else
+	{
+		/* No mmap() here, so just read the whole thing in. */
+		FILE *f = fopen(path, "rb");
+		long size;
+
+		if (!f || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < (long) sizeof(ResultsHeader)) {
+			if (f) fclose(f);
+			free(rf);
+			return NULL;
+		}
+		rf->size = (size_t) size;
+		rf->base = (Uint8 *) malloc(rf->size);
+		fseek(f, 0, SEEK_SET);
+		if (!rf->base || fread(rf->base, 1, rf->size, f) != rf->size) {
+			fclose(f);
+			free(rf->base);
+			free(rf);
+			return NULL;
+		}
+		fclose(f);
+	}
+#endif
+
+	h = (const ResultsHeader *) rf->base;
+	rf->columns = (const ResultsColumn *) (rf->base + sizeof(ResultsHeader));
+	rf->blocks = NULL;
+	if (h->num_columns > RESULTS_MAX_COLUMNS ||
+		rf->size < sizeof(ResultsHeader) + sizeof(ResultsColumn) * h->num_columns ||
+		!results_is_valid_header(h, rf->columns)) {
+		results_unmap(rf);
+		return NULL;
+	}
+	rf->num_columns = (int) h->num_columns;
+
+	/* Index the whole blocks. */
+	rf->blocks = (const ResultsBlock **) malloc(sizeof(ResultsBlock *) * capacity);
+	rf->num_blocks = 0;
+	rf->num_rows = 0;
+	ofs = h->size;
+	while (rf->blocks && ofs + RESULTS_BLOCK_HEADER_SIZE(rf->num_columns) <= rf->size) {
+		const ResultsBlock *blk = (const ResultsBlock *) (rf->base + ofs);
+
+		if (!results_is_valid_block(blk, (const Uint32 *) (blk + 1), rf->size - ofs, rf->columns, rf->num_columns))
+			break;
+		if (rf->num_blocks == capacity) {
+			const ResultsBlock **blocks;
+
+			capacity *= 2;
+			blocks = (const ResultsBlock **) realloc((void *) rf->blocks, sizeof(ResultsBlock *) * capacity);
+			if (!blocks) break;
+			rf->blocks = blocks;
+		}
+		rf->blocks[rf->num_blocks++] = blk;
+		rf->num_rows += blk->num_rows;
+		ofs += blk->size;
+	}
+	if (!rf->blocks) {
+		results_unmap(rf);
+		return NULL;
+	}
+	return rf;
+}
+
+/* Unmaps a results file mapped by results_map(). */
+void results_unmap(ResultsFile *rf)
+{
+#ifndef WIN32
+	munmap(rf->base, rf->size);
+#else
+	free(rf->base);
+#endif
+	free((void *) rf->blocks);
+	free(rf);
+}
+
+/* Returns the index of the column with the given name, or -1 if there isn't one. */
+int results_find_column(const ResultsFile *rf, const char *name)
+{
+	int i;
+
+	for (i = 0; i < rf->num_columns; i++) {
+		if (strcmp(rf->columns[i].name, name) == 0) return i;
+	}
+	return -1;
+}
+
+/* Returns the values of the given column in the given block, and puts the
+   number of them in *num_rows. */
+const void *results_get_block_column(const ResultsFile *rf, int block, int column, Uint32 *num_rows)
+{
+	const ResultsBlock *blk = rf->blocks[block];
+
+	*num_rows = blk->num_rows;
+	return (const Uint8 *) blk + ((const Uint32 *) (blk + 1))[column];
+}
+
+/* Works out the count, sum, mean, minimum and maximum of the given column. */
+void results_column_stats(const ResultsFile *rf, int column, ResultsStats *stats)
+{
+	int b;
+	int is_signed = rf->columns[column].type == RESULTS_TYPE_SINT32;
+
+	stats->count = 0;
+	stats->sum = 0;
+	stats->min = 0;
+	stats->max = 0;
+
+	for (b = 0; b < rf->num_blocks; b++) {
+		Uint32 i, n;
+		const void *v = results_get_block_column(rf, b, column, &n);
+
+		if (n == 0) continue;
+
+		/* Branch-free loops over one array each, so that they vectorize. */
+		if (is_signed) {
+			const Sint32 *s = (const Sint32 *) v;
+			Sint64 sum = 0;
+			Sint32 lo = s[0], hi = s[0];
+
+			for (i = 0; i < n; i++) {
+				sum += s[i];
+				lo = s[i] < lo ? s[i] : lo;
+				hi = s[i] > hi ? s[i] : hi;
+			}
+			stats->sum += (double) sum;
+			if (stats->count == 0 || lo < stats->min) stats->min = lo;
+			if (stats->count == 0 || hi > stats->max) stats->max = hi;
+		} else {
+			const Uint32 *u = (const Uint32 *) v;
+			Uint64 sum = 0;
+			Uint32 lo = u[0], hi = u[0];
+
+			for (i = 0; i < n; i++) {
+				sum += u[i];
+				lo = u[i] < lo ? u[i] : lo;
+				hi = u[i] > hi ? u[i] : hi;
+			}
+			stats->sum += (double) sum;
+			if (stats->count == 0 || lo < stats->min) stats->min = lo;
+			if (stats->count == 0 || hi > stats->max) stats->max = hi;
+		}
+		stats->count += n;
+	}
+
+	stats->mean = stats->count ? stats->sum / stats->count : 0;
+}
+
+/* Works out the stats of the given column separately for each value 0 to
+   num_groups-1 of the given key column, into stats.  Rows whose key is outside
+   that range are left out. */
+void results_column_group_stats(const ResultsFile *rf, int column, int key_column, ResultsStats stats[], int num_groups)
+{
+	int b, g;
+	int is_signed = rf->columns[column].type == RESULTS_TYPE_SINT32;
+
+	memset(stats, 0, sizeof(ResultsStats) * num_groups);
+
+	for (b = 0; b < rf->num_blocks; b++) {
+		Uint32 i, n;
+		const Uint32 *keys = (const Uint32 *) results_get_block_column(rf, b, key_column, &n);
+		const void *v = results_get_block_column(rf, b, column, &n);
+
+		for (i = 0; i < n; i++) {
+			ResultsStats *st;
+			double x;
+
+			if (keys[i] >= (Uint32) num_groups) continue;
+			st = &stats[keys[i]];
+			x = is_signed ? (double) ((const Sint32 *) v)[i] : (double) ((const Uint32 *) v)[i];
+			if (st->count == 0 || x < st->min) st->min = x;
+			if (st->count == 0 || x > st->max) st->max = x;
+			st->sum += x;
+			st->count++;
+		}
+	}
+
+	for (g = 0; g < num_groups; g++) {
+		stats[g].mean = stats[g].count ? stats[g].sum / stats[g].count : 0;
+	}
+}
+
+/* Comparison function for qsort()ing doubles. */
+int results_compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/* Works out n percentiles of the given column (nearest rank, so that each one
+   is a value that's actually in the column), one for each of the given
+   percentages, into out.  They're all 0 if the file has no rows. */
+void results_column_percentiles(const ResultsFile *rf, int column, const double percents[], double out[], int n)
+{
+	double *sorted;
+	Uint32 count = 0;
+	int b, i;
+
+	sorted = rf->num_rows ? (double *) malloc(sizeof(double) * rf->num_rows) : NULL;
+	if (!sorted) {
+		for (i = 0; i < n; i++) out[i] = 0;
+		if (rf->num_rows) err("Couldn't allocate percentile buffer.\n", 0);
+		return;
+	}
+
+	for (b = 0; b < rf->num_blocks; b++) {
+		Uint32 j, rows;
+		const void *v = results_get_block_column(rf, b, column, &rows);
+
+		if (rf->columns[column].type == RESULTS_TYPE_SINT32) {
+			for (j = 0; j < rows; j++) sorted[count + j] = ((const Sint32 *) v)[j];
+		} else {
+			for (j = 0; j < rows; j++) sorted[count + j] = ((const Uint32 *) v)[j];
+		}
+		count += rows;
+	}
+	qsort(sorted, count, sizeof(double), results_compare_doubles);
+
+	for (i = 0; i < n; i++) {
+		double rank = percents[i] / 100.0 * count;
+		Uint32 k = rank > 0 ? (Uint32) rank : 0;
+
+		/* The rank-th smallest value, rounding the rank up. */
+		if (k < rank) k++;
+		if (k > 0) k--;
+		out[i] = sorted[k < count ? k : count - 1];
+	}
+	free(sorted);
+}
+
+/* Counts how many times each of the values 0 to num_bins-1 appears in the
+   given column, into counts.  Smaller values are counted as 0, and bigger ones
+   as num_bins-1. */
+void results_column_histogram(const ResultsFile *rf, int column, Uint32 counts[], int num_bins)
+{
+	int b;
+
+	memset(counts, 0, sizeof(Uint32) * num_bins);
+	for (b = 0; b < rf->num_blocks; b++) {
+		Uint32 i, n;
+		const void *v = results_get_block_column(rf, b, column, &n);
+
+		if (rf->columns[column].type == RESULTS_TYPE_SINT32) {
+			const Sint32 *s = (const Sint32 *) v;
+
+			for (i = 0; i < n; i++)
+				counts[s[i] < 0 ? 0 : (s[i] >= num_bins ? num_bins - 1 : s[i])]++;
+		} else {
+			const Uint32 *u = (const Uint32 *) v;
+
+			for (i = 0; i < n; i++)
+				counts[u[i] >= (Uint32) num_bins ? num_bins - 1 : u[i]]++;
+		}
+	}
+}
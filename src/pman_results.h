@@ -0,0 +1,120 @@
+#ifndef INCLUDE_PMAN_RESULTS
+#define INCLUDE_PMAN_RESULTS
+
+/* pman_results.h
+
+   Columnar results files, for the statistics of batch runs (see pman_batch.h)
+   and anything else that comes in millions of rows of fixed-width numbers.
+
+   A results file is a ResultsHeader naming its columns, followed by any number
+   of blocks of rows.  Each block starts with a ResultsBlock that says how many
+   rows it has and where each of its columns starts, followed by the columns
+   themselves:  each one a plain array of 32-bit values, one per row, starting
+   on a RESULTS_ALIGN boundary.  Files are only ever appended to, a block at a
+   time, so a block that was cut short (by a crash, say) can only be the last
+   one, and is ignored by readers and dropped by the next writer.
+
+   Readers map the whole file into memory, and work on a column a block at a
+   time, so that a scan over a column never touches any of the others and is a
+   straight run over an array that the compiler can vectorize.  Everything is
+   in the host's byte order.
+*/
+
+#include <stdio.h>
+
+#include "SDL.h"
+
+/* Value of ResultsHeader.magic and ResultsBlock.magic. */
+#define RESULTS_MAGIC       0x4c4f4350
+#define RESULTS_BLOCK_MAGIC 0x4b4c4250
+
+/* Version of the format in ResultsHeader.version. */
+#define RESULTS_VERSION 1
+
+/* Most columns a file can have, and most characters in a column's name
+   (including the terminating NUL). */
+#define RESULTS_MAX_COLUMNS 32
+#define RESULTS_NAME_SIZE   24
+
+/* Most rows a writer puts in one block. */
+#define RESULTS_BLOCK_ROWS 65536
+
+/* Every column in a block starts on a multiple of this many bytes. */
+#define RESULTS_ALIGN 16
+
+/* The RESULTS_TYPE_* constants are the kinds of value a column can hold. */
+#define RESULTS_TYPE_SINT32 1
+#define RESULTS_TYPE_UINT32 2
+
+/* Description of one column. */
+typedef struct ResultsColumn {
+	char name[RESULTS_NAME_SIZE];
+	/* RESULTS_TYPE_* constant. */
+	Uint32 type;
+	/* Size of each value, in bytes (always 4 for now). */
+	Uint32 width;
+} ResultsColumn;
+
+/* The start of a results file.  It's followed by num_columns ResultsColumns. */
+typedef struct ResultsHeader {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 num_columns;
+	/* Size of the header and the column descriptions, i.e. offset of the first block. */
+	Uint32 size;
+} ResultsHeader;
+
+/* The start of a block.  It's followed by the offset of each column from the
+   start of the block, one Uint32 per column, then the columns. */
+typedef struct ResultsBlock {
+	Uint32 magic;
+	Uint32 num_rows;
+	/* Size of the whole block, i.e. offset of the next one. */
+	Uint32 size;
+	Uint32 reserved;
+} ResultsBlock;
+
+/* A results file being appended to. */
+typedef struct ResultsWriter {
+	FILE *f;
+	int num_columns;
+	ResultsColumn columns[RESULTS_MAX_COLUMNS];
+	/* The rows of the block that's being filled in, a column at a time. */
+	Uint32 *values;
+	int num_rows;
+} ResultsWriter;
+
+/* A results file mapped into memory. */
+typedef struct ResultsFile {
+	Uint8 *base;
+	size_t size;
+	int num_columns;
+	const ResultsColumn *columns;
+	/* Start of each whole block, and the total number of rows in them. */
+	const ResultsBlock **blocks;
+	int num_blocks;
+	Uint32 num_rows;
+} ResultsFile;
+
+/* Aggregates of a column, from results_column_stats(). */
+typedef struct ResultsStats {
+	Uint32 count;
+	double sum;
+	double mean;
+	double min, max;
+} ResultsStats;
+
+ResultsWriter *results_open(const char *path, const ResultsColumn columns[], int num_columns);
+void results_append(ResultsWriter *w, const Uint32 row[]);
+int results_close(ResultsWriter *w);
+
+ResultsFile *results_map(const char *path);
+void results_unmap(ResultsFile *rf);
+int results_find_column(const ResultsFile *rf, const char *name);
+const void *results_get_block_column(const ResultsFile *rf, int block, int column, Uint32 *num_rows);
+void results_column_stats(const ResultsFile *rf, int column, ResultsStats *stats);
+void results_column_percentiles(const ResultsFile *rf, int column, const double percents[], double out[], int n);
+void results_column_group_stats(const ResultsFile *rf, int column, int key_column, ResultsStats stats[], int num_groups);
+void results_column_histogram(const ResultsFile *rf, int column, Uint32 counts[], int num_bins);
+
+#endif
@@ -0,0 +1,513 @@
+#include "globals.h"
+
+#include <assert.h>
+
+#include "SDL.h"
+
+#include "game.h"
+#include "fixed.h"
+#include "drawing.h"
+#include "pman_board.h"
+#include "pman_agent.h"
+#include "pman_agent_ghost.h"
+#include "pman_score.h"
+#include "pman_rollout.h"
+#include "pman_rollout_batch.h"
+#include "pman_tune.h"
+#include "workers.h"
+
+/* The directions to the right and left of each DIRECTION_* constant. */
+static const int g_rollout_right[4] = { DIRECTION_RIGHT, DIRECTION_LEFT, DIRECTION_UP, DIRECTION_DOWN };
+static const int g_rollout_left[4] = { DIRECTION_LEFT, DIRECTION_RIGHT, DIRECTION_DOWN, DIRECTION_UP };
+
+/* Everything one worker thread needs to make its vote. */
+typedef struct RolloutJob {
+	/* The world to play rollouts from. */
+	RolloutWorld root;
+	/* Seed for the rollouts' random number generators. */
+	Uint32 seed;
+	/* When the worker started, and how long it has, or, if budget_rollouts isn't
+	   0, how many rollouts it plays instead. */
+	Uint32 start_us;
+	Uint32 budget_us;
+	int budget_rollouts;
+	/* Total value and number of rollouts for each direction out of the junction. */
+	int total[4];
+	int count[4];
+	/* The direction the worker votes for, or ROLLOUT_NO_DIRECTION. */
+	int vote;
+	/* The rollouts being played, and the worlds they start from. */
+	RolloutBatch batch;
+	RolloutWorld starts[ROLLOUT_BATCH_SIZE];
+} RolloutJob;
+
+/* The worker threads, and the job each one votes from. */
+static int g_rollout_max_threads = ROLLOUT_MAX_THREADS;
+static WorkerPool g_rollout_workers;
+static RolloutJob g_rollout_jobs[ROLLOUT_MAX_THREADS];
+
+/* The level the workers are playing on.  Only written while they're idle. */
+static RolloutLevel g_rollout_level;
+
+/* Returns whether the given block can be moved through. */
+int rollout_is_open(const RolloutLevel *l, int x, int y)
+{
+	if (y < 0 || y >= BOARD_HEIGHT) return 0;
+	return l->is_open[board_wrap_x(x)][y];
+}
+
+/* Returns whether the given agent can move one block in the given direction. */
+int rollout_can_move(const RolloutLevel *l, const RolloutAgent *a, int dir)
+{
+	if (dir == ROLLOUT_NO_DIRECTION) return 0;
+	return rollout_is_open(l, a->x + board_dir_dx[dir], a->y + board_dir_dy[dir]);
+}
+
+/* Returns a random number in the range 0 <= n < max_int from the world's own
+   random number generator. */
+int rollout_rand_int(RolloutWorld *w, int max_int)
+{
+	w->rand_state = w->rand_state * 1664525 + 1013904223;
+	return (int) (((w->rand_state >> 16) * (Uint32) max_int) >> 16);
+}
+
+/* Picks a random direction for the given agent that it can move in, isn't the
+   reverse of the way it's going, and isn't in the given bitmask of directions to
+   avoid.  Returns ROLLOUT_NO_DIRECTION if there's no such direction. */
+int rollout_random_dir(RolloutWorld *w, const RolloutLevel *l, const RolloutAgent *a, int avoid_mask)
+{
+	int dirs[4];
+	int num_dirs = 0;
+	int d;
+
+	for (d = 0; d < 4; d++) {
+		if (a->dir != ROLLOUT_NO_DIRECTION && d == board_dir_reverse[a->dir]) continue;
+		if ((avoid_mask & (1 << d)) || !rollout_can_move(l, a, d)) continue;
+		dirs[num_dirs++] = d;
+	}
+	if (num_dirs == 0) return ROLLOUT_NO_DIRECTION;
+	return dirs[rollout_rand_int(w, num_dirs)];
+}
+
+/* Returns whether the given ghost can see pac man down the corridor in the given direction. */
+int rollout_ghost_can_see_pman(RolloutWorld *w, const RolloutLevel *l, const RolloutAgent *a, int dir)
+{
+	int x = a->x;
+	int y = a->y;
+	int i;
+
+	for (i = 0; i < ROLLOUT_GHOST_SIGHT_BLOCKS; i++) {
+		x = board_wrap_x(x + board_dir_dx[dir]);
+		y += board_dir_dy[dir];
+		if (!rollout_is_open(l, x, y)) return 0;
+		if (x == w->pman.x && y == w->pman.y) return 1;
+	}
+	return 0;
+}
+
+/* Decides which way the given agent goes from the block it's on, following the
+   same rules as the real game agents. */
+void rollout_agent_choose(RolloutWorld *w, const RolloutLevel *l, RolloutAgent *a)
+{
+	int dir, seen_mask, d;
+
+	if (a == &w->pman) {
+		if (w->pman_is_random) {
+			dir = rollout_random_dir(w, l, a, 0);
+			if (dir == ROLLOUT_NO_DIRECTION && a->dir != ROLLOUT_NO_DIRECTION)
+				dir = board_dir_reverse[a->dir];
+			a->dir = dir;
+		} else if (rollout_can_move(l, a, a->next_dir)) {
+			a->dir = a->next_dir;
+			a->next_dir = ROLLOUT_NO_DIRECTION;
+		}
+		return;
+	}
+
+	if (a->dir == ROLLOUT_NO_DIRECTION) {
+		a->dir = rollout_random_dir(w, l, a, 0);
+		return;
+	}
+
+	/* Ghosts look ahead, right and left for pac man.  Chasing ghosts go towards
+	   him; fleeing ones go anywhere else. */
+	seen_mask = 0;
+	if (rollout_ghost_can_see_pman(w, l, a, a->dir)) seen_mask |= 1 << a->dir;
+	d = g_rollout_right[a->dir];
+	if (rollout_ghost_can_see_pman(w, l, a, d)) seen_mask |= 1 << d;
+	d = g_rollout_left[a->dir];
+	if (rollout_ghost_can_see_pman(w, l, a, d)) seen_mask |= 1 << d;
+
+	if (a->state == ROLLOUT_GHOST_CHASING && seen_mask) {
+		for (d = 0; d < 4; d++)
+			if (seen_mask & (1 << d)) a->dir = d;
+		return;
+	}
+
+	dir = rollout_random_dir(w, l, a, (a->state == ROLLOUT_GHOST_FLEEING) ? seen_mask : 0);
+	if (dir == ROLLOUT_NO_DIRECTION) dir = rollout_random_dir(w, l, a, 0);
+	a->dir = (dir != ROLLOUT_NO_DIRECTION) ? dir : board_dir_reverse[a->dir];
+}
+
+/* Eats whatever nib is on pac man's block. */
+void rollout_pman_eat(RolloutWorld *w, const RolloutLevel *l)
+{
+	int bit = w->pman.x + w->pman.y*BOARD_WIDTH;
+	Uint32 mask = (Uint32) 1 << (bit & 31);
+	int g;
+
+	if (!(w->nibs[bit >> 5] & mask)) return;
+
+	w->nibs[bit >> 5] &= ~mask;
+	w->nibs_left--;
+
+	if (w->nibbloons[bit >> 5] & mask) {
+		w->score += g_tunables.score_nibbloon_score;
+		w->ghosts_eaten = 0;
+		for (g = 0; g < 4; g++) {
+			RolloutAgent *a = &w->ghosts[g];
+
+			if (a->state != ROLLOUT_GHOST_CHASING && a->state != ROLLOUT_GHOST_FLEEING) continue;
+			a->state = ROLLOUT_GHOST_FLEEING;
+			a->timer = l->flee_time;
+			if (a->dir != ROLLOUT_NO_DIRECTION) {
+				a->dir = board_dir_reverse[a->dir];
+				a->progress = 0;
+			}
+		}
+	} else {
+		w->score += g_tunables.score_nibblet_score;
+	}
+
+	if (w->nibs_left == 0) {
+		w->score += ROLLOUT_LEVEL_BONUS;
+		w->is_over = 1;
+	}
+}
+
+/* Moves the given agent along for the given amount of time. */
+void rollout_agent_advance(RolloutWorld *w, const RolloutLevel *l, RolloutAgent *a, fixed speed, Uint32 time)
+{
+	if (!rollout_can_move(l, a, a->dir)) {
+		rollout_agent_choose(w, l, a);
+		if (!rollout_can_move(l, a, a->dir)) {
+			a->progress = 0;
+			return;
+		}
+	}
+
+	a->progress += speed * (fixed) time;
+	while (a->progress >= FIXED_SET_INT(BLOCK_SIZE)) {
+		a->progress -= FIXED_SET_INT(BLOCK_SIZE);
+		a->x = board_wrap_x(a->x + board_dir_dx[a->dir]);
+		a->y += board_dir_dy[a->dir];
+		if (a == &w->pman) rollout_pman_eat(w, l);
+		rollout_agent_choose(w, l, a);
+		if (!rollout_can_move(l, a, a->dir)) {
+			a->progress = 0;
+			return;
+		}
+	}
+}
+
+/* Brings a ghost out of the asylum, right above the door. */
+void rollout_ghost_release(RolloutWorld *w, RolloutAgent *a)
+{
+	a->x = BLOCK_ASYLUM_CENTER_X;
+	a->y = BLOCK_ASYLUM_ENTER_Y;
+	a->dir = rollout_rand_int(w, 2) ? DIRECTION_LEFT : DIRECTION_RIGHT;
+	a->progress = 0;
+	a->state = ROLLOUT_GHOST_CHASING;
+	a->timer = 0;
+}
+
+/* Advances the given ghost by the given number of ms, as part of a step of the
+   world in which pac man started out on block (pman_x, pman_y). */
+void rollout_ghost_step(RolloutWorld *w, const RolloutLevel *l, RolloutAgent *a, int pman_x, int pman_y, Uint32 time)
+{
+	int ghost_x = a->x;
+	int ghost_y = a->y;
+
+	switch (a->state) {
+		case ROLLOUT_GHOST_FLEEING:
+			a->timer -= time;
+			if (a->timer <= 0) a->state = ROLLOUT_GHOST_CHASING;
+			rollout_agent_advance(w, l, a, FIXED_MULT(a->speed, l->flee_speed_multiplier), time);
+			break;
+		case ROLLOUT_GHOST_CHASING:
+			rollout_agent_advance(w, l, a, a->speed, time);
+			break;
+		default:
+			a->timer -= time;
+			if (a->timer <= 0) rollout_ghost_release(w, a);
+			return;
+	}
+
+	/* Pac man and the ghost collide if they're on the same block, or if they
+	   just went past each other. */
+	if ((a->x == w->pman.x && a->y == w->pman.y) ||
+	    (a->x == pman_x && a->y == pman_y && ghost_x == w->pman.x && ghost_y == w->pman.y)) {
+		if (a->state == ROLLOUT_GHOST_FLEEING) {
+			w->score += g_tunables.score_base_ghost_score << w->ghosts_eaten;
+			w->ghosts_eaten++;
+			a->state = ROLLOUT_GHOST_RETURNING;
+			a->timer = ROLLOUT_GHOST_RETURN_TIME;
+		} else {
+			w->is_over = 1;
+			w->is_dead = 1;
+		}
+	}
+}
+
+/* Advances the world by the given number of ms. */
+void rollout_world_step(RolloutWorld *w, const RolloutLevel *l, Uint32 time)
+{
+	int pman_x = w->pman.x;
+	int pman_y = w->pman.y;
+	int g;
+
+	if (w->is_over) return;
+	w->time += time;
+
+	rollout_agent_advance(w, l, &w->pman, w->pman.speed, time);
+
+	for (g = 0; g < 4 && !w->is_over; g++) {
+		rollout_ghost_step(w, l, &w->ghosts[g], pman_x, pman_y, time);
+	}
+}
+
+/* Sets up the parts of the given level that stay the same during play. */
+void rollout_level_init(RolloutLevel *l, Board *b, int level)
+{
+	int i, j;
+
+	for (i = 0; i < BOARD_WIDTH; i++)
+		for (j = 0; j < BOARD_HEIGHT; j++)
+			l->is_open[i][j] = (Uint8) (board_get_block(b, i, j) != BLOCK_WALL &&
+			                            board_get_block(b, i, j) != BLOCK_ASYLUM_DOOR &&
+			                            board_get_block(b, i, j) != BLOCK_ASYLUM_SPACE);
+
+	l->flee_time = g_tunables.ghost_flee_initial_time - (g_tunables.ghost_flee_less_time_per_level*level);
+	if (l->flee_time < 0) l->flee_time = 0;
+	l->flee_time += GHOST_FLEE_FLASH_TIMES*GHOST_FLEE_FLASH_DELAY;
+	l->flee_speed_multiplier = fixed_from_float(g_tunables.ghost_flee_speed_multiplier);
+}
+
+/* Captures the given agent's block, direction and speed. */
+void rollout_agent_capture(RolloutAgent *a, GameAgent *ga, fixed speed)
+{
+	a->x = board_wrap_x(GET_BLOCK(FIXED_GET_INT(ga->loc.x) + BLOCK_SIZE/2));
+	a->y = GET_BLOCK(FIXED_GET_INT(ga->loc.y) + BLOCK_SIZE/2);
+	if (a->y < 0) a->y = 0;
+	if (a->y >= BOARD_HEIGHT) a->y = BOARD_HEIGHT-1;
+	a->dir = map_fixed_vector_to_direction(&ga->curr_move);
+	a->next_dir = ROLLOUT_NO_DIRECTION;
+	a->progress = 0;
+	a->speed = speed;
+	a->state = ROLLOUT_GHOST_CHASING;
+	a->timer = 0;
+}
+
+/* Captures the given board into a rollout world. */
+void rollout_world_capture(RolloutWorld *w, Board *b, Uint32 seed)
+{
+	int i, j, g;
+
+	for (i = 0; i < ROLLOUT_BLOCK_WORDS; i++)
+		w->nibs[i] = w->nibbloons[i] = 0;
+	w->nibs_left = 0;
+	for (i = 0; i < BOARD_WIDTH; i++)
+		for (j = 0; j < BOARD_HEIGHT; j++) {
+			int bit = i + j*BOARD_WIDTH;
+
+			if (board_get_block(b, i, j) == BLOCK_NIBBLET || board_get_block(b, i, j) == BLOCK_NIBBLOON) {
+				w->nibs[bit >> 5] |= (Uint32) 1 << (bit & 31);
+				w->nibs_left++;
+			}
+			if (board_get_block(b, i, j) == BLOCK_NIBBLOON)
+				w->nibbloons[bit >> 5] |= (Uint32) 1 << (bit & 31);
+		}
+
+	rollout_agent_capture(&w->pman, &b->pman, b->pman.speed);
+	w->pman.x = board_wrap_x(GET_BLOCK_FIXED(b->pman.loc.x));
+	w->pman.y = GET_BLOCK_FIXED(b->pman.loc.y);
+
+	for (g = 0; g < 4; g++) {
+		GameAgent *ga = &b->ghosts[g];
+		RolloutAgent *a = &w->ghosts[g];
+
+		rollout_agent_capture(a, ga, ga->original_speed);
+		switch (ga->state.state) {
+			case GHOST_STATE_FLEEING:
+				a->state = ROLLOUT_GHOST_FLEEING;
+				a->timer = agent_ghost_flee_time_left(ga);
+				break;
+			case GHOST_STATE_RESTING:
+				a->state = ROLLOUT_GHOST_IN_ASYLUM;
+				a->timer = (ga->ghost_resting_hit_times + 1) * ROLLOUT_GHOST_RESTING_HIT_TIME;
+				break;
+			case GHOST_STATE_GOTO_ASYLUM_EXIT:
+			case GHOST_STATE_LEAVE_ASYLUM:
+			case GHOST_STATE_RESPAWN:
+				a->state = ROLLOUT_GHOST_IN_ASYLUM;
+				a->timer = ROLLOUT_GHOST_RESTING_HIT_TIME;
+				break;
+			case GHOST_STATE_SPIRIT:
+			case GHOST_STATE_GOTO_ASYLUM_ENTRANCE:
+			case GHOST_STATE_ENTER_ASYLUM:
+			case GHOST_STATE_FREEZE_KILLED:
+				a->state = ROLLOUT_GHOST_RETURNING;
+				a->timer = ROLLOUT_GHOST_RETURN_TIME;
+				break;
+		}
+	}
+
+	w->pman_is_random = 0;
+	w->ghosts_eaten = 0;
+	w->score = 0;
+	w->time = 0;
+	w->is_over = 0;
+	w->is_dead = 0;
+	w->rand_state = seed;
+}
+
+/* Returns whether the job has played enough rollouts, given that it's played n. */
+int rollout_job_is_done(RolloutJob *job, int n)
+{
+	if (job->budget_rollouts)
+		return n >= job->budget_rollouts;
+	return game_get_microseconds() - job->start_us >= job->budget_us;
+}
+
+/* Plays rollouts out of the job's root world until its budget is used up, then votes. */
+void rollout_run_job(RolloutJob *job)
+{
+	int dirs[4];
+	int num_dirs = 0;
+	int n, d, k;
+	Uint32 t;
+	double best_mean = 0;
+
+	for (d = 0; d < 4; d++) {
+		job->total[d] = job->count[d] = 0;
+		if (rollout_can_move(&g_rollout_level, &job->root.pman, d))
+			dirs[num_dirs++] = d;
+	}
+
+	job->vote = ROLLOUT_NO_DIRECTION;
+	if (num_dirs == 0) return;
+
+	/* Rollouts are played ROLLOUT_BATCH_SIZE at a time, in lock-step.  Every
+	   direction gets at least one rollout, however short the budget. */
+	for (n = 0; n == 0 || !rollout_job_is_done(job, n); n += ROLLOUT_BATCH_SIZE) {
+		for (k = 0; k < ROLLOUT_BATCH_SIZE; k++) {
+			RolloutWorld *w = &job->starts[k];
+
+			*w = job->root;
+			w->pman.dir = dirs[(n+k) % num_dirs];
+			w->pman_is_random = 1;
+			w->rand_state = job->seed + (Uint32) (n+k) * 2654435761u;
+		}
+		rollout_batch_init(&job->batch, &g_rollout_level, job->starts, ROLLOUT_BATCH_SIZE);
+		for (t = 0; t < ROLLOUT_HORIZON_MS; t += ROLLOUT_STEP_MS)
+			rollout_batch_step(&job->batch, &g_rollout_level, ROLLOUT_STEP_MS);
+
+		for (k = 0; k < ROLLOUT_BATCH_SIZE; k++) {
+			RolloutWorld *w = rollout_batch_get_world(&job->batch, k);
+
+			d = dirs[(n+k) % num_dirs];
+			job->total[d] += w->score - (w->is_dead ? ROLLOUT_DEATH_PENALTY : 0);
+			job->count[d]++;
+		}
+	}
+
+	for (d = 0; d < 4; d++) {
+		double mean;
+
+		if (!job->count[d]) continue;
+		mean = (double) job->total[d] / job->count[d];
+		if (job->vote == ROLLOUT_NO_DIRECTION || mean > best_mean) {
+			job->vote = d;
+			best_mean = mean;
+		}
+	}
+}
+
+/* Plays worker k's rollouts and makes its vote. */
+void rollout_worker_job(int k, int n, void *data)
+{
+	rollout_run_job(&g_rollout_jobs[k]);
+}
+
+/* Sets the most worker threads the rollouts may use (at most ROLLOUT_MAX_THREADS),
+   stopping the ones that are running. */
+void rollout_set_max_threads(int n)
+{
+	assert(n > 0 && n <= ROLLOUT_MAX_THREADS);
+	rollout_shutdown();
+	g_rollout_max_threads = n;
+}
+
+/* Stops the worker threads.  They're started again the next time they're needed. */
+void rollout_shutdown()
+{
+	workers_stop(&g_rollout_workers);
+}
+
+/* Returns the average value of the rollouts every worker played in the given direction. */
+double rollout_direction_mean(int dir)
+{
+	int total = 0, count = 0;
+	int k;
+
+	for (k = 0; k < g_rollout_workers.num_threads; k++) {
+		total += g_rollout_jobs[k].total[dir];
+		count += g_rollout_jobs[k].count[dir];
+	}
+	return count ? (double) total / count : 0;
+}
+
+/* Returns the DIRECTION_* constant the workers vote for pac man to take out of
+   the block he's on, or ROLLOUT_NO_DIRECTION if they have no opinion.  Blocks
+   for ROLLOUT_DECISION_BUDGET_US microseconds, or, in a headless game, until
+   each worker has played ROLLOUT_DECISION_ROLLOUTS rollouts. */
+int rollout_choose_move(Board *b, int level)
+{
+	int votes[4] = { 0, 0, 0, 0 };
+	int k, d, best;
+	Uint32 start_us;
+
+	if (g_rollout_workers.num_threads == 0)
+		workers_start(&g_rollout_workers, g_rollout_max_threads, rollout_worker_job, NULL);
+
+	/* The workers are all idle, so it's safe to change what they share. */
+	rollout_level_init(&g_rollout_level, b, level);
+	rollout_world_capture(&g_rollout_jobs[0].root, b, 0);
+
+	start_us = game_get_microseconds();
+	for (k = 0; k < g_rollout_workers.num_threads; k++) {
+		RolloutJob *job = &g_rollout_jobs[k];
+
+		if (k > 0) job->root = g_rollout_jobs[0].root;
+		/* Seed from the game's generator without disturbing it. */
+		job->seed = rand_get_state() ^ ((Uint32) (k+1) * 2246822519u);
+		job->start_us = start_us;
+		job->budget_us = ROLLOUT_DECISION_BUDGET_US;
+		job->budget_rollouts = game_is_headless() ? ROLLOUT_DECISION_ROLLOUTS : 0;
+	}
+	workers_run(&g_rollout_workers);
+
+	for (k = 0; k < g_rollout_workers.num_threads; k++)
+		if (g_rollout_jobs[k].vote != ROLLOUT_NO_DIRECTION)
+			votes[g_rollout_jobs[k].vote]++;
+
+	/* Most votes wins; ties go to whichever did best across all the workers. */
+	best = ROLLOUT_NO_DIRECTION;
+	for (d = 0; d < 4; d++) {
+		if (!votes[d]) continue;
+		if (best == ROLLOUT_NO_DIRECTION || votes[d] > votes[best] ||
+		    (votes[d] == votes[best] && rollout_direction_mean(d) > rollout_direction_mean(best)))
+			best = d;
+	}
+	return best;
+}
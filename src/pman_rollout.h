@@ -0,0 +1,151 @@
+#ifndef INCLUDE_PMAN_ROLLOUT
+#define INCLUDE_PMAN_ROLLOUT
+
+/* pman_rollout.h
+
+   Monte-Carlo rollout AI for pac man.
+
+   The real game world can't be copied onto other threads, since every object in
+   it is a global that the message router knows about.  So at each junction, the
+   board is captured into a RolloutWorld:  a small, self-contained model of the
+   game (nibs, pac man, the ghosts and their fleeing/resting timers) that can be
+   stepped forward without touching any global state.
+
+   The world is then handed to a pool of worker threads.  Each worker plays as
+   many random games ("rollouts") from it as it can within a fixed time budget
+   (or, in a headless game, a fixed number of them, so that the game plays out
+   the same on any machine),
+   starting each one by sending pac man out of the junction in one of the
+   directions he can take.  When the time is up, each worker votes for the
+   direction whose rollouts did best on average, and the direction with the most
+   votes wins.
+*/
+
+#include "SDL.h"
+
+#include "fixed.h"
+#include "pman_board.h"
+
+/* Maximum number of worker threads. */
+#define ROLLOUT_MAX_THREADS 16
+
+/* Number of microseconds the workers get to make each decision. */
+#define ROLLOUT_DECISION_BUDGET_US 2000
+
+/* Number of rollouts each worker plays for each decision in a headless game
+   instead, which is about what one gets through in ROLLOUT_DECISION_BUDGET_US.
+   It's a multiple of ROLLOUT_BATCH_SIZE. */
+#define ROLLOUT_DECISION_ROLLOUTS 64
+
+/* Length of each rollout, in ms of game time. */
+#define ROLLOUT_HORIZON_MS 8000
+
+/* Amount of game time each step of a rollout covers, in ms. */
+#define ROLLOUT_STEP_MS 20
+
+/* Number of rollouts each worker plays at once (see pman_rollout_batch.h).  It's
+   at least 4, so that the first batch tries every direction. */
+#define ROLLOUT_BATCH_SIZE 8
+
+/* How much worse than scoring nothing it is for pac man to die in a rollout,
+   and how much better it is for him to clear the board. */
+#define ROLLOUT_DEATH_PENALTY 5000
+#define ROLLOUT_LEVEL_BONUS 5000
+
+/* Number of ms a ghost that's been eaten spends going back to the asylum and
+   respawning. */
+#define ROLLOUT_GHOST_RETURN_TIME 4000
+
+/* Number of ms a resting ghost is assumed to spend in the asylum for every
+   time it has left to hit the asylum walls. */
+#define ROLLOUT_GHOST_RESTING_HIT_TIME 300
+
+/* How far ghosts can see pac man down a corridor, in blocks. */
+#define ROLLOUT_GHOST_SIGHT_BLOCKS 20
+
+/* Number of words in a bitset with one bit per block. */
+#define ROLLOUT_BLOCK_WORDS ((BOARD_WIDTH*BOARD_HEIGHT+31)/32)
+
+/* Means "no direction" wherever a DIRECTION_* constant is expected. */
+#define ROLLOUT_NO_DIRECTION -1
+
+/* The ROLLOUT_GHOST_* constants are the states a ghost can be in. */
+
+/* Roaming the board, and deadly to pac man. */
+#define ROLLOUT_GHOST_CHASING   0
+/* Running away from pac man, who can eat it. */
+#define ROLLOUT_GHOST_FLEEING   1
+/* Eaten, and on its way back to the asylum.  Harmless. */
+#define ROLLOUT_GHOST_RETURNING 2
+/* In the asylum.  Harmless until it comes out above the asylum door. */
+#define ROLLOUT_GHOST_IN_ASYLUM 3
+
+/* Pac man or a ghost in a RolloutWorld. */
+typedef struct RolloutAgent {
+	/* Block the agent most recently entered. */
+	int x, y;
+	/* DIRECTION_* constant the agent is heading in, or ROLLOUT_NO_DIRECTION. */
+	int dir;
+	/* For pac man, the direction to turn in as soon as he can (like GameAgent.next_move),
+	   or ROLLOUT_NO_DIRECTION. */
+	int next_dir;
+	/* Distance travelled from the block towards the next one, in fixed-point pixels. */
+	fixed progress;
+	/* Normal speed of the agent, in fixed-point pixels per ms. */
+	fixed speed;
+	/* ROLLOUT_GHOST_* constant (ghosts only). */
+	int state;
+	/* Number of ms until the agent's current state runs out (ghosts only). */
+	int timer;
+} RolloutAgent;
+
+/* The parts of a level that don't change during play, shared between all the
+   RolloutWorlds on it. */
+typedef struct RolloutLevel {
+	/* Whether agents can move through each block. */
+	Uint8 is_open[BOARD_WIDTH][BOARD_HEIGHT];
+	/* Number of ms ghosts flee for after a nibbloon is eaten. */
+	int flee_time;
+	/* Multiplier applied to a ghost's speed while it's fleeing. */
+	fixed flee_speed_multiplier;
+} RolloutLevel;
+
+/* A small, self-contained model of the game world. */
+typedef struct RolloutWorld {
+	/* Bitsets of the blocks that hold a nib, and of those nibs that are nibbloons. */
+	Uint32 nibs[ROLLOUT_BLOCK_WORDS];
+	Uint32 nibbloons[ROLLOUT_BLOCK_WORDS];
+	int nibs_left;
+
+	RolloutAgent pman;
+	RolloutAgent ghosts[4];
+
+	/* Whether pac man picks his own way randomly at every block (as in a rollout)
+	   rather than following pman.next_dir. */
+	int pman_is_random;
+
+	/* Number of ghosts eaten since the last nibbloon. */
+	int ghosts_eaten;
+	/* Points scored so far. */
+	int score;
+	/* Game time elapsed so far, in ms. */
+	Uint32 time;
+	/* Whether the game is over, and whether that's because pac man died. */
+	int is_over;
+	int is_dead;
+
+	/* The world's own random number generator state. */
+	Uint32 rand_state;
+} RolloutWorld;
+
+void rollout_level_init(RolloutLevel *l, Board *b, int level);
+void rollout_world_capture(RolloutWorld *w, Board *b, Uint32 seed);
+void rollout_world_step(RolloutWorld *w, const RolloutLevel *l, Uint32 time);
+void rollout_ghost_step(RolloutWorld *w, const RolloutLevel *l, RolloutAgent *a, int pman_x, int pman_y, Uint32 time);
+int rollout_can_move(const RolloutLevel *l, const RolloutAgent *a, int dir);
+
+int rollout_choose_move(Board *b, int level);
+void rollout_set_max_threads(int n);
+void rollout_shutdown();
+
+#endif
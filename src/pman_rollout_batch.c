@@ -0,0 +1,263 @@
+#include "globals.h"
+
+#include <string.h>
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROLLOUT_BATCH_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "SDL.h"
+
+#include "state.h"
+#include "fixed.h"
+#include "pman_board.h"
+#include "pman_rollout.h"
+#include "pman_rollout_batch.h"
+
+/* Distance between two blocks, in fixed-point pixels. */
+#define ROLLOUT_BATCH_BLOCK_FIXED FIXED_SET_INT(BLOCK_SIZE)
+
+/* Works out the batch's entries for agent a, which is in the given slot of
+   world i (pac man in slot 0, ghost g in slot g+1), from the agent itself. */
+void rollout_batch_load_agent(RolloutBatch *rb, const RolloutLevel *l, int i, int slot, const RolloutAgent *a)
+{
+	const RolloutWorld *w = &rb->worlds[i];
+	int is_moving, has_timer;
+	fixed speed;
+
+	if (w->is_over) {
+		is_moving = has_timer = 0;
+	} else if (slot == 0) {
+		is_moving = 1;
+		has_timer = 0;
+	} else {
+		is_moving = (a->state == ROLLOUT_GHOST_CHASING || a->state == ROLLOUT_GHOST_FLEEING);
+		has_timer = (a->state != ROLLOUT_GHOST_CHASING);
+	}
+
+	speed = a->speed;
+	if (slot > 0 && a->state == ROLLOUT_GHOST_FLEEING)
+		speed = FIXED_MULT(a->speed, l->flee_speed_multiplier);
+
+	rb->progress[slot][i] = (Sint32) a->progress;
+	rb->delta[slot][i] = is_moving ? (Sint32) (speed * (fixed) rb->step_time) : 0;
+	rb->timer[slot][i] = a->timer;
+	rb->timer_step[slot][i] = has_timer ? (Sint32) rb->step_time : 0;
+	rb->cell[slot][i] = (slot == 0 || is_moving) ? a->x + a->y*BOARD_WIDTH : -1;
+	rb->blocked[slot][i] = (is_moving && !rollout_can_move(l, a, a->dir)) ? -1 : 0;
+}
+
+/* Works out all the batch's entries for world i. */
+void rollout_batch_load_world(RolloutBatch *rb, const RolloutLevel *l, int i)
+{
+	RolloutWorld *w = &rb->worlds[i];
+	int g;
+
+	rollout_batch_load_agent(rb, l, i, 0, &w->pman);
+	for (g = 0; g < ROLLOUT_BATCH_AGENTS-1; g++)
+		rollout_batch_load_agent(rb, l, i, g+1, &w->ghosts[g]);
+}
+
+/* Sets up the entries of an unused world slot so that nothing ever happens in it. */
+void rollout_batch_clear_world(RolloutBatch *rb, int i)
+{
+	int slot;
+
+	for (slot = 0; slot < ROLLOUT_BATCH_AGENTS; slot++) {
+		rb->progress[slot][i] = rb->delta[slot][i] = 0;
+		rb->timer[slot][i] = rb->timer_step[slot][i] = 0;
+		rb->cell[slot][i] = -1;
+		rb->blocked[slot][i] = 0;
+	}
+}
+
+/* Starts a batch off with copies of the given worlds. */
+void rollout_batch_init(RolloutBatch *rb, const RolloutLevel *l, const RolloutWorld worlds[], int num_worlds)
+{
+	int i;
+
+	assert(num_worlds > 0 && num_worlds <= ROLLOUT_BATCH_MAX_WORLDS);
+
+	rb->num_worlds = num_worlds;
+	rb->step_time = ROLLOUT_STEP_MS;
+	for (i = 0; i < ROLLOUT_BATCH_MAX_WORLDS; i++) {
+		if (i < num_worlds)
+			rollout_batch_set_world(rb, l, i, &worlds[i]);
+		else
+			rollout_batch_clear_world(rb, i);
+	}
+}
+
+/* Replaces world i of the batch with a copy of the given world (which may be
+   the one rollout_batch_get_world() returned, after changing it). */
+void rollout_batch_set_world(RolloutBatch *rb, const RolloutLevel *l, int i, const RolloutWorld *w)
+{
+	if (w != &rb->worlds[i]) rb->worlds[i] = *w;
+	rollout_batch_load_world(rb, l, i);
+}
+
+/* Returns world i of the batch, brought up to date. */
+RolloutWorld *rollout_batch_get_world(RolloutBatch *rb, int i)
+{
+	RolloutWorld *w = &rb->worlds[i];
+	int g;
+
+	w->pman.progress = rb->progress[0][i];
+	w->pman.timer = rb->timer[0][i];
+	for (g = 0; g < ROLLOUT_BATCH_AGENTS-1; g++) {
+		w->ghosts[g].progress = rb->progress[g+1][i];
+		w->ghosts[g].timer = rb->timer[g+1][i];
+	}
+	return w;
+}
+
+/* Moves every agent of worlds [0, n) along as if nothing happens to it, into
+   next_progress[] and next_timer[], and flags the agents that something does
+   happen to in events[].  Worlds that nothing happens to at all are moved
+   along for good.  n must be a multiple of 4. */
+void rollout_batch_advance(RolloutBatch *rb, int n)
+{
+	int i, slot;
+
+#ifdef ROLLOUT_BATCH_USE_SSE2
+	const __m128i block_limit = _mm_set1_epi32(ROLLOUT_BATCH_BLOCK_FIXED - 1);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (i = 0; i < n; i += 4) {
+		__m128i pman_cell = _mm_loadu_si128((const __m128i *) &rb->cell[0][i]);
+		__m128i events = zero;
+		__m128i p[ROLLOUT_BATCH_AGENTS], t[ROLLOUT_BATCH_AGENTS];
+
+		for (slot = 0; slot < ROLLOUT_BATCH_AGENTS; slot++) {
+			__m128i progress = _mm_loadu_si128((const __m128i *) &rb->progress[slot][i]);
+			__m128i delta = _mm_loadu_si128((const __m128i *) &rb->delta[slot][i]);
+			__m128i timer = _mm_loadu_si128((const __m128i *) &rb->timer[slot][i]);
+			__m128i timer_step = _mm_loadu_si128((const __m128i *) &rb->timer_step[slot][i]);
+			__m128i e;
+
+			p[slot] = _mm_add_epi32(progress, delta);
+			t[slot] = _mm_sub_epi32(timer, timer_step);
+			_mm_storeu_si128((__m128i *) &rb->next_progress[slot][i], p[slot]);
+			_mm_storeu_si128((__m128i *) &rb->next_timer[slot][i], t[slot]);
+
+			/* Reaching a block, being blocked, or a running timer running out... */
+			e = _mm_cmpgt_epi32(p[slot], block_limit);
+			e = _mm_or_si128(e, _mm_loadu_si128((const __m128i *) &rb->blocked[slot][i]));
+			e = _mm_or_si128(e, _mm_andnot_si128(_mm_cmpeq_epi32(timer_step, zero), _mm_cmplt_epi32(t[slot], one)));
+			/* ...or a ghost sharing pac man's block. */
+			if (slot > 0)
+				e = _mm_or_si128(e, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) &rb->cell[slot][i]), pman_cell));
+
+			events = _mm_or_si128(events, _mm_and_si128(e, _mm_set1_epi32(1 << slot)));
+		}
+		_mm_storeu_si128((__m128i *) &rb->events[i], events);
+
+		/* Keep the new positions and timers of worlds without events. */
+		{
+			__m128i quiet = _mm_cmpeq_epi32(events, zero);
+
+			for (slot = 0; slot < ROLLOUT_BATCH_AGENTS; slot++) {
+				__m128i progress = _mm_loadu_si128((const __m128i *) &rb->progress[slot][i]);
+				__m128i timer = _mm_loadu_si128((const __m128i *) &rb->timer[slot][i]);
+
+				progress = _mm_or_si128(_mm_and_si128(quiet, p[slot]), _mm_andnot_si128(quiet, progress));
+				timer = _mm_or_si128(_mm_and_si128(quiet, t[slot]), _mm_andnot_si128(quiet, timer));
+				_mm_storeu_si128((__m128i *) &rb->progress[slot][i], progress);
+				_mm_storeu_si128((__m128i *) &rb->timer[slot][i], timer);
+			}
+		}
+	}
+#else
+	for (i = 0; i < n; i++) {
+		Sint32 events = 0;
+
+		for (slot = 0; slot < ROLLOUT_BATCH_AGENTS; slot++) {
+			Sint32 p = rb->progress[slot][i] + rb->delta[slot][i];
+			Sint32 t = rb->timer[slot][i] - rb->timer_step[slot][i];
+
+			rb->next_progress[slot][i] = p;
+			rb->next_timer[slot][i] = t;
+			if (p >= ROLLOUT_BATCH_BLOCK_FIXED || rb->blocked[slot][i] ||
+			    (rb->timer_step[slot][i] && t < 1) ||
+			    (slot > 0 && rb->cell[slot][i] == rb->cell[0][i]))
+				events |= 1 << slot;
+		}
+		rb->events[i] = events;
+
+		if (!events) {
+			for (slot = 0; slot < ROLLOUT_BATCH_AGENTS; slot++) {
+				rb->progress[slot][i] = rb->next_progress[slot][i];
+				rb->timer[slot][i] = rb->next_timer[slot][i];
+			}
+		}
+	}
+#endif
+}
+
+/* Finishes the step of world i, which something happens to, the ordinary way. */
+void rollout_batch_step_world(RolloutBatch *rb, const RolloutLevel *l, int i, Uint32 time)
+{
+	RolloutWorld *w = &rb->worlds[i];
+	Sint32 events = rb->events[i];
+	int slot;
+
+	if (events & 1) {
+		/* Pac man eating a nibbloon changes the ghosts too, so when something
+		   happens to him, the whole world is stepped the ordinary way. */
+		rollout_world_step(rollout_batch_get_world(rb, i), l, time);
+		rollout_batch_load_world(rb, l, i);
+	} else {
+		/* Otherwise pac man just moves along, and so does every ghost nothing
+		   happens to, in the same order as rollout_world_step() would. */
+		w->time += time;
+		for (slot = 1; slot < ROLLOUT_BATCH_AGENTS && !w->is_over; slot++) {
+			RolloutAgent *a = &w->ghosts[slot-1];
+
+			if (events & (1 << slot)) {
+				a->progress = rb->progress[slot][i];
+				a->timer = rb->timer[slot][i];
+				rollout_ghost_step(w, l, a, w->pman.x, w->pman.y, time);
+				rollout_batch_load_agent(rb, l, i, slot, a);
+			} else {
+				rb->progress[slot][i] = rb->next_progress[slot][i];
+				rb->timer[slot][i] = rb->next_timer[slot][i];
+			}
+		}
+		rb->progress[0][i] = rb->next_progress[0][i];
+
+		/* If a ghost ended the game, nothing moves any more (and ghosts left
+		   behind by the end of the game stay where they were). */
+		if (w->is_over) {
+			rollout_batch_get_world(rb, i);
+			rollout_batch_load_world(rb, l, i);
+		}
+	}
+}
+
+/* Advances every world in the batch by the given number of ms, leaving each
+   exactly as rollout_world_step() would. */
+void rollout_batch_step(RolloutBatch *rb, const RolloutLevel *l, Uint32 time)
+{
+	int n = (rb->num_worlds + 3) & ~3;
+	int i;
+
+	if (time != rb->step_time) {
+		rb->step_time = time;
+		for (i = 0; i < rb->num_worlds; i++) {
+			rollout_batch_get_world(rb, i);
+			rollout_batch_load_world(rb, l, i);
+		}
+	}
+
+	rollout_batch_advance(rb, n);
+
+	for (i = 0; i < rb->num_worlds; i++) {
+		if (rb->events[i])
+			rollout_batch_step_world(rb, l, i, time);
+		else if (!rb->worlds[i].is_over)
+			rb->worlds[i].time += time;
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef INCLUDE_PMAN_ROLLOUT_BATCH
+#define INCLUDE_PMAN_ROLLOUT_BATCH
+
+/* pman_rollout_batch.h
+
+   Lock-step stepping of many RolloutWorlds at once.
+
+   Most of the time, a step of a RolloutWorld does nothing more than move each
+   agent a little further towards its next block, and count down the ghosts'
+   timers.  A RolloutBatch keeps those parts of its worlds (how far each agent
+   has got, how far it goes each step, its timer, and so on) in arrays with one
+   entry per world, and moves every agent of every world along together, four
+   worlds at a time with SSE2 where it's available.
+
+   Whenever something more interesting than that would happen to an agent in a
+   step (it reaches a block, can't go on, runs out its timer, or shares pac
+   man's block), the step is done for it afterwards by the ordinary
+   rollout_world_step() code instead, so a batch of worlds ends up exactly as
+   the worlds would if each were stepped on its own.
+*/
+
+#include "SDL.h"
+
+#include "pman_rollout.h"
+
+/* Maximum number of worlds in a batch. */
+#define ROLLOUT_BATCH_MAX_WORLDS 64
+
+/* Number of agents in each world:  pac man (slot 0) and the four ghosts. */
+#define ROLLOUT_BATCH_AGENTS 5
+
+/* A batch of RolloutWorlds. */
+typedef struct RolloutBatch {
+	int num_worlds;
+	/* The worlds.  The progress and timer of each of their agents are out of date
+	   while they're in the batch;  rollout_batch_get_world() brings them up to date. */
+	RolloutWorld worlds[ROLLOUT_BATCH_MAX_WORLDS];
+
+	/* The arrays below have an entry for each agent slot of each world. */
+
+	/* Distance travelled towards the next block, in fixed-point pixels. */
+	Sint32 progress[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	/* Distance travelled in one step, or 0 if the agent doesn't move. */
+	Sint32 delta[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	/* Number of ms until the agent's timer runs out, and the number of ms it
+	   counts down each step (0 if it isn't running). */
+	Sint32 timer[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	Sint32 timer_step[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	/* Index of the agent's block (x + y*BOARD_WIDTH).  -1 for ghosts that can't
+	   collide with pac man. */
+	Sint32 cell[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	/* All ones if the agent should be moving but can't go on the way it's heading. */
+	Sint32 blocked[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+
+	/* Where the agents would get to (and their timers) if nothing happened to
+	   them in the step being taken, and a bitmask per world of the agent slots
+	   that something does happen to. */
+	Sint32 next_progress[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	Sint32 next_timer[ROLLOUT_BATCH_AGENTS][ROLLOUT_BATCH_MAX_WORLDS];
+	Sint32 events[ROLLOUT_BATCH_MAX_WORLDS];
+
+	/* The length of a step that delta[] and timer_step[] were worked out for. */
+	Uint32 step_time;
+} RolloutBatch;
+
+void rollout_batch_init(RolloutBatch *rb, const RolloutLevel *l, const RolloutWorld worlds[], int num_worlds);
+void rollout_batch_set_world(RolloutBatch *rb, const RolloutLevel *l, int i, const RolloutWorld *w);
+RolloutWorld *rollout_batch_get_world(RolloutBatch *rb, int i);
+void rollout_batch_step(RolloutBatch *rb, const RolloutLevel *l, Uint32 time);
+
+#endif
@@ -15,6 +15,8 @@
 #include "pman.h"
 #include "pman_score.h"
 #include "pman_agent_pman.h"
+#include "pman_tune.h"
+#include "compositor.h"
 
 /* Restarts the game board.  Should be called whenever a new level is started. */
 void score_restart(Score *s)
@@ -31,7 +33,7 @@ void score_init(Score *s, int x_ofs, int y_ofs)
 	if (pman_in_demo_mode()) {
 		s->lives_left = 0;
 	} else {
-		s->lives_left = SCORE_STARTING_LIVES;
+		s->lives_left = g_tunables.score_starting_lives;
 	}
 	s->score = 0;
 	s->score_last_life_earned = 0;
@@ -83,29 +85,15 @@ void score_draw_lives(Score *s, SDL_Surface *surface)
 	}
 }
 
-/* Redraws the entire scoreboard.  Different from score_draw(), which
-   decides which parts of the scoreboard should be redrawn, calling
-   this function if necessary. */
-void score_redraw(Score *s, SDL_Surface *surface)
-{
-	score_draw_score(s, surface);
-	score_draw_lives(s, surface);
-}
-
-/* Draws the scoreboard. */
-void score_draw(Score *s, SDL_Surface *surface, int game_view_flags)
+/* Draws the entire scoreboard, over a black box so that it's opaque;  if the
+   scoreboard isn't visible, only the box is drawn.  Called by the HUD layer of
+   whichever game state shows the scoreboard (see compositor.h). */
+void score_draw(Score *s, SDL_Surface *surface)
 {
+	SDL_FillRect(surface, &s->draw_rect, 0);
 	if (s->is_visible) {
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW || s->score_changed) {
-			score_redraw(s, surface);
-			if (s->score_changed) {
-				game_update_rect_add(&s->draw_rect);
-			}
-			s->score_changed = 0;
-		} else { }
-	} else {
-		if (game_view_flags & GAME_DRAW_FLAG_REDRAW)
-			SDL_FillRect(surface, &s->draw_rect, 0);
+		score_draw_score(s, surface);
+		score_draw_lives(s, surface);
 	}
 }
 
@@ -121,7 +109,17 @@ void score_toggle_visible(Score *s)
 	else
 		s->is_visible = 1;
 
-	game_set_draw_flags(GAME_DRAW_FLAG_REDRAW);
+	game_invalidate_layer(COMPOSITOR_LAYER_HUD, &s->draw_rect);
+}
+
+/* Marks the scoreboard as dirty on the HUD layer if it's changed since the last
+   frame.  Should be called once a frame by the view of the game state that shows it. */
+void score_invalidate_changes(Score *s)
+{
+	if (s->score_changed) {
+		game_invalidate_layer(COMPOSITOR_LAYER_HUD, &s->draw_rect);
+		s->score_changed = 0;
+	}
 }
 
 /* Removes a life from the scoreboard.  If there are no more lives left to lose,
@@ -137,7 +135,7 @@ int score_lives_decrement(Score *s)
 /* Give the player an extra life. */
 void score_lives_increment(Score *s)
 {
-	if (s->lives_left < SCORE_MAX_LIVES) s->lives_left++;
+	if (s->lives_left < g_tunables.score_max_lives) s->lives_left++;
 }
 
 /* Resets the "ghost killed since last nibbloon eaten" counter used
@@ -157,12 +155,12 @@ int score_add_agent_kill(Score *s, GameAgent *ga)
 	int amount;
 
 	if (ga->agent_type == GAME_AGENT_FRUIT) {
-		amount = SCORE_BASE_FRUIT_SCORE * (pman_get_level() + 1);
+		amount = g_tunables.score_base_fruit_score * (pman_get_level() + 1);
 		score_add(s, amount);
 		return amount;
 	}
 	if (ga->agent_type == GAME_AGENT_GHOST) {
-		amount = SCORE_BASE_GHOST_SCORE;
+		amount = g_tunables.score_base_ghost_score;
 
 		for (i = 0; i < s->curr_nibbloon_kills; i++) {
 			/* For each ghost that's died so far, we double the point value. */
@@ -182,7 +180,7 @@ int score_add_agent_kill(Score *s, GameAgent *ga)
    have been killed since the last nibbloon was eaten.) */
 void score_add_nibbloon(Score *s)
 {
-	score_add(s, SCORE_NIBBLOON_SCORE);
+	score_add(s, g_tunables.score_nibbloon_score);
 	score_nibbloon_kills_reset(s);
 }
 
@@ -193,7 +191,7 @@ void score_add(Score *s, int amount)
 	/* Add to the score */
 	s->score += amount;
 	/* Test to see if player's gotten enough points for a new life */
-	if (s->score - s->score_last_life_earned >= SCORE_NEW_LIFE_EARNED) {
+	if (s->score - s->score_last_life_earned >= g_tunables.score_new_life_earned) {
 		s->score_last_life_earned = s->score;
 		score_lives_increment(s);
 	}
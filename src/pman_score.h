@@ -19,6 +19,9 @@
 #define SCORE_PIXEL_HEIGHT 20
 #define SCORE_PIXEL_WIDTH BOARD_PIXEL_WIDTH
 
+/* The game uses these through the tunables (see pman_tune.h), so they're
+   only the defaults. */
+
 /* Number of starting and maximum lives, respectively. */
 #define SCORE_STARTING_LIVES 2
 #define SCORE_MAX_LIVES 5
@@ -38,8 +41,8 @@
 typedef struct Score {
 	/* Player's current score */
 	int score;
-	/* Used internally.  Tells whether the scoreboard has changed, and therefore whether
-	   to redraw it or not. */
+	/* Used internally.  Tells whether the scoreboard has changed since it was last
+	   marked dirty (see score_invalidate_changes()). */
 	int score_changed;
 	/* Player's score at the last time they earned enough points to gain a level. */
 	int score_last_life_earned;
@@ -56,8 +59,9 @@ typedef struct Score {
 void score_restart(Score *s);
 void score_init(Score *s, int x_ofs, int y_ofs);
 void score_destroy(Score *s);
-void score_draw(Score *s, SDL_Surface *surface, int game_view_flags);
+void score_draw(Score *s, SDL_Surface *surface);
 void score_toggle_visible(Score *s);
+void score_invalidate_changes(Score *s);
 int score_lives_decrement(Score *s);
 int score_add_agent_kill(Score *s, GameAgent *ga);
 void score_add_nibbloon(Score *s);
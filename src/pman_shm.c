@@ -0,0 +1,188 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "SDL.h"
+
+#include "debug.h"
+#include "state.h"
+#include "pman_obs.h"
+#include "pman_env.h"
+#include "pman_bot.h"
+#include "pman_shm.h"
+#include "pman_spectate.h"
+
+#ifndef WIN32
+
+/* Sleeps until the given index might no longer hold the given value, or until
+   SHM_WAIT_TIMEOUT_MS have passed. */
+void shm_sleep(ShmIndex *index, Uint32 old_value)
+{
+#ifdef __linux__
+	struct timespec timeout;
+
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = SHM_WAIT_TIMEOUT_MS * 1000000L;
+	/* Not FUTEX_WAIT_PRIVATE, since the other side is in another process. */
+	syscall(SYS_futex, &index->value, FUTEX_WAIT, old_value, &timeout, NULL, 0);
+#else
+	/* No futexes here, so just doze for a bit. */
+	usleep(50);
+#endif
+}
+
+/* Wakes whoever is asleep on the given index. */
+void shm_wake(ShmIndex *index)
+{
+#ifdef __linux__
+	syscall(SYS_futex, &index->value, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+}
+
+/* Waits for the given index to change from the given value, or for *quit to
+   become nonzero. */
+void shm_wait(ShmIndex *index, Uint32 old_value, volatile Uint32 *quit)
+{
+	int i;
+
+	for (i = 0; i < SHM_SPIN_COUNT; i++) {
+		if (__atomic_load_n(&index->value, __ATOMIC_ACQUIRE) != old_value || *quit)
+			return;
+	}
+
+	/* Say we're asleep before looking one last time, so that the other side
+	   either sees we need waking or we see its new value. */
+	__atomic_add_fetch(&index->waiters, 1, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&index->value, __ATOMIC_SEQ_CST) == old_value && !*quit) {
+		shm_sleep(index, old_value);
+	}
+	__atomic_sub_fetch(&index->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Stores a new value in the given index, after everything written before it,
+   and wakes the other side if it's asleep on it. */
+void shm_publish(ShmIndex *index, Uint32 value)
+{
+	__atomic_store_n(&index->value, value, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&index->waiters, __ATOMIC_SEQ_CST))
+		shm_wake(index);
+}
+
+/* Writes the given results, and the given grid observation planes if there are
+   any, into a slot of the observation ring. */
+void shm_fill_slot(Uint8 *slot, int frame_size, const EnvResult results[], Uint8 *planes, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		Uint8 *frame = slot + i * frame_size;
+
+		bot_fill_frame((BotFrame *) frame, &results[i]);
+		if (planes) memcpy(frame + sizeof(BotFrame), planes + i * OBS_SIZE, OBS_SIZE);
+	}
+}
+
+/* Plays the worlds described in the header of the given shared memory object
+   (see pman_shm.h) until the trainer says to quit. */
+void shm_run(const char *name)
+{
+	ShmHeader *h;
+	struct stat st;
+	Uint8 *base, *obs_ring, *act_ring;
+	Uint8 *planes = NULL;
+	int *env_actions;
+	EnvResult *results;
+	Env *env;
+	int fd, n, i, frame_size;
+	Uint32 slots, obs_head, act_tail;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) err("Couldn't open shared memory object.\n", 1);
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(ShmHeader))
+		err("Shared memory object is too small.\n", 1);
+	base = (Uint8 *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) err("Couldn't map shared memory object.\n", 1);
+
+	h = (ShmHeader *) base;
+	n = (int) h->num_worlds;
+	slots = h->slots;
+	frame_size = SHM_FRAME_SIZE(h->flags);
+	if (h->magic != SHM_MAGIC || n <= 0 || n > ENV_MAX_WORLDS || slots == 0 ||
+		(size_t) st.st_size < SHM_SIZE((size_t) n, (size_t) slots, h->flags)) {
+		h->status = SHM_STATUS_ERROR;
+		err("Shared memory object has a bad header.\n", 1);
+	}
+	h->frame_size = (Uint32) frame_size;
+	obs_ring = base + SHM_OBS_OFFSET;
+	act_ring = base + SHM_ACT_OFFSET((size_t) n, (size_t) slots, h->flags);
+
+	env_actions = (int *) malloc(sizeof(int) * n);
+	results = (EnvResult *) malloc(sizeof(EnvResult) * n);
+	if (h->flags & BOT_FLAG_PLANES) planes = (Uint8 *) malloc(OBS_SIZE * n);
+	if (!env_actions || !results || ((h->flags & BOT_FLAG_PLANES) && !planes))
+		err("Couldn't allocate shared memory buffers.\n", 1);
+
+	env = env_create(h->seed, n);
+	if (planes) {
+		for (i = 0; i < n; i++)
+			env_set_observation_planes(env, i, planes + i * OBS_SIZE);
+	}
+	env_reset_all(env, results);
+
+	obs_head = h->obs_head.value;
+	act_tail = h->act_tail.value;
+	h->status = SHM_STATUS_RUNNING;
+
+	for (;;) {
+		Uint32 t;
+
+		/* Wait for room in the observation ring, then publish the latest frames. */
+		while ((t = __atomic_load_n(&h->obs_tail.value, __ATOMIC_ACQUIRE)) + slots == obs_head && !h->quit)
+			shm_wait(&h->obs_tail, t, &h->quit);
+		if (h->quit) break;
+		shm_fill_slot(obs_ring + (obs_head % slots) * n * frame_size, frame_size, results, planes, n);
+		shm_publish(&h->obs_head, ++obs_head);
+
+		/* Wait for the next slot of actions, and play it. */
+		while ((t = __atomic_load_n(&h->act_head.value, __ATOMIC_ACQUIRE)) == act_tail && !h->quit)
+			shm_wait(&h->act_head, t, &h->quit);
+		if (h->quit) break;
+		if (!bot_step_env(env, (Sint8 *) act_ring + (act_tail % slots) * n, env_actions, results)) {
+			h->status = SHM_STATUS_ERROR;
+			break;
+		}
+		shm_publish(&h->act_tail, ++act_tail);
+	}
+
+	if (h->status != SHM_STATUS_ERROR) h->status = SHM_STATUS_DONE;
+	env_destroy(env);
+	spectate_shutdown();
+	env_shutdown();
+	free(env_actions);
+	free(results);
+	free(planes);
+	munmap(base, st.st_size);
+}
+
+#else
+
+void shm_run(const char *name)
+{
+	err("Shared memory rings aren't supported on this platform.\n", 1);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef INCLUDE_PMAN_SHM
+#define INCLUDE_PMAN_SHM
+
+/* pman_shm.h
+
+   Shared-memory rings through which a trainer in another local process can
+   play a batch of worlds (see pman_env.h) without any of it going through a
+   pipe (POSIX systems only).
+
+   The trainer creates a POSIX shared memory object of SHM_SIZE() bytes, fills in
+   the first five fields of its ShmHeader, and starts "pman -shm NAME".  The
+   game then plays the worlds through two rings in the object:
+
+     - The observation ring, whose slots each hold one frame per world, laid
+       out exactly as in a pman_bot.h reply (a BotFrame, followed by the
+       world's grid observation planes if BOT_FLAG_PLANES is set).
+     - The action ring, whose slots each hold one Sint8 action per world, as
+       in a BOT_CMD_STEP request (BOT_ACTION_RESET included).
+
+   Each ring has a head index, which only its producer writes, and a tail index,
+   which only its consumer writes.  Both count up forever (wrapping at 2^32), and
+   a ring's slot for index i is i % slots.  A side publishes a slot by storing
+   the index past it, and waits for the other side on the index it's expecting
+   to change:  first by spinning, then by sleeping on a futex, with the
+   ShmIndex's waiters count telling the other side whether it needs to wake it.
+
+   The game publishes the worlds' first frames straight away, and then one slot
+   of frames for every slot of actions it consumes.  It stops once the trainer
+   sets quit in the header (waking the action ring's head if the game might be
+   asleep), and sets status to SHM_STATUS_DONE on its way out.
+*/
+
+#include "SDL.h"
+
+#include "pman_obs.h"
+#include "pman_bot.h"
+
+/* Value of ShmHeader.magic. */
+#define SHM_MAGIC 0x4d534d50
+
+/* Size of a cache line.  Each index gets its own, so that the two processes
+   don't fight over them. */
+#define SHM_CACHE_LINE 64
+
+/* Number of times to look at an index before going to sleep on it. */
+#define SHM_SPIN_COUNT 2000
+
+/* Longest a side sleeps on an index before looking at it (and at quit) again, in ms. */
+#define SHM_WAIT_TIMEOUT_MS 100
+
+/* The SHM_STATUS_* constants are the values of ShmHeader.status. */
+#define SHM_STATUS_STARTING 0
+#define SHM_STATUS_RUNNING  1
+#define SHM_STATUS_DONE     2
+#define SHM_STATUS_ERROR    3
+
+/* One of the rings' head or tail indices. */
+typedef struct ShmIndex {
+	volatile Uint32 value;
+	/* Number of processes asleep waiting for value to change. */
+	volatile Uint32 waiters;
+	Uint8 pad[SHM_CACHE_LINE - 2*sizeof(Uint32)];
+} ShmIndex;
+
+/* The start of the shared memory object. */
+typedef struct ShmHeader {
+	/* Filled in by the trainer before the game starts:  SHM_MAGIC, the number of
+	   worlds, the seed their games are seeded from, BOT_FLAG_* constants, and the
+	   number of slots in each ring. */
+	Uint32 magic;
+	Uint32 num_worlds;
+	Uint32 seed;
+	Uint32 flags;
+	Uint32 slots;
+
+	/* Size of each world's frame, filled in by the game. */
+	Uint32 frame_size;
+	/* SHM_STATUS_* constant, set by the game. */
+	volatile Uint32 status;
+	/* Set by the trainer to make the game stop. */
+	volatile Uint32 quit;
+	Uint8 pad[SHM_CACHE_LINE - 8*sizeof(Uint32)];
+
+	ShmIndex obs_head, obs_tail;
+	ShmIndex act_head, act_tail;
+} ShmHeader;
+
+/* Size of each world's frame for the given BOT_FLAG_* constants. */
+#define SHM_FRAME_SIZE(flags) (sizeof(BotFrame) + (((flags) & BOT_FLAG_PLANES) ? OBS_SIZE : 0))
+
+/* Offsets of the rings in the shared memory object, and its total size. */
+#define SHM_OBS_OFFSET sizeof(ShmHeader)
+#define SHM_ACT_OFFSET(worlds, slots, flags) (SHM_OBS_OFFSET + (slots) * (worlds) * SHM_FRAME_SIZE(flags))
+#define SHM_SIZE(worlds, slots, flags) (SHM_ACT_OFFSET(worlds, slots, flags) + (slots) * (worlds))
+
+void shm_wait(ShmIndex *index, Uint32 old_value, volatile Uint32 *quit);
+void shm_publish(ShmIndex *index, Uint32 value);
+void shm_run(const char *name);
+
+#endif
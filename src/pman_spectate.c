@@ -0,0 +1,523 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "SDL.h"
+
+#include "game.h"
+#include "debug.h"
+#include "state.h"
+#include "fixed.h"
+#include "drawing.h"
+#include "compositor.h"
+#include "pman.h"
+#include "pman_board.h"
+#include "pman_score.h"
+#include "pman_agent.h"
+#include "pman_agent_ghost.h"
+#include "pman_spectate.h"
+
+#ifndef WIN32
+
+/* The game's side:  the listening socket (or -1), the viewer's connection (or
+   -1), the number of steps since the last look for a viewer, and whether the
+   next message has to be a key frame. */
+static int g_spectate_listener = -1;
+static int g_spectate_viewer = -1;
+static int g_spectate_steps = 0;
+static int g_spectate_need_key_frame;
+static char *g_spectate_path = NULL;
+
+/* What the stream has told the viewer so far. */
+static SpectateWorld g_spectate_sent;
+
+/* The viewer's side:  the connection to the game (or -1), when it last tried
+   to connect, and the board and scoreboard the stream is fed into. */
+static int g_spectate_conn = -1;
+static Uint32 g_spectate_last_connect;
+static const char *g_spectate_view_path;
+static Board g_spectate_board;
+static Score g_spectate_score;
+
+/* Returns the given agent of the given board, in stream order. */
+GameAgent *spectate_get_agent(Board *b, int i)
+{
+	if (i == 0) return &b->pman;
+	if (i < 5) return &b->ghosts[i-1];
+	return &b->fruit;
+}
+
+/* Helpers that append little-endian fields to a message. */
+void spectate_put8(Uint8 **p, int x)
+{
+	*(*p)++ = (Uint8) x;
+}
+
+void spectate_put16(Uint8 **p, int x)
+{
+	spectate_put8(p, x);
+	spectate_put8(p, x >> 8);
+}
+
+void spectate_put32(Uint8 **p, Sint32 x)
+{
+	spectate_put16(p, (int) (x & 0xffff));
+	spectate_put16(p, (int) ((x >> 16) & 0xffff));
+}
+
+/* Helpers that read little-endian fields from a message. */
+int spectate_get8(const Uint8 **p)
+{
+	return *(*p)++;
+}
+
+int spectate_get16(const Uint8 **p)
+{
+	int x = spectate_get8(p);
+	return x | (spectate_get8(p) << 8);
+}
+
+Sint32 spectate_get32(const Uint8 **p)
+{
+	Uint32 x = (Uint32) spectate_get16(p);
+	return (Sint32) (x | ((Uint32) spectate_get16(p) << 16));
+}
+
+/* Describes the given agent the way the stream does. */
+void spectate_capture_agent(SpectateAgent *sa, GameAgent *ga)
+{
+	sa->x = FIXED_GET_INT(ga->loc.x);
+	sa->y = FIXED_GET_INT(ga->loc.y);
+	sa->dir = map_fixed_vector_to_direction(&ga->curr_move);
+	sa->frame = (ga->agent_type == GAME_AGENT_PMAN) ? FIXED_GET_INT(ga->frame_curr) : 0;
+	sa->look = SPECTATE_LOOK_NORMAL;
+	if (ga->agent_type == GAME_AGENT_GHOST) {
+		if (ga->color == agent_ghost_get_color(GHOST_COLOR_SCARED))
+			sa->look = SPECTATE_LOOK_SCARED;
+		else if (ga->color == agent_ghost_get_color(GHOST_COLOR_SPIRIT))
+			sa->look = SPECTATE_LOOK_SPIRIT;
+	}
+	sa->is_visible = ga->is_visible;
+	sa->score_amount = ga->ghost_score_amount;
+}
+
+/* Appends a record of the given agent to a message, if anything about it has
+   changed since the last one (or always, for a key frame). */
+void spectate_encode_agent(Uint8 **p, int i, const SpectateAgent *sa, int key_frame)
+{
+	SpectateAgent *old = &g_spectate_sent.agents[i];
+	int dx = sa->x - old->x;
+	int dy = sa->y - old->y;
+
+	if (!key_frame && sa->dir == old->dir && sa->frame == old->frame && sa->look == old->look &&
+		sa->is_visible == old->is_visible && sa->score_amount == old->score_amount) {
+		if (!dx && !dy) return;
+		if (dx >= -128 && dx <= 127 && dy >= -128 && dy <= 127) {
+			spectate_put8(p, SPECTATE_REC_AGENT_MOVE);
+			spectate_put8(p, i);
+			spectate_put8(p, dx);
+			spectate_put8(p, dy);
+			*old = *sa;
+			return;
+		}
+	}
+
+	spectate_put8(p, SPECTATE_REC_AGENT);
+	spectate_put8(p, i);
+	spectate_put16(p, sa->x);
+	spectate_put16(p, sa->y);
+	spectate_put8(p, sa->dir + 1);
+	spectate_put8(p, sa->frame);
+	spectate_put8(p, sa->look);
+	spectate_put8(p, sa->is_visible);
+	spectate_put16(p, sa->score_amount);
+	*old = *sa;
+}
+
+/* Appends a record of every nib on the board to a message. */
+void spectate_encode_nibs(Uint8 **p, Board *b)
+{
+	int i;
+
+	spectate_put8(p, SPECTATE_REC_NIBS);
+	for (i = 0; i < BOARD_BLOCK_WORDS; i++) {
+		spectate_put32(p, (Sint32) b->nibs[i]);
+		g_spectate_sent.nibs[i] = b->nibs[i];
+	}
+}
+
+/* Puts together a message describing what's changed on the given world since the
+   last one (or all of it, for a key frame) and returns its length. */
+int spectate_encode(Uint8 *buffer, Board *b, Score *s, int level, int key_frame)
+{
+	Uint8 *p = buffer;
+	int i, eaten = 0, added = 0;
+
+	for (i = 0; i < SPECTATE_NUM_AGENTS; i++) {
+		SpectateAgent sa;
+
+		spectate_capture_agent(&sa, spectate_get_agent(b, i));
+		spectate_encode_agent(&p, i, &sa, key_frame);
+	}
+
+	/* Nibs only ever disappear during a game, so they're sent one at a time;  if
+	   any have come back (because the world was reset or a new level started),
+	   the whole board is sent instead. */
+	for (i = 0; i < BOARD_BLOCK_WORDS; i++) {
+		Uint32 gone = g_spectate_sent.nibs[i] & ~b->nibs[i];
+
+		added |= (b->nibs[i] & ~g_spectate_sent.nibs[i]) != 0;
+		for (; gone; gone &= gone - 1) eaten++;
+	}
+	if (key_frame || added || eaten > 32) {
+		spectate_encode_nibs(&p, b);
+	} else if (eaten) {
+		for (i = 0; i < BOARD_WIDTH*BOARD_HEIGHT; i++) {
+			Uint32 mask = (Uint32) 1 << (i & 31);
+
+			if ((g_spectate_sent.nibs[i >> 5] & mask) && !(b->nibs[i >> 5] & mask)) {
+				spectate_put8(&p, SPECTATE_REC_NIB_EATEN);
+				spectate_put16(&p, i);
+				g_spectate_sent.nibs[i >> 5] &= ~mask;
+			}
+		}
+	}
+
+	if (key_frame || s->score != g_spectate_sent.score) {
+		spectate_put8(&p, SPECTATE_REC_SCORE);
+		spectate_put32(&p, s->score);
+		g_spectate_sent.score = s->score;
+	}
+	if (key_frame || s->lives_left != g_spectate_sent.lives_left) {
+		spectate_put8(&p, SPECTATE_REC_LIVES);
+		spectate_put8(&p, s->lives_left);
+		g_spectate_sent.lives_left = s->lives_left;
+	}
+	if (key_frame || level != g_spectate_sent.level) {
+		spectate_put8(&p, SPECTATE_REC_LEVEL);
+		spectate_put16(&p, level);
+		g_spectate_sent.level = level;
+	}
+	if (key_frame || b->is_visible != g_spectate_sent.is_visible) {
+		spectate_put8(&p, SPECTATE_REC_VISIBLE);
+		spectate_put8(&p, b->is_visible);
+		g_spectate_sent.is_visible = b->is_visible;
+	}
+
+	return (int) (p - buffer);
+}
+
+/* Starts listening for a viewer on a Unix domain socket at the given path. */
+void spectate_listen(const char *path)
+{
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		err("Spectator socket path is too long.\n", 1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	g_spectate_listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (g_spectate_listener < 0) err("Couldn't create spectator socket.\n", 1);
+	unlink(path);
+	if (bind(g_spectate_listener, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+		listen(g_spectate_listener, 1) < 0) {
+		err("Couldn't listen on spectator socket.\n", 1);
+	}
+	fcntl(g_spectate_listener, F_SETFL, O_NONBLOCK);
+
+	/* A viewer that goes away shouldn't take the game with it. */
+	signal(SIGPIPE, SIG_IGN);
+
+	g_spectate_path = (char *) malloc(strlen(path) + 1);
+	strcpy(g_spectate_path, path);
+}
+
+/* Returns whether there's a spectator socket. */
+int spectate_is_listening()
+{
+	return g_spectate_listener >= 0;
+}
+
+/* Sends the viewer, if there is one, what's changed on the given world since it
+   was last sent.  Should be called after every step of the world. */
+void spectate_update(Board *b, Score *s, int level)
+{
+	Uint8 buffer[SPECTATE_MAX_MESSAGE];
+	int len;
+
+	if (g_spectate_listener < 0) return;
+
+	if (g_spectate_viewer < 0) {
+		if (++g_spectate_steps < SPECTATE_ACCEPT_INTERVAL) return;
+		g_spectate_steps = 0;
+		g_spectate_viewer = accept(g_spectate_listener, NULL, NULL);
+		if (g_spectate_viewer < 0) return;
+		fcntl(g_spectate_viewer, F_SETFL, O_NONBLOCK);
+		g_spectate_need_key_frame = 1;
+	}
+
+	len = spectate_encode(buffer, b, s, level, g_spectate_need_key_frame);
+	if (len == 0) return;
+
+	if (send(g_spectate_viewer, buffer, len, 0) < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			/* The viewer's behind;  skip this change and catch it up later. */
+			g_spectate_need_key_frame = 1;
+		} else {
+			close(g_spectate_viewer);
+			g_spectate_viewer = -1;
+		}
+		return;
+	}
+	g_spectate_need_key_frame = 0;
+}
+
+/* Stops listening for viewers, and hangs up on the one that's connected. */
+void spectate_shutdown()
+{
+	if (g_spectate_viewer >= 0) close(g_spectate_viewer);
+	if (g_spectate_listener >= 0) close(g_spectate_listener);
+	if (g_spectate_path) {
+		unlink(g_spectate_path);
+		free(g_spectate_path);
+	}
+	g_spectate_viewer = g_spectate_listener = -1;
+	g_spectate_path = NULL;
+}
+
+/* Applies the given record of an agent to the viewer's copy of it. */
+void spectate_apply_agent(GameAgent *ga, const SpectateAgent *sa)
+{
+	fixed_vector_set(&ga->loc, sa->x, sa->y);
+	ga->curr_move = *map_direction_to_fixed_vector(sa->dir);
+	ga->frame_curr = FIXED_SET_INT(sa->frame);
+	ga->is_visible = sa->is_visible;
+	ga->ghost_score_amount = sa->score_amount;
+	if (ga->agent_type == GAME_AGENT_GHOST) {
+		if (sa->look == SPECTATE_LOOK_SCARED)
+			ga->color = agent_ghost_get_color(GHOST_COLOR_SCARED);
+		else if (sa->look == SPECTATE_LOOK_SPIRIT)
+			ga->color = agent_ghost_get_color(GHOST_COLOR_SPIRIT);
+		else
+			ga->color = ga->original_color;
+	}
+}
+
+/* Feeds a message from the game into the viewer's board and scoreboard.  Returns
+   zero if it doesn't make sense. */
+int spectate_apply(const Uint8 *msg, int len)
+{
+	const Uint8 *p = msg, *end = msg + len;
+	Board *b = &g_spectate_board;
+	Score *s = &g_spectate_score;
+	int i;
+
+	while (p < end) {
+		int rec = spectate_get8(&p);
+
+		if (rec == SPECTATE_REC_AGENT && end - p >= 11) {
+			SpectateAgent sa;
+
+			i = spectate_get8(&p);
+			sa.x = (Sint16) spectate_get16(&p);
+			sa.y = (Sint16) spectate_get16(&p);
+			sa.dir = spectate_get8(&p) - 1;
+			sa.frame = spectate_get8(&p);
+			sa.look = spectate_get8(&p);
+			sa.is_visible = spectate_get8(&p);
+			sa.score_amount = spectate_get16(&p);
+			if (i >= SPECTATE_NUM_AGENTS) return 0;
+			g_spectate_sent.agents[i] = sa;
+			spectate_apply_agent(spectate_get_agent(b, i), &sa);
+		} else if (rec == SPECTATE_REC_AGENT_MOVE && end - p >= 3) {
+			SpectateAgent *sa;
+
+			i = spectate_get8(&p);
+			if (i >= SPECTATE_NUM_AGENTS) return 0;
+			sa = &g_spectate_sent.agents[i];
+			sa->x += (Sint8) spectate_get8(&p);
+			sa->y += (Sint8) spectate_get8(&p);
+			spectate_apply_agent(spectate_get_agent(b, i), sa);
+		} else if (rec == SPECTATE_REC_NIB_EATEN && end - p >= 2) {
+			i = spectate_get16(&p);
+			if (i >= BOARD_WIDTH*BOARD_HEIGHT) return 0;
+			if (BOARD_HAS_NIB(b, i % BOARD_WIDTH, i / BOARD_WIDTH)) {
+				board_erase_nib(b, i % BOARD_WIDTH, i / BOARD_WIDTH);
+				b->nibs_left--;
+			}
+		} else if (rec == SPECTATE_REC_NIBS && end - p >= BOARD_BLOCK_WORDS*4) {
+			b->nibs_left = 0;
+			for (i = 0; i < BOARD_BLOCK_WORDS; i++) {
+				Uint32 w = (Uint32) spectate_get32(&p);
+
+				b->nibs[i] = w;
+				for (; w; w &= w - 1) b->nibs_left++;
+			}
+			game_invalidate_layer(COMPOSITOR_LAYER_NIBS, &b->draw_rect);
+		} else if (rec == SPECTATE_REC_SCORE && end - p >= 4) {
+			s->score = spectate_get32(&p);
+			s->score_changed = 1;
+		} else if (rec == SPECTATE_REC_LIVES && end - p >= 1) {
+			s->lives_left = spectate_get8(&p);
+			s->score_changed = 1;
+		} else if (rec == SPECTATE_REC_LEVEL && end - p >= 2) {
+			pman_set_level(spectate_get16(&p));
+			s->score_changed = 1;
+		} else if (rec == SPECTATE_REC_VISIBLE && end - p >= 1) {
+			b->is_visible = spectate_get8(&p);
+			game_invalidate_layer(COMPOSITOR_LAYER_WALLS, &b->draw_rect);
+		} else {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Tries to connect the viewer to the game. */
+void spectate_connect()
+{
+	struct sockaddr_un addr;
+
+	g_spectate_last_connect = SDL_GetTicks();
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, g_spectate_view_path, sizeof(addr.sun_path) - 1);
+
+	g_spectate_conn = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (g_spectate_conn < 0) return;
+	if (connect(g_spectate_conn, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(g_spectate_conn);
+		g_spectate_conn = -1;
+		return;
+	}
+	fcntl(g_spectate_conn, F_SETFL, O_NONBLOCK);
+}
+
+/* Hangs up on the game. */
+void spectate_disconnect()
+{
+	close(g_spectate_conn);
+	g_spectate_conn = -1;
+}
+
+/* The viewer's model:  applies everything the game has sent since the last frame. */
+void spectate_viewer_model(Uint32 frame_time)
+{
+	Uint8 msg[SPECTATE_MAX_MESSAGE];
+
+	if (g_spectate_conn < 0) {
+		if (SDL_GetTicks() - g_spectate_last_connect >= SPECTATE_RECONNECT_DELAY)
+			spectate_connect();
+		if (g_spectate_conn < 0) return;
+	}
+
+	for (;;) {
+		int n = recv(g_spectate_conn, msg, sizeof(msg), 0);
+
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+		if (n <= 0 || !spectate_apply(msg, n)) {
+			spectate_disconnect();
+			break;
+		}
+	}
+}
+
+/* The viewer's HUD layer:  draws the scoreboard. */
+void spectate_viewer_draw_hud(SDL_Surface *surface, SDL_Rect *r, void *data)
+{
+	if (rects_intersect(r, &g_spectate_score.draw_rect))
+		score_draw(&g_spectate_score, surface);
+}
+
+/* The viewer's view:  marks whatever the game has changed on the board and
+   scoreboard since the last frame, so that their layers redraw it. */
+void spectate_viewer_view(SDL_Surface *surface, int game_view_flags)
+{
+	board_invalidate_changes(&g_spectate_board);
+	score_invalidate_changes(&g_spectate_score);
+}
+
+/* The viewer's controller:  ESC quits. */
+int spectate_viewer_controller(SDL_Event *e)
+{
+	if (e->type == SDL_KEYDOWN && e->key.keysym.sym == SDLK_ESCAPE) {
+		game_quit();
+		return 1;
+	}
+	return 0;
+}
+
+void spectate_viewer_init()
+{
+	board_init(&g_spectate_board, PMAN_BOARD_OFFSET_X, PMAN_BOARD_OFFSET_Y);
+	score_init(&g_spectate_score, PMAN_SCORE_OFFSET_X, PMAN_SCORE_OFFSET_Y);
+	board_restart(&g_spectate_board, 1);
+	score_restart(&g_spectate_score);
+	board_set_layers(&g_spectate_board);
+	game_set_layer(COMPOSITOR_LAYER_HUD, spectate_viewer_draw_hud, NULL);
+	memset(&g_spectate_sent, 0, sizeof(g_spectate_sent));
+	g_spectate_last_connect = SDL_GetTicks() - SPECTATE_RECONNECT_DELAY;
+}
+
+void spectate_viewer_shutdown()
+{
+	if (g_spectate_conn >= 0) spectate_disconnect();
+	board_destroy(&g_spectate_board);
+	score_destroy(&g_spectate_score);
+}
+
+const GameState spectate_game_state = { spectate_viewer_model, spectate_viewer_view, spectate_viewer_controller, spectate_viewer_init, spectate_viewer_shutdown };
+
+/* Opens a window that shows the game being streamed to the Unix domain socket at
+   the given path, until the user quits. */
+void spectate_run_viewer(const char *path)
+{
+	g_spectate_view_path = path;
+	game_init();
+	board_add_sprites();
+	game_build_sprites();
+	game_set_state(&spectate_game_state);
+	game_run();
+	game_shutdown();
+}
+
+#else
+
+void spectate_listen(const char *path)
+{
+	err("Spectator sockets aren't supported on this platform.\n", 1);
+}
+
+int spectate_is_listening()
+{
+	return 0;
+}
+
+void spectate_update(Board *b, Score *s, int level)
+{
+}
+
+void spectate_shutdown()
+{
+}
+
+void spectate_run_viewer(const char *path)
+{
+	err("Spectator sockets aren't supported on this platform.\n", 1);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef INCLUDE_PMAN_SPECTATE
+#define INCLUDE_PMAN_SPECTATE
+
+/* pman_spectate.h
+
+   Live spectator stream for headless games (POSIX systems only).
+
+   A headless session (pman -bot or -shm) given a spectator socket listens on
+   it, and after every step of the first world, sends whoever is connected a
+   message with what changed on its board since the last one:  the agents that
+   moved or changed, the nibs that were eaten, and the score, lives, level and
+   board visibility if they changed.  Nothing is drawn on the game's side, and
+   when no viewer is connected, the game only looks for one every
+   SPECTATE_ACCEPT_INTERVAL steps.
+
+   The socket is a SOCK_SEQPACKET one, so each message arrives whole or not at
+   all.  If the viewer falls behind and a message can't be sent straight away,
+   it's dropped, and the next message that goes out is a key frame that
+   describes everything from scratch.
+
+   The viewer (pman -view) is an ordinary game state that feeds the messages
+   into its own board and scoreboard, and draws them with the board's layers
+   and score_draw() (see compositor.h).
+
+   A message is a sequence of records, each starting with a SPECTATE_REC_*
+   byte.  Multi-byte fields are little-endian.
+*/
+
+#include "SDL.h"
+
+#include "game.h"
+#include "pman_board.h"
+#include "pman_score.h"
+
+/* Number of steps between each look for a new viewer. */
+#define SPECTATE_ACCEPT_INTERVAL 256
+
+/* Maximum size of a message, in bytes. */
+#define SPECTATE_MAX_MESSAGE 1024
+
+/* Number of ms the viewer waits between attempts to connect. */
+#define SPECTATE_RECONNECT_DELAY 1000
+
+/* Number of agents described in the stream:  pac man, the four ghosts, and the
+   fruit, in that order. */
+#define SPECTATE_NUM_AGENTS 6
+
+/* The SPECTATE_REC_* constants are the kinds of record in a message. */
+
+/* Everything about an agent:  index, x, y (Sint16 pixels), direction + 1,
+   animation frame, SPECTATE_LOOK_* constant, visibility, and the points it's
+   showing (Uint16). */
+#define SPECTATE_REC_AGENT      1
+/* An agent that only moved a little:  index, dx, dy (Sint8 pixels). */
+#define SPECTATE_REC_AGENT_MOVE 2
+/* A nib that was eaten:  the block's index (Uint16, y*BOARD_WIDTH + x). */
+#define SPECTATE_REC_NIB_EATEN  3
+/* Every nib on the board:  BOARD_BLOCK_WORDS Uint32s (see Board.nibs). */
+#define SPECTATE_REC_NIBS       4
+/* The score (Sint32). */
+#define SPECTATE_REC_SCORE      5
+/* Lives left (Uint8). */
+#define SPECTATE_REC_LIVES      6
+/* The level (Uint16). */
+#define SPECTATE_REC_LEVEL      7
+/* Whether the board is visible (Uint8). */
+#define SPECTATE_REC_VISIBLE    8
+
+/* The SPECTATE_LOOK_* constants say what color a ghost is. */
+#define SPECTATE_LOOK_NORMAL 0
+#define SPECTATE_LOOK_SCARED 1
+#define SPECTATE_LOOK_SPIRIT 2
+
+/* What the stream last said about an agent. */
+typedef struct SpectateAgent {
+	int x, y;
+	int dir;
+	int frame;
+	int look;
+	int is_visible;
+	int score_amount;
+} SpectateAgent;
+
+/* What the stream last said about a world. */
+typedef struct SpectateWorld {
+	SpectateAgent agents[SPECTATE_NUM_AGENTS];
+	Uint32 nibs[BOARD_BLOCK_WORDS];
+	int score;
+	int lives_left;
+	int level;
+	int is_visible;
+} SpectateWorld;
+
+void spectate_listen(const char *path);
+int spectate_is_listening();
+void spectate_update(Board *b, Score *s, int level);
+void spectate_shutdown();
+void spectate_run_viewer(const char *path);
+
+#endif
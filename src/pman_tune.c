@@ -0,0 +1,323 @@
+#include "globals.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+
+#include "SDL.h"
+
+#include "state.h"
+#include "pman_agent_pman.h"
+#include "pman_agent_ghost.h"
+#include "pman_agent_fruit.h"
+#include "pman_score.h"
+#include "pman_tune.h"
+
+/* The TUNE_TYPE_* constants say what type of field a tunable is kept in. */
+#define TUNE_TYPE_DOUBLE 0
+#define TUNE_TYPE_INT    1
+
+/* Every tunable's default value, in the order of the fields of Tunables. */
+#define TUNE_DEFAULTS { \
+	PMAN_BASE_SPEED, GHOST_ADDED_SPEED_PER_LEVEL, GHOST_FLEE_SPEED_MULTIPLIER, \
+	GHOST_FLEE_INITIAL_TIME, GHOST_FLEE_LESS_TIME_PER_LEVEL, \
+	FRUIT_INITIAL_BASE_TIME, FRUIT_INITIAL_RAND_TIME, \
+	FRUIT_EATEN_BASE_TIME, FRUIT_EATEN_RAND_TIME, \
+	FRUIT_DISAPPEARED_BASE_TIME, FRUIT_DISAPPEARED_RAND_TIME, \
+	FRUIT_APPEARED_BASE_TIME, FRUIT_APPEARED_RAND_TIME, \
+	SCORE_STARTING_LIVES, SCORE_MAX_LIVES, SCORE_NIBBLET_SCORE, SCORE_NIBBLOON_SCORE, \
+	SCORE_BASE_GHOST_SCORE, SCORE_BASE_FRUIT_SCORE, SCORE_NEW_LIFE_EARNED }
+
+/* A tunable's name, and where it's kept. */
+typedef struct TuneEntry {
+	const char *name;
+	/* TUNE_TYPE_* constant. */
+	int type;
+	/* Offset of its field in Tunables. */
+	size_t offset;
+} TuneEntry;
+
+/* Several values for one tunable. */
+typedef struct TuneSweep {
+	const TuneEntry *entry;
+	int num_values;
+	double values[TUNE_MAX_SWEEP_VALUES];
+} TuneSweep;
+
+#define TUNE_ENTRY(name, type, field) { #name, type, offsetof(Tunables, field) }
+
+static const TuneEntry g_tune_entries[] = {
+	TUNE_ENTRY(PMAN_BASE_SPEED,                TUNE_TYPE_DOUBLE, pman_base_speed),
+	TUNE_ENTRY(GHOST_ADDED_SPEED_PER_LEVEL,    TUNE_TYPE_DOUBLE, ghost_added_speed_per_level),
+	TUNE_ENTRY(GHOST_FLEE_SPEED_MULTIPLIER,    TUNE_TYPE_DOUBLE, ghost_flee_speed_multiplier),
+	TUNE_ENTRY(GHOST_FLEE_INITIAL_TIME,        TUNE_TYPE_INT,    ghost_flee_initial_time),
+	TUNE_ENTRY(GHOST_FLEE_LESS_TIME_PER_LEVEL, TUNE_TYPE_INT,    ghost_flee_less_time_per_level),
+	TUNE_ENTRY(FRUIT_INITIAL_BASE_TIME,        TUNE_TYPE_INT,    fruit_initial_base_time),
+	TUNE_ENTRY(FRUIT_INITIAL_RAND_TIME,        TUNE_TYPE_INT,    fruit_initial_rand_time),
+	TUNE_ENTRY(FRUIT_EATEN_BASE_TIME,          TUNE_TYPE_INT,    fruit_eaten_base_time),
+	TUNE_ENTRY(FRUIT_EATEN_RAND_TIME,          TUNE_TYPE_INT,    fruit_eaten_rand_time),
+	TUNE_ENTRY(FRUIT_DISAPPEARED_BASE_TIME,    TUNE_TYPE_INT,    fruit_disappeared_base_time),
+	TUNE_ENTRY(FRUIT_DISAPPEARED_RAND_TIME,    TUNE_TYPE_INT,    fruit_disappeared_rand_time),
+	TUNE_ENTRY(FRUIT_APPEARED_BASE_TIME,       TUNE_TYPE_INT,    fruit_appeared_base_time),
+	TUNE_ENTRY(FRUIT_APPEARED_RAND_TIME,       TUNE_TYPE_INT,    fruit_appeared_rand_time),
+	TUNE_ENTRY(SCORE_STARTING_LIVES,           TUNE_TYPE_INT,    score_starting_lives),
+	TUNE_ENTRY(SCORE_MAX_LIVES,                TUNE_TYPE_INT,    score_max_lives),
+	TUNE_ENTRY(SCORE_NIBBLET_SCORE,            TUNE_TYPE_INT,    score_nibblet_score),
+	TUNE_ENTRY(SCORE_NIBBLOON_SCORE,           TUNE_TYPE_INT,    score_nibbloon_score),
+	TUNE_ENTRY(SCORE_BASE_GHOST_SCORE,         TUNE_TYPE_INT,    score_base_ghost_score),
+	TUNE_ENTRY(SCORE_BASE_FRUIT_SCORE,         TUNE_TYPE_INT,    score_base_fruit_score),
+	TUNE_ENTRY(SCORE_NEW_LIFE_EARNED,          TUNE_TYPE_INT,    score_new_life_earned)
+};
+
+#define TUNE_NUM_ENTRIES (int) (sizeof(g_tune_entries) / sizeof(g_tune_entries[0]))
+
+Tunables g_tunables = TUNE_DEFAULTS;
+
+/* The tunables as they were set, before any config of the sweep was put in
+   place. */
+static Tunables g_tune_base = TUNE_DEFAULTS;
+
+static TuneSweep g_tune_sweeps[TUNE_MAX_SWEEPS];
+static int g_tune_num_sweeps = 0;
+
+/* Returns the tunable with the given name, or NULL if there isn't one. */
+const TuneEntry *tune_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < TUNE_NUM_ENTRIES; i++) {
+		if (strcmp(g_tune_entries[i].name, name) == 0) return &g_tune_entries[i];
+	}
+	return NULL;
+}
+
+/* Stores the given value in the given tunable of t, rounding it if the
+   tunable is an integer. */
+void tune_store(Tunables *t, const TuneEntry *e, double value)
+{
+	void *field = (Uint8 *) t + e->offset;
+
+	if (e->type == TUNE_TYPE_DOUBLE)
+		*(double *) field = value;
+	else
+		*(int *) field = (int) (value < 0 ? value - 0.5 : value + 0.5);
+}
+
+/* Returns the value of the given tunable of t. */
+double tune_fetch(const Tunables *t, const TuneEntry *e)
+{
+	const void *field = (const Uint8 *) t + e->offset;
+
+	if (e->type == TUNE_TYPE_DOUBLE)
+		return *(const double *) field;
+	return *(const int *) field;
+}
+
+/* Parses the whole of the given string (give or take surrounding spaces) as a
+   number.  Returns nonzero on success. */
+int tune_parse_value(const char *s, double *value)
+{
+	char *end;
+
+	*value = strtod(s, &end);
+	if (end == s) return 0;
+	while (isspace((unsigned char) *end)) end++;
+	return *end == '\0';
+}
+
+/* Copies the given string into buf without its surrounding spaces. */
+void tune_trim(char *buf, size_t size, const char *s, size_t len)
+{
+	while (len > 0 && isspace((unsigned char) *s)) { s++; len--; }
+	while (len > 0 && isspace((unsigned char) s[len-1])) len--;
+	if (len >= size) len = size - 1;
+	memcpy(buf, s, len);
+	buf[len] = '\0';
+}
+
+/* Sets the tunable with the given name to the given value (a string holding
+   a number).  Returns nonzero on success. */
+int tune_set(const char *name, const char *value)
+{
+	const TuneEntry *e = tune_find(name);
+	double v;
+
+	if (!e || !tune_parse_value(value, &v)) return 0;
+	tune_store(&g_tune_base, e, v);
+	tune_store(&g_tunables, e, v);
+	return 1;
+}
+
+/* Sets a tunable from a string of the form "NAME=VALUE".  Returns nonzero on
+   success. */
+int tune_parse_assignment(const char *s)
+{
+	char name[TUNE_MAX_LINE];
+	const char *eq = strchr(s, '=');
+
+	if (!eq) return 0;
+	tune_trim(name, sizeof(name), s, eq - s);
+	return tune_set(name, eq + 1);
+}
+
+/* Sets tunables from the given file, which has one "NAME = VALUE" line for each
+   of them.  Blank lines, and anything after a '#', are ignored.  Returns
+   nonzero on success;  otherwise says what's wrong on stderr. */
+int tune_load_file(const char *path)
+{
+	char line[TUNE_MAX_LINE];
+	FILE *f;
+	int line_num = 0, ok = 1;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "Couldn't open tunables file %s.\n", path);
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *hash = strchr(line, '#');
+		char *s = line;
+
+		line_num++;
+		if (hash) *hash = '\0';
+		while (isspace((unsigned char) *s)) s++;
+		if (*s == '\0') continue;
+
+		if (!tune_parse_assignment(s)) {
+			fprintf(stderr, "%s:%d: unknown tunable or bad value.\n", path, line_num);
+			ok = 0;
+		}
+	}
+
+	fclose(f);
+	return ok;
+}
+
+/* Adds a tunable to the sweep, from a string of the form "NAME=V1,V2,...".
+   Returns nonzero on success;  fails if the sweep would have more than
+   TUNE_MAX_CONFIGS configs. */
+int tune_add_sweep(const char *s)
+{
+	char name[TUNE_MAX_LINE], value[TUNE_MAX_LINE];
+	const char *eq = strchr(s, '=');
+	TuneSweep *sw;
+
+	if (!eq || g_tune_num_sweeps == TUNE_MAX_SWEEPS) return 0;
+	sw = &g_tune_sweeps[g_tune_num_sweeps];
+	tune_trim(name, sizeof(name), s, eq - s);
+	sw->entry = tune_find(name);
+	if (!sw->entry) return 0;
+
+	sw->num_values = 0;
+	s = eq + 1;
+	for (;;) {
+		const char *comma = strchr(s, ',');
+		size_t len = comma ? (size_t) (comma - s) : strlen(s);
+
+		if (sw->num_values == TUNE_MAX_SWEEP_VALUES) return 0;
+		tune_trim(value, sizeof(value), s, len);
+		if (!tune_parse_value(value, &sw->values[sw->num_values])) return 0;
+		sw->num_values++;
+
+		if (!comma) break;
+		s = comma + 1;
+	}
+
+	if (tune_num_configs() > TUNE_MAX_CONFIGS / sw->num_values) return 0;
+	g_tune_num_sweeps++;
+	return 1;
+}
+
+/* Returns the number of configs in the sweep (1 if there's no sweep). */
+int tune_num_configs()
+{
+	int i, n = 1;
+
+	for (i = 0; i < g_tune_num_sweeps; i++) {
+		n *= g_tune_sweeps[i].num_values;
+	}
+	return n;
+}
+
+/* Returns which of its values the given sweep has in the given config.  The
+   last tunable of the sweep changes fastest from one config to the next. */
+int tune_config_value_index(int config, int sweep)
+{
+	int i;
+
+	for (i = g_tune_num_sweeps - 1; i > sweep; i--) {
+		config /= g_tune_sweeps[i].num_values;
+	}
+	return config % g_tune_sweeps[sweep].num_values;
+}
+
+/* Puts the given config of the sweep in place:  every tunable goes back to the
+   value it was set to, and then the sweep's tunables get their values in the
+   config. */
+void tune_select_config(int config)
+{
+	int i;
+
+	g_tunables = g_tune_base;
+	for (i = 0; i < g_tune_num_sweeps; i++) {
+		const TuneSweep *sw = &g_tune_sweeps[i];
+
+		tune_store(&g_tunables, sw->entry, sw->values[tune_config_value_index(config, i)]);
+	}
+}
+
+/* Puts a description of the given config (e.g. "PMAN_BASE_SPEED=9
+   SCORE_MAX_LIVES=3") in buf. */
+void tune_describe_config(int config, char *buf, size_t size)
+{
+	char item[TUNE_MAX_LINE];
+	size_t len = 0;
+	int i;
+
+	buf[0] = '\0';
+	for (i = 0; i < g_tune_num_sweeps; i++) {
+		const TuneSweep *sw = &g_tune_sweeps[i];
+
+		sprintf(item, "%s%s=%g", i ? " " : "", sw->entry->name, sw->values[tune_config_value_index(config, i)]);
+		if (len + strlen(item) + 1 > size) break;
+		strcpy(buf + len, item);
+		len += strlen(item);
+	}
+}
+
+/* Mixes the given value into the given FNV-1a hash. */
+Uint32 tune_hash_bytes(Uint32 h, const void *p, size_t n)
+{
+	const Uint8 *b = (const Uint8 *) p;
+
+	while (n--) {
+		h ^= *b++;
+		h *= 16777619;
+	}
+	return h;
+}
+
+/* Returns a hash of every tunable's value and of the sweep, which changes if
+   any of them do. */
+Uint32 tune_hash()
+{
+	Uint32 h = 2166136261u;
+	int i, j;
+
+	for (i = 0; i < TUNE_NUM_ENTRIES; i++) {
+		double v = tune_fetch(&g_tune_base, &g_tune_entries[i]);
+
+		h = tune_hash_bytes(h, &v, sizeof(v));
+	}
+	for (i = 0; i < g_tune_num_sweeps; i++) {
+		h = tune_hash_bytes(h, g_tune_sweeps[i].entry->name, strlen(g_tune_sweeps[i].entry->name));
+		for (j = 0; j < g_tune_sweeps[i].num_values; j++) {
+			h = tune_hash_bytes(h, &g_tune_sweeps[i].values[j], sizeof(double));
+		}
+		h = tune_hash_bytes(h, &j, sizeof(j));
+	}
+	return h;
+}
@@ -0,0 +1,68 @@
+#ifndef INCLUDE_PMAN_TUNE
+#define INCLUDE_PMAN_TUNE
+
+/* pman_tune.h
+
+   Gameplay constants that can be changed at run time, for experimenting with
+   the game without rebuilding it.
+
+   Each tunable is named after the #define that gives its default value (e.g.
+   PMAN_BASE_SPEED), and can be set from the command line or from a file of
+   "NAME = VALUE" lines.  The game reads them straight out of the tunables
+   struct, so looking one up costs no more than reading a global;  names are
+   only ever looked up while they're being set.
+
+   A sweep gives some tunables several values each.  Every combination of them
+   is a "config", numbered from 0, and tune_select_config() puts one in place.
+   Batch runs (see pman_batch.h) play their games under every config.
+*/
+
+#include "SDL.h"
+
+/* Most tunables a sweep can vary, and most values it can give each of them. */
+#define TUNE_MAX_SWEEPS       8
+#define TUNE_MAX_SWEEP_VALUES 32
+
+/* Most configs a sweep can have in all. */
+#define TUNE_MAX_CONFIGS (1 << 20)
+
+/* Longest line in a tunables file. */
+#define TUNE_MAX_LINE 256
+
+typedef struct Tunables {
+	/* See pman_agent_pman.h and pman_agent_ghost.h. */
+	double pman_base_speed;
+	double ghost_added_speed_per_level;
+	double ghost_flee_speed_multiplier;
+	int ghost_flee_initial_time;
+	int ghost_flee_less_time_per_level;
+
+	/* See pman_agent_fruit.h. */
+	int fruit_initial_base_time, fruit_initial_rand_time;
+	int fruit_eaten_base_time, fruit_eaten_rand_time;
+	int fruit_disappeared_base_time, fruit_disappeared_rand_time;
+	int fruit_appeared_base_time, fruit_appeared_rand_time;
+
+	/* See pman_score.h. */
+	int score_starting_lives;
+	int score_max_lives;
+	int score_nibblet_score;
+	int score_nibbloon_score;
+	int score_base_ghost_score;
+	int score_base_fruit_score;
+	int score_new_life_earned;
+} Tunables;
+
+/* The tunables the game is playing with. */
+extern Tunables g_tunables;
+
+int tune_set(const char *name, const char *value);
+int tune_parse_assignment(const char *s);
+int tune_load_file(const char *path);
+int tune_add_sweep(const char *s);
+int tune_num_configs();
+void tune_select_config(int config);
+void tune_describe_config(int config, char *buf, size_t size);
+Uint32 tune_hash();
+
+#endif
@@ -0,0 +1,115 @@
+#include "globals.h"
+
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#include "render.h"
+
+/* Sets the video mode of SDL's window.  Switching in or out of fullscreen keeps
+   the depth the window already has. */
+SDL_Surface *render_sdl_set_mode(SDL_Surface *screen, int w, int h, int depth, int fullscreen)
+{
+	Uint32 flags = SDL_SWSURFACE;
+
+	depth = SDL_VideoModeOK(w, h, depth, flags);
+	if (fullscreen) {
+		flags = flags | SDL_FULLSCREEN;
+		if (screen) depth = screen->format->BitsPerPixel;
+	}
+	return SDL_SetVideoMode(w, h, depth, flags);
+}
+
+void render_sdl_flip(SDL_Surface *screen)
+{
+	SDL_Flip(screen);
+}
+
+void render_sdl_update_rects(SDL_Surface *screen, int numrects, SDL_Rect *rects)
+{
+	SDL_UpdateRects(screen, numrects, rects);
+}
+
+void render_sdl_close(SDL_Surface *screen)
+{
+	SDL_FreeSurface(screen);
+}
+
+const RenderBackend render_sdl_backend = { SDL_INIT_VIDEO, render_sdl_set_mode, render_sdl_flip, render_sdl_update_rects, render_sdl_close };
+
+/* Creates a framebuffer:  a surface of the given size and depth whose pixels are
+   a block of memory allocated here, cleared to black.  16-bit framebuffers are
+   5-6-5 RGB, 15-bit ones 5-5-5, 24 and 32-bit ones 8-8-8, and 8-bit ones use
+   SDL's default palette.  Returns NULL if the depth isn't one of those, or if
+   there isn't enough memory. */
+SDL_Surface *render_framebuffer_create(int w, int h, int depth)
+{
+	Uint32 rmask, gmask, bmask;
+	SDL_Surface *s;
+	void *pixels;
+	int pitch;
+
+	switch (depth) {
+		case 8:
+			rmask = gmask = bmask = 0;
+			break;
+		case 15:
+			rmask = 0x7C00;
+			gmask = 0x03E0;
+			bmask = 0x001F;
+			break;
+		case 16:
+			rmask = 0xF800;
+			gmask = 0x07E0;
+			bmask = 0x001F;
+			break;
+		case 24:
+		case 32:
+			rmask = 0xFF0000;
+			gmask = 0x00FF00;
+			bmask = 0x0000FF;
+			break;
+		default:
+			return NULL;
+	}
+
+	/* Rows start on 4-byte boundaries, as they do in surfaces SDL allocates. */
+	pitch = ((w * ((depth + 7) / 8)) + 3) & ~3;
+	pixels = calloc(h, pitch);
+	if (!pixels) return NULL;
+
+	s = SDL_CreateRGBSurfaceFrom(pixels, w, h, depth, pitch, rmask, gmask, bmask, 0);
+	if (!s) free(pixels);
+	return s;
+}
+
+/* Frees a framebuffer made with render_framebuffer_create(), and its pixels. */
+void render_framebuffer_free(SDL_Surface *s)
+{
+	void *pixels;
+
+	if (!s) return;
+	pixels = s->pixels;
+	/* SDL never frees pixels it didn't allocate itself. */
+	SDL_FreeSurface(s);
+	free(pixels);
+}
+
+/* Makes the framebuffer that's the screen.  Since there's no window, there's
+   nothing to go fullscreen in, so the screen is only made once. */
+SDL_Surface *render_framebuffer_set_mode(SDL_Surface *screen, int w, int h, int depth, int fullscreen)
+{
+	if (screen) return screen;
+	return render_framebuffer_create(w, h, depth);
+}
+
+/* Finished frames stay in the framebuffer, where whoever wants them can read them. */
+void render_framebuffer_flip(SDL_Surface *screen)
+{
+}
+
+void render_framebuffer_update_rects(SDL_Surface *screen, int numrects, SDL_Rect *rects)
+{
+}
+
+const RenderBackend render_framebuffer_backend = { 0, render_framebuffer_set_mode, render_framebuffer_flip, render_framebuffer_update_rects, render_framebuffer_free };
@@ -0,0 +1,46 @@
+#ifndef INCLUDE_RENDER
+#define INCLUDE_RENDER
+
+/* render.h
+
+   Render backends module.
+
+   A render backend gives the game the surface that it draws each frame to,
+   and shows the parts of it that have changed once the frame is drawn.
+   Everything the game draws goes through ordinary SDL surfaces and software
+   blits, so any surface will do as the screen.
+
+   The SDL backend opens a window with SDL's video subsystem.  The framebuffer
+   backend keeps the screen in a plain block of memory that it allocates
+   itself, and never shows it anywhere;  it doesn't need SDL's video
+   subsystem, so frames can be rendered on machines without a display (e.g.,
+   on servers and in tests), and whatever was drawn can be read straight out
+   of the surface's pixels.  Framebuffers can also be made on their own with
+   render_framebuffer_create(), e.g. for a worker thread to draw into.
+*/
+
+#include "SDL.h"
+
+typedef struct RenderBackend {
+	/* The SDL subsystems the backend needs, for SDL_Init(). */
+	Uint32 sdl_init_flags;
+	/* Returns a screen surface with the given width and height, and the given
+	   depth if the backend can manage it, or NULL if it couldn't make one.
+	   "screen" is the backend's current screen, or NULL if it doesn't have one
+	   yet;  the returned surface replaces it. */
+	SDL_Surface *(*set_mode)(SDL_Surface *screen, int w, int h, int depth, int fullscreen);
+	/* Shows the whole screen. */
+	void (*flip)(SDL_Surface *screen);
+	/* Shows the given rectangles of the screen. */
+	void (*update_rects)(SDL_Surface *screen, int numrects, SDL_Rect *rects);
+	/* Frees the screen. */
+	void (*close)(SDL_Surface *screen);
+} RenderBackend;
+
+SDL_Surface *render_framebuffer_create(int w, int h, int depth);
+void render_framebuffer_free(SDL_Surface *s);
+
+const extern RenderBackend render_sdl_backend;
+const extern RenderBackend render_framebuffer_backend;
+
+#endif
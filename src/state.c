@@ -11,6 +11,10 @@
    types of finite state machines. */
 static Uint32 g_state_timers[MAX_TIMERS];
 
+/* One more than the highest timer id that's been used, so that snapshots only
+   have to copy the timers in use (every other timer is always 0). */
+static int g_state_num_timers = 0;
+
 /* All the state objects which hold the state data for their
    finite state machines. */
 static State *g_state_objects[MAX_STATE_OBJECTS];
@@ -38,6 +42,7 @@ void state_timer_init()
    to it. */
 void state_timer_update(int timer_id, Uint32 ticks)
 {
+	if (timer_id >= g_state_num_timers) g_state_num_timers = timer_id + 1;
 	g_state_timers[timer_id] += ticks;
 }
 
@@ -98,6 +103,7 @@ void smqueue_destroy(StateMessageQueue *smqueue);
 void state_construct(State *s, int new_state_id, int new_state_machine_id, void *new_parent, int timer_id)
 {
 	s->timer_id = timer_id;
+	if (timer_id >= g_state_num_timers) g_state_num_timers = timer_id + 1;
 	s->change_state = 0;
 	s->next_state = 0;
 	s->parent = new_parent;
@@ -389,3 +395,77 @@ void state_process_messages()
 {
 	smqueue_process(g_state_message_queue);
 }
+
+/* Saves the timers, the delayed message queue and the temp int pool's position
+   into the given snapshot. */
+void state_snapshot_save(StateSnapshot *ss)
+{
+	StateMessageQueue *cursor;
+	int i;
+
+	ss->num_timers = g_state_num_timers;
+	for (i = 0; i < g_state_num_timers; i++)
+		ss->timers[i] = g_state_timers[i];
+	ss->temp_int_pool_index = g_temp_int_pool.index;
+
+	ss->num_messages = 0;
+	for (cursor = g_state_message_queue; !smqueue_is_empty(cursor); cursor = cursor->next) {
+		StateSnapshotMessage *ssm;
+		int *data = (int *) cursor->sm->data;
+
+		assert(ss->num_messages < STATE_SNAPSHOT_MAX_MESSAGES);
+		ssm = &ss->messages[ss->num_messages++];
+		ssm->message = cursor->sm->message;
+		ssm->from = cursor->sm->from;
+		ssm->to = cursor->sm->to;
+		ssm->delivery_time = cursor->sm->delivery_time;
+		if (data == NULL) {
+			ssm->data_index = -1;
+			ssm->data_value = 0;
+		} else {
+			assert(data >= g_temp_int_pool.ints && data < g_temp_int_pool.ints + TEMP_INT_POOL_SIZE);
+			ssm->data_index = (int) (data - g_temp_int_pool.ints);
+			ssm->data_value = *data;
+		}
+	}
+}
+
+/* Puts the timers, the delayed message queue and the temp int pool back the way
+   they were when the given snapshot was saved.  Any messages currently queued are
+   thrown away. */
+void state_snapshot_restore(const StateSnapshot *ss)
+{
+	int i;
+
+	for (i = 0; i < ss->num_timers; i++)
+		g_state_timers[i] = ss->timers[i];
+	/* Timers that have come into use since the snapshot was saved were 0 then. */
+	for (; i < g_state_num_timers; i++)
+		g_state_timers[i] = 0;
+	g_temp_int_pool.index = ss->temp_int_pool_index;
+
+	while (!smqueue_is_empty(g_state_message_queue)) {
+		free(g_state_message_queue->sm);
+		smqueue_remove(g_state_message_queue);
+	}
+
+	/* The queue is built by inserting at the front, so go backwards to keep the
+	   messages in the same order. */
+	for (i = ss->num_messages - 1; i >= 0; i--) {
+		const StateSnapshotMessage *ssm = &ss->messages[i];
+		StateMessage *sm;
+
+		sm = malloc(sizeof(StateMessage));
+		sm->message = ssm->message;
+		sm->from = ssm->from;
+		sm->to = ssm->to;
+		sm->delivery_time = ssm->delivery_time;
+		if (ssm->data_index == -1) {
+			sm->data = NULL;
+		} else {
+			g_temp_int_pool.ints[ssm->data_index] = ssm->data_value;
+			sm->data = &g_temp_int_pool.ints[ssm->data_index];
+		}
+		smqueue_insert(g_state_message_queue, sm);
+	}
+}
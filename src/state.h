@@ -26,6 +26,9 @@
 /* Maximum number of timers. */
 #define MAX_TIMERS   100
 
+/* Maximum number of pending delayed messages a StateSnapshot can hold. */
+#define STATE_SNAPSHOT_MAX_MESSAGES 64
+
 /* State ID for a FSM's global state. */
 #define STATE_Global 0
 
@@ -145,6 +148,30 @@ typedef struct StateMessageQueue {
 
 typedef int (*StateMachine)(State *, int, StateMessage *);
 
+/* A pending delayed message, flattened so that it can be copied around freely.
+   The data of a delayed message is always either NULL or an int from the temp int
+   pool, so it's stored as the int's index in the pool (-1 for NULL) and its value. */
+typedef struct StateSnapshotMessage {
+	int message;
+	int from, to;
+	Uint32 delivery_time;
+	int data_index;
+	int data_value;
+} StateSnapshotMessage;
+
+/* A flat copy of everything in the state module that changes during play:  the
+   timers, the delayed message queue and the temp int pool's position.  The state
+   objects and state machines themselves aren't included, since they're registered
+   once and stay put. */
+typedef struct StateSnapshot {
+	/* The timers in use, i.e. the first num_timers of them. */
+	Uint32 timers[MAX_TIMERS];
+	int num_timers;
+	int temp_int_pool_index;
+	int num_messages;
+	StateSnapshotMessage messages[STATE_SNAPSHOT_MAX_MESSAGES];
+} StateSnapshot;
+
 void state_init();
 void state_shutdown();
 
@@ -164,4 +191,7 @@ int *temp_int_pool_get_int();
 void state_timer_update(int timer_id, Uint32 ticks);
 Uint32 state_timer_get_ticks(int timer_id);
 
+void state_snapshot_save(StateSnapshot *ss);
+void state_snapshot_restore(const StateSnapshot *ss);
+
 #endif
@@ -0,0 +1,99 @@
+#include "globals.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <assert.h>
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "workers.h"
+
+/* Returns the number of processors the machine has, or 1 if it can't tell. */
+int workers_count_cpus()
+{
+	int n;
+#ifdef WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	n = (int) info.dwNumberOfProcessors;
+#else
+	n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return n < 1 ? 1 : n;
+}
+
+/* Main function of each worker thread. */
+int workers_thread(void *data)
+{
+	WorkerThread *t = (WorkerThread *) data;
+	WorkerPool *p = t->pool;
+
+	while (1) {
+		SDL_SemWait(t->start);
+		if (p->quit_flag) break;
+		p->job(t->k, p->num_threads, p->data);
+		SDL_SemPost(p->done);
+	}
+	return 0;
+}
+
+/* Starts a pool of one thread per processor, but no more than max_threads,
+   which run the given job with the given data whenever workers_run() is called. */
+void workers_start(WorkerPool *p, int max_threads, WorkersJob job, void *data)
+{
+	int k;
+
+	assert(max_threads >= 1 && max_threads <= WORKERS_MAX_THREADS);
+
+	p->num_threads = workers_count_cpus();
+	if (p->num_threads > max_threads) p->num_threads = max_threads;
+	p->job = job;
+	p->data = data;
+	p->quit_flag = 0;
+	p->done = SDL_CreateSemaphore(0);
+	for (k = 0; k < p->num_threads; k++) {
+		WorkerThread *t = &p->threads[k];
+
+		t->pool = p;
+		t->k = k;
+		t->start = SDL_CreateSemaphore(0);
+		t->thread = SDL_CreateThread(workers_thread, t);
+		assert(t->thread != NULL);
+	}
+}
+
+/* Runs the pool's job on every one of its threads, and returns once they've
+   all finished it. */
+void workers_run(WorkerPool *p)
+{
+	int k;
+
+	for (k = 0; k < p->num_threads; k++)
+		SDL_SemPost(p->threads[k].start);
+	for (k = 0; k < p->num_threads; k++)
+		SDL_SemWait(p->done);
+}
+
+/* Stops the pool's threads.  Does nothing if the pool isn't started. */
+void workers_stop(WorkerPool *p)
+{
+	int k;
+
+	if (p->num_threads == 0) return;
+
+	p->quit_flag = 1;
+	for (k = 0; k < p->num_threads; k++)
+		SDL_SemPost(p->threads[k].start);
+	for (k = 0; k < p->num_threads; k++) {
+		SDL_WaitThread(p->threads[k].thread, NULL);
+		SDL_DestroySemaphore(p->threads[k].start);
+	}
+	SDL_DestroySemaphore(p->done);
+	p->num_threads = 0;
+}
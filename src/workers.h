@@ -0,0 +1,51 @@
+#ifndef INCLUDE_WORKERS
+#define INCLUDE_WORKERS
+
+/* workers.h
+
+   Worker thread pool module.
+
+   A worker pool is a fixed number of threads that sit idle until they're all
+   given the same job to run, each with its own index, and that the caller
+   waits on until every one of them has finished it.  The threads stay around
+   between jobs, so starting a job only costs a semaphore post per thread.
+*/
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+/* Most threads a pool can have. */
+#define WORKERS_MAX_THREADS 64
+
+/* A job, as run by worker k of a pool of n.  data is whatever was given to
+   workers_start(). */
+typedef void (*WorkersJob)(int k, int n, void *data);
+
+struct WorkerPool;
+
+/* One thread of a pool, and the semaphore it waits on to start a job. */
+typedef struct WorkerThread {
+	struct WorkerPool *pool;
+	int k;
+	SDL_Thread *thread;
+	SDL_sem *start;
+} WorkerThread;
+
+/* The worker pool structure. */
+typedef struct WorkerPool {
+	/* Number of threads, or 0 if the pool hasn't been started. */
+	int num_threads;
+	WorkersJob job;
+	void *data;
+	WorkerThread threads[WORKERS_MAX_THREADS];
+	/* Posted by each thread when it has finished a job. */
+	SDL_sem *done;
+	int quit_flag;
+} WorkerPool;
+
+int workers_count_cpus();
+void workers_start(WorkerPool *p, int max_threads, WorkersJob job, void *data);
+void workers_run(WorkerPool *p);
+void workers_stop(WorkerPool *p);
+
+#endif